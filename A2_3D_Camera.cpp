@@ -1,8 +1,19 @@
 #include "Camera.h"
+#include "ClusteredLighting.h"
+#include "GBuffer.h"
+#include "GpuTimer.h"
+#include "Lightmap.h"
+#include "RoomGeometry.h"
+#include "SamplerCache.h"
+#include "ShadowCache.h"
 #include "SimpleModel.h"
 #include "Texture.h"
+#include "TextureAtlas.h"
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
 #include "utilities.h"
 #include <glm/fwd.hpp>
+#include <fstream>
 
 
 // global variables
@@ -14,10 +25,14 @@ const float gCamRotateSensitivity = 0.1f;
 ShaderProgram gShader;	// shader program object
 GLuint gVBO1 = 0,
 	   gVBO2 = 0,
-	   gVBO3 = 0;		// vertex buffer object identifiers
+	   gVBO3 = 0,
+	   gVBO4 = 0,
+	   gVBO5 = 0,
+	   gVBO6 = 0;		// vertex buffer object identifiers
 GLuint gVAO1 = 0,
 	   gVAO2 = 0,
-	   gVAO3 = 0;		// vertex array object identifiers
+	   gVAO3 = 0,
+	   gVAO4 = 0;		// vertex array object identifiers
 
 map<string, Camera> gCamera;				// camera objects
 map<string, mat4> gModelMatrix;				// object's matrix   
@@ -35,9 +50,33 @@ float gPrevYaw, gYaw = 0, gPrevPitch, gPitch = 0;
 
 Light gLight;						// light properties
 map<string, Material> gMaterials;	// material properties
-Texture gCubeEnvMap;				// cube environment map - object
-map<string, Texture> gTextures;		// texture map for walls and floors
+TextureStreamer gTextureStreamer;	// streams the mip levels of the large wall textures
+TextureRegistry gTextureRegistry;	// textures shared by file (declared before the handles it owns)
+TextureHandle gCubeEnvMap;			// cube environment map - object
+map<string, TextureHandle> gTextures;	// texture map for walls
+TextureAtlas gTextureAtlas;			// floor and painting images in one texture
 SimpleModel gModel;					// scene object model
+const double gModelUploadBudget = 2.0;	// milliseconds per frame spent uploading the model
+bool gClusterCulling = true;		// cull model clusters per viewport
+float gEnvironmentRoughness = 0.0f;	// GGX roughness of the ring's reflections
+vector<Light> gSceneLights;			// small coloured lights around the room
+int gNumOfSceneLights = 64;			// how many of them are on
+const int MAX_SCENE_LIGHTS = 256;
+ClusteredLighting gClusteredLighting;	// lights binned per viewport
+bool gDeferred = false;				// shade the viewports from G-buffers instead of while drawing
+map<string, GBuffer> gGBuffers;		// G-buffer of each viewport
+GpuTimer gForwardTimer;				// GPU time of frames drawn forward
+GpuTimer gDeferredTimer;			// GPU time of frames drawn deferred
+float gForwardTime = 0.0f,
+	gDeferredTime = 0.0f;			// milliseconds, last measured in each mode
+ShadowCache gShadowCache;			// shadow maps of the scene light
+bool gShadows = true;				// scene light casts shadows
+mat4 gShadowRingMatrix(0.0f);		// ring transform the shadow maps were last drawn with
+bool gShadowRingReady = false;		// ring was uploaded when the shadow maps were last drawn
+int gShadowRenders = 0;				// shadow map faces or tiles drawn this frame
+TextureHandle gLightmap;			// scene light baked onto the room by lightbake, if there is one
+bool gBakedLighting = true;			// room lit from the lightmap while the scene light is where it was baked
+const GLuint LIGHTMAP_UNIT = 12;	// texture unit of the lightmap (after the shadow maps)
 
 // function initialise scene and render settings
 static void init(GLFWwindow* window) {
@@ -45,6 +84,7 @@ static void init(GLFWwindow* window) {
 	glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 
 	glEnable(GL_DEPTH_TEST);	// enable depth buffer test
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);	// filter across cube map faces
 
 	// compile and link a vertex and fragment shader pair
 	gShader.compileAndLink("lightingAndTexture.vert", "pointLightTexture.frag");
@@ -83,11 +123,37 @@ static void init(GLFWwindow* window) {
 		* rotate(radians(90.0f), vec3(1.0f, 0.0f, 0.0f));
 
 	// initialise point light properties  
-	gLight.pos = vec3(0.0f, 1.0f, 0.0f);
+	gLight.pos = ROOM_LIGHT_POSITION;
 	gLight.La = vec3(0.3f);
-	gLight.Ld = vec3(1.0f);
+	gLight.Ld = ROOM_LIGHT_DIFFUSE;
 	gLight.Ls = vec3(1.0f);
-	gLight.att = vec3(1.0f, 0.0f, 0.0f);
+	gLight.att = ROOM_LIGHT_ATTENUATION;
+	gLight.dir = normalize(vec3(0.3f, -1.0f, 0.2f));	// (directional light/spotlight)
+	gLight.innerAngle = 30.0f;
+	gLight.outerAngle = 45.0f;
+	gLight.type = 1;
+	gShadowCache.setSceneBounds(vec3(0.0f, 0.5f, 0.0f), 1.5f);	// the room
+
+	// scene lights scattered over the floor, every fourth a spotlight shining down
+	gSceneLights.resize(MAX_SCENE_LIGHTS);
+	for (int i = 0; i < MAX_SCENE_LIGHTS; i++)
+	{
+		// golden angle spiral, so any number of lights covers the room evenly
+		float radius = 0.95f * sqrt((i + 0.5f) / MAX_SCENE_LIGHTS);
+		float angle = i * 2.39996f;
+		vec3 colour(0.5f + 0.5f * cos(angle), 0.5f + 0.5f * cos(angle + 2.094f), 0.5f + 0.5f * cos(angle + 4.189f));
+
+		Light& light = gSceneLights[i];
+		light.pos = vec3(radius * cos(angle), 0.1f + 0.4f * (i % 5) / 4.0f, radius * sin(angle));
+		light.dir = vec3(0.0f, -1.0f, 0.0f);
+		light.La = vec3(0.0f);
+		light.Ld = colour * 0.5f;
+		light.Ls = colour * 0.25f;
+		light.att = vec3(1.0f, 0.0f, 100.0f);
+		light.innerAngle = 20.0f;
+		light.outerAngle = 30.0f;
+		light.type = i % 4 == 3 ? 3 : 1;
+	}
 
 	// initialise material properties ===============================
 	gMaterials["General"].Ka = vec3(0.25f, 0.21f, 0.21f);
@@ -102,144 +168,38 @@ static void init(GLFWwindow* window) {
 	// ==============================================================
 
 	// load textures ================================================
-	// cube environment map
-	gCubeEnvMap.generate("./images/cm_front.bmp", "./images/cm_back.bmp",
+	// images are decoded together on the thread pool
+	TextureBatch textureBatch;
+	// cube environment map, mip levels prefiltered for rough reflections
+	gCubeEnvMap = gTextureRegistry.acquireCubeMap("./images/cm_front.bmp", "./images/cm_back.bmp",
 		"./images/cm_left.bmp", "./images/cm_right.bmp",
-		"./images/cm_top.bmp", "./images/cm_bottom.bmp");
-	// floor texture
-	gTextures["Floor"].generate("./images/check.bmp"); 
-	// load texture and normal map for walls
-	gTextures["Stone"].generate("./images/Fieldstone.bmp");
-	gTextures["StoneNormalMap"].generate("./images/FieldstoneBumpDOT3.bmp");
-	// painting texture 
-	gTextures["Painting"].generate("./images/smile.bmp");
+		"./images/cm_top.bmp", "./images/cm_bottom.bmp", textureBatch, true);
+	textureBatch.load();
+	// floor (tiled) and painting textures share an atlas
+	gTextureAtlas.add("Floor", "./images/check.bmp", true);
+	gTextureAtlas.add("Painting", "./images/smile.bmp", false);
+	gTextureAtlas.build(DEFAULT_ATLAS_GUTTER, BLOCK_FORMAT_BC1);
+	// texture and normal map for walls start with their smallest levels
+	// (block compressed: BC1 colour, BC5 normal x and y)
+	gTextures["Stone"] = gTextureRegistry.acquire("./images/Fieldstone.bmp", gTextureStreamer, BLOCK_FORMAT_BC1);
+	gTextures["StoneNormalMap"] = gTextureRegistry.acquire("./images/FieldstoneBumpDOT3.bmp", gTextureStreamer, BLOCK_FORMAT_BC5);
+	// baked lighting of the room, if lightbake has been run (no mip levels, they would mix the charts)
+	if (ifstream("./images/lightmap.bmp"))
+	{
+		gLightmap = gTextureRegistry.acquire("./images/lightmap.bmp");
+		gLightmap->setFilterParams(GL_LINEAR, GL_LINEAR);
+		gLightmap->setWrapParams(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+	}
 	// =============================================================
 	
-	// load model
-	gModel.loadModel("./models/torus.obj"); // CHANGE BACK
+	// load model in the background, it appears once uploaded
+	gModel.loadModelAsync("./models/torus.obj"); // CHANGE BACK
 
 	// vertex positions, normals and texture coordinates ===========
-	//  for floor and painting
-	vector<GLfloat> texturedVertices = {
-		/* ---------------------------------------------------
-		NOTE TO SELF: MAKE SURE THE ORDER MATCHES THE STRUCT
-		--------------------------------------------------- */ 
-		// floor  -------------------------------------------
-		-1.0f, 0.0f, 1.0f,	// vertex 0: position
-		0.0f, 1.0f, 0.0f,	// vertex 0: normal
-		0.0f, 0.0f,			// vertex 0: texture coordinate 
-
-		1.0f, 0.0f, 1.0f,	// vertex 1: position
-		0.0f, 1.0f, 0.0f,	// vertex 1: normal
-		4.0f, 0.0f,			// vertex 1: texture coordinate 
-
-		-1.0f, 0.0f, -1.0f,	// vertex 2: position 
-		0.0f, 1.0f, 0.0f,	// vertex 2: normal
-		0.0f, 4.0f,			// vertex 2: texture coordinate 
-
-		1.0f, 0.0f, -1.0f,	// vertex 3: position
-		0.0f, 1.0f, 0.0f,	// vertex 3: normal
-		4.0f, 4.0f,			// vertex 3: texture coordinate 
-		// painting -----------------------------------------
-		-0.25f, 0.25f, -0.99f,	// vertex 4: position 
-		0.0f, 1.0f, 0.0f,		// vertex 4: normal
-		0.0f, 0.0f,				// vertex 4: texture coordinate 
-
-		0.25f, 0.25f, -0.99f,	// vertex 5: position 
-		0.0f, 1.0f, 0.0f,		// vertex 5: normal
-		1.0f, 0.0f,				// vertex 5: texture coordinate 
-
-		-0.25f, 0.75f, -0.99f,	// vertex 6: position
-		0.0f, 1.0f, 0.0f,		// vertex 6: normal
-		0.0f, 1.0f,				// vertex 6: texture coordinate 
-
-		0.25f, 0.75f, -0.99f,	// vertex 7: position
-		0.0f, 1.0f, 0.0f,		// vertex 7: normal
-		1.0f, 1.0f,				// vertex 7: texture coordinate 
-	};
+	//  for floor and painting (shared with lightbake, see RoomGeometry.h)
+	vector<GLfloat> texturedVertices = roomTexturedVertices();
 	// for walls
-	vector<GLfloat> wallVertices = { 
-		// close wall
-		-1.0f, 0.0f, 1.0f,	// vertex 0: position
-		0.0f, 1.0f, 0.0f,	// vertex 0: normal
-		3.0f, 0.0f,			// vertex 0: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 0: tangent
-
-		1.0f, 0.0f, 1.0f,	// vertex 1: position 
-		0.0f, 1.0f, 0.0f,	// vertex 1: normal
-		0.0f, 0.0f,			// vertex 1: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 1: tangent
-
-		-1.0f, 1.0f, 1.0f,	// vertex 2: position 
-		0.0f, 1.0f, 0.0f,	// vertex 2: normal
-		3.0f, 3.0f,			// vertex 2: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 2: tangent
-
-		1.0f, 1.0f, 1.0f,	// vertex 3: position 
-		0.0f, 1.0f, 0.0f,	// vertex 3: normal
-		0.0f, 3.0f,			// vertex 3: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 3: tangent
-		// left wall
-		-1.0f, 0.0f, 1.0f,	// vertex 4: position 
-		0.0f, 1.0f, 0.0f,	// vertex 4: normal
-		0.0f, 0.0f,			// vertex 4: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 4: tangent
-
-		-1.0f, 0.0f, -1.0f,	// vertex 5: position 
-		0.0f, 1.0f, 0.0f,	// vertex 5: normal
-		3.0f, 0.0f,			// vertex 5: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 5: tangent
-
-		-1.0f, 1.0f, 1.0f,	// vertex 6: position
-		0.0f, 1.0f, 0.0f,	// vertex 6: normal
-		0.0f, 3.0f,			// vertex 6: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 6: tangent
-
-		-1.0f, 1.0f, -1.0f,	// vertex 7: position
-		0.0f, 1.0f, 0.0f,	// vertex 7: normal
-		3.0f, 3.0f,			// vertex 7: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 7: tangent
-		// close wall
-		-1.0f, 0.0f, -1.0f,	// vertex 8: position 
-		0.0f, 1.0f, 0.0f,	// vertex 8: normal
-		0.0f, 0.0f,			// vertex 8: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 8: tangent
-
-		1.0f, 0.0f, -1.0f,	// vertex 9: position 
-		0.0f, 1.0f, 0.0f,	// vertex 9: normal
-		3.0f, 0.0f,			// vertex 9: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 9: tangent
-
-		-1.0f, 1.0f, -1.0f,	// vertex 10: position
-		0.0f, 1.0f, 0.0f,	// vertex 10: normal
-		0.0f, 3.0f,			// vertex 10: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 10: tangent
-
-		1.0f, 1.0f, -1.0f,	// vertex 11: position
-		0.0f, 1.0f, 0.0f,	// vertex 11: normal
-		3.0f, 3.0f,			// vertex 11: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 11: tangent
-		// right wall
-		1.0f, 0.0f, -1.0f,	// vertex 12: position 
-		0.0f, 1.0f, 0.0f,	// vertex 12: normal
-		0.0f, 0.0f,			// vertex 12: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 12: tangent
-
-		1.0f, 0.0f, 1.0f,	// vertex 13: position 
-		0.0f, 1.0f, 0.0f,	// vertex 13: normal
-		3.0f, 0.0f,			// vertex 13: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 13: tangent
-
-		1.0f, 1.0f, -1.0f,	// vertex 14: position
-		0.0f, 1.0f, 0.0f,	// vertex 14: normal
-		0.0f, 3.0f,			// vertex 14: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 14: tangent
-
-		1.0f, 1.0f, 1.0f,	// vertex 15: position
-		0.0f, 1.0f, 0.0f,	// vertex 15: normal
-		3.0f, 3.0f,			// vertex 15: texture coordinate
-		1.0f, 0.0f, 0.0f,	// vertex 15: tangent
-	}; 
+	vector<GLfloat> wallVertices = roomWallVertices();
 	// vertices for the lines (main view)
 	vector<GLfloat> lineVertices = {
 		0.0f, 400.0f, 1.5f,		// line 1 vertex 0: position
@@ -292,7 +252,7 @@ static void init(GLFWwindow* window) {
 		reinterpret_cast<void*>(offsetof(VertexNormTanTex, normal)));		// specify format of colour data
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexNormTanTex),
 		reinterpret_cast<void*>(offsetof(VertexNormTanTex, texCoord)));		// specify format of texture coordinate data
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTanTex),
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(VertexNormTanTex),
 		reinterpret_cast<void*>(offsetof(VertexNormTanTex, tangent)));		// specify format of tangent data
 
 	glEnableVertexAttribArray(0);	// enable vertex attributes
@@ -302,6 +262,37 @@ static void init(GLFWwindow* window) {
 
 	glBindVertexArray(0); // Unbind the VAO
 
+	// lightmap coordinates of the floor, painting and walls --
+	// laid out as lightbake baked them, in a buffer of their own next to each VAO's vertices
+	vector<RoomSurface> roomQuads = roomSurfaces();
+	vector<LightmapSurface> lightmapSurfaces;
+	for (const RoomSurface& surface : roomQuads)
+		lightmapSurfaces.push_back(surface.quad);
+	vector<LightmapChart> lightmapCharts;
+	if (!packLightmap(lightmapSurfaces, LIGHTMAP_SIZE, lightmapCharts))
+		lightmapCharts.assign(lightmapSurfaces.size(), LightmapChart());
+	vector<vec2> lightmapCoords;
+	for (const LightmapChart& chart : lightmapCharts)
+		lightmapCoords.insert(lightmapCoords.end(), chart.texCoords, chart.texCoords + 4);
+
+	// floor and painting: the first two quads
+	glGenBuffers(1, &gVBO5);
+	glBindBuffer(GL_ARRAY_BUFFER, gVBO5);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vec2) * 8, &lightmapCoords[0], GL_STATIC_DRAW);
+	glBindVertexArray(gVAO1);
+	glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), nullptr);	// specify format of lightmap coordinates
+	glEnableVertexAttribArray(5);
+
+	// walls: the other four
+	glGenBuffers(1, &gVBO6);
+	glBindBuffer(GL_ARRAY_BUFFER, gVBO6);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vec2) * 16, &lightmapCoords[8], GL_STATIC_DRAW);
+	glBindVertexArray(gVAO2);
+	glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), nullptr);
+	glEnableVertexAttribArray(5);
+
+	glBindVertexArray(0); // Unbind the VAO
+
 	// lines --------------------------------------
 	// create VBO
 	glGenBuffers(1, &gVBO3);					// generate unused VBO identifier
@@ -321,6 +312,24 @@ static void init(GLFWwindow* window) {
 	glEnableVertexAttribArray(4);
 
 	glBindVertexArray(0); // Unbind the VAO
+
+	// full screen triangle (deferred lighting pass) ----
+	vector<GLfloat> screenVertices = {
+		-1.0f, -1.0f, 0.0f,		// vertex 0: position
+		3.0f, -1.0f, 0.0f,		// vertex 1: position
+		-1.0f, 3.0f, 0.0f,		// vertex 2: position
+	};
+	glGenBuffers(1, &gVBO4);					// generate unused VBO identifier
+	glBindBuffer(GL_ARRAY_BUFFER, gVBO4);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * screenVertices.size(), &screenVertices[0], GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &gVAO4);			// generate unused VAO identifier
+	glBindVertexArray(gVAO4);				// create VAO
+	glBindBuffer(GL_ARRAY_BUFFER, gVBO4);	// bind the VBO
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), nullptr);	// specify format of position data
+	glEnableVertexAttribArray(0);	// enable vertex attributes
+
+	glBindVertexArray(0); // Unbind the VAO
 }
 
 // key press or release callback function
@@ -372,6 +381,20 @@ TwBar* create_UI(const string name = "Interface") {
 	TwAddVarRW(twBar, "Toggle", TW_TYPE_BOOL16,
 		&gAnimToggle, " group='Animation' ");
 
+	// forward or deferred shading, with the GPU time of each
+	TwAddVarRW(twBar, "Deferred", TW_TYPE_BOOLCPP,
+		&gDeferred, " group='Rendering' ");
+	TwAddVarRO(twBar, "Forward GPU ms", TW_TYPE_FLOAT,
+		&gForwardTime, " group='Rendering' precision=3 ");
+	TwAddVarRO(twBar, "Deferred GPU ms", TW_TYPE_FLOAT,
+		&gDeferredTime, " group='Rendering' precision=3 ");
+
+	// model controls
+	TwAddVarRW(twBar, "Cluster Culling", TW_TYPE_BOOLCPP,
+		&gClusterCulling, " group='Model' ");
+	TwAddVarRW(twBar, "Roughness", TW_TYPE_FLOAT, &gEnvironmentRoughness,
+		" group='Model' min=0.0 max=1.0 step=0.01 ");
+
 	// light controls
 		// 'room' is 2x2 square, keep light close to cube (except y-coord)
 	TwAddVarRW(twBar, "Position X", TW_TYPE_FLOAT, &gLight.pos.x, 
@@ -380,6 +403,17 @@ TwBar* create_UI(const string name = "Interface") {
 		" group='Light' min=0.0 max=5.0 step=0.01 ");
 	TwAddVarRW(twBar, "Position Z", TW_TYPE_FLOAT, &gLight.pos.z, 
 		" group='Light' min=-2.0 max=2.0 step=0.01 "); 
+	TwAddVarRW(twBar, "Scene Lights", TW_TYPE_INT32, &gNumOfSceneLights,
+		" group='Light' min=0 max=256 step=8 ");
+	TwEnumVal lightTypes[] = { { 1, "Point" }, { 2, "Directional" }, { 3, "Spot" } };
+	TwAddVarRW(twBar, "Type", TwDefineEnum("LightType", lightTypes, 3), &gLight.type,
+		" group='Light' ");
+	TwAddVarRW(twBar, "Shadows", TW_TYPE_BOOLCPP, &gShadows,
+		" group='Light' ");
+	TwAddVarRO(twBar, "Shadow Renders", TW_TYPE_INT32, &gShadowRenders,
+		" group='Light' ");
+	TwAddVarRW(twBar, "Baked Lighting", TW_TYPE_BOOLCPP, &gBakedLighting,
+		" group='Light' ");
 
 	// camera controls
 	TwAddVarRW(twBar, "Yaw", TW_TYPE_FLOAT, &gYaw, // look left/right
@@ -439,11 +473,18 @@ void draw_object(string view) {
 	gShader.setUniform("uModelMatrix", gModelMatrix["Ring"]);
 	gShader.setUniform("uNormalMatrix", normalMatrix);
 	gShader.setUniform("uColorSet", 0);
+	gShader.setUniform("uEnvironmentRoughness", gEnvironmentRoughness);
+	gShader.setUniform("uEnvironmentMaxLevel", static_cast<float>(gCubeEnvMap->getNumOfLevels() - 1));
 
 	// set texture
-	glActiveTexture(GL_TEXTURE0);
-	gCubeEnvMap.bind(); 
-	gModel.drawModel();  
+	gCubeEnvMap->bind(0); 
+	// level of detail chosen from the size of the ring in the viewport
+	gModel.setVertexDecoding(gShader);
+	gModel.setClusterCulling(gClusterCulling);
+	gModel.drawModel(gModelMatrix["Ring"], gCamera[view].getViewMatrix(),
+		gCamera[view].getProjMatrix(), gWindowHeight / 2.0f);  
+	gShader.setUniform("uQuantized", false);
+	gShader.setUniform("uFaceNormals", false);
 }
 
 // walls and floor
@@ -468,15 +509,17 @@ void draw_env(string view) {
 	gShader.setUniform("uMaterial.Kd", gMaterials["General"].Kd);
 	gShader.setUniform("uMaterial.shininess", gMaterials["General"].shininess);
 
-	glActiveTexture(GL_TEXTURE1);
-	gTextures["Floor"].bind();
+	// floor and painting are drawn from the atlas without rebinding
+	gTextureAtlas.bind(1);
+	gShader.setUniform("uAtlasRect", gTextureAtlas.getRect("Floor"));
+	gShader.setUniform("uAtlasRepeat", gTextureAtlas.isRepeating("Floor"));
 
 	glBindVertexArray(gVAO1);			// make VAO active
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);	// render the vertices    
 
 	gShader.setUniform("uColorSet", 3);
-	glActiveTexture(GL_TEXTURE4);
-	gTextures["Painting"].bind();
+	gShader.setUniform("uAtlasRect", gTextureAtlas.getRect("Painting"));
+	gShader.setUniform("uAtlasRepeat", gTextureAtlas.isRepeating("Painting"));
 	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);	// render the vertices  
 
 	// set material properties - walls
@@ -485,11 +528,14 @@ void draw_env(string view) {
 	gShader.setUniform("uMaterial.Ks", gMaterials["Wall"].Ks);
 	gShader.setUniform("uMaterial.shininess", gMaterials["Wall"].shininess);
 
+	// stream the wall texture levels this viewport needs (the walls repeat them 3 times)
+	vec2 viewportSize(gWindowWidth / 2.0f, gWindowHeight / 2.0f);
+	gTextureStreamer.requestCoverage(*gTextures["Stone"], MVP, vec3(-1.0f, 0.0f, -1.0f), vec3(1.0f), 3.0f, viewportSize);
+	gTextureStreamer.requestCoverage(*gTextures["StoneNormalMap"], MVP, vec3(-1.0f, 0.0f, -1.0f), vec3(1.0f), 3.0f, viewportSize);
+
 	gShader.setUniform("uColorSet", 2);
-	glActiveTexture(GL_TEXTURE2);
-	gTextures["Stone"].bind();
-	glActiveTexture(GL_TEXTURE3); 
-	gTextures["StoneNormalMap"].bind();
+	gTextures["Stone"]->bind(2);
+	gTextures["StoneNormalMap"]->bind(3);
 
 	glBindVertexArray(gVAO2);			// make VAO active
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);	// render the vertices
@@ -498,6 +544,103 @@ void draw_env(string view) {
 	glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);	// render the vertices    
 }
 
+// shadow casters: the room never moves, the ring does
+void draw_static_casters(const mat4& viewMatrix, const mat4& projMatrix) {
+	gShader.setUniform("uModelViewProjectionMatrix", projMatrix * viewMatrix * gModelMatrix["Env"]);
+
+	glBindVertexArray(gVAO1);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
+	glBindVertexArray(gVAO2);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
+	glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
+}
+
+void draw_dynamic_casters(const mat4& viewMatrix, const mat4& projMatrix) {
+	gShader.setUniform("uModelViewProjectionMatrix", projMatrix * viewMatrix * gModelMatrix["Ring"]);
+
+	gModel.setVertexDecoding(gShader);
+	gModel.setClusterCulling(gClusterCulling);
+	gModel.drawModel(gModelMatrix["Ring"], viewMatrix, projMatrix, static_cast<float>(SHADOW_CUBE_SIZE));
+	gShader.setUniform("uQuantized", false);
+	gShader.setUniform("uFaceNormals", false);
+}
+
+// bring the scene light's shadow maps up to date, drawing only what moved
+void update_shadows() {
+	gShadowRenders = 0;
+	if (!gShadows || gLight.type == 0)
+	{
+		gShadowCache.bind(gShader, -1);
+		return;
+	}
+
+	// the ring moved, or appeared once uploaded
+	mat4 ringMatrix = gModelMatrix["Ring"];
+	bool ringChanged = ringMatrix != gShadowRingMatrix || gModel.isReady() != gShadowRingReady;
+	gShadowRingMatrix = ringMatrix;
+	gShadowRingReady = gModel.isReady();
+
+	vec3 ringCenter = vec3(ringMatrix * vec4(gModel.getCenter(), 1.0f));
+	float ringScale = std::max(length(vec3(ringMatrix[0])), std::max(length(vec3(ringMatrix[1])), length(vec3(ringMatrix[2]))));
+	float ringRadius = gModel.isReady() ? gModel.getRadius() * ringScale : 0.0f;
+
+	gShader.setUniform("uRenderPass", 3);
+	gShadowCache.update(gLight, draw_static_casters, draw_dynamic_casters, ringCenter, ringRadius, ringChanged);
+	gShader.setUniform("uRenderPass", 0);
+	gShadowRenders = gShadowCache.getNumOfStaticRenders() + gShadowCache.getNumOfDynamicRenders();
+
+	// the scene light is first in the light data
+	gShadowCache.bind(gShader, 0);
+}
+
+// bin the lights for a viewport's camera and set it as the drawing area
+void set_viewport(string view, int x, int y, int width, int height) {
+	glViewport(x, y, width, height);
+	gClusteredLighting.bindViewport(gShader, view, gCamera[view].getViewMatrix(),
+		gCamera[view].getProjMatrix(), vec4(x, y, width, height));
+}
+
+// draw a viewport's ring and room, shaded as they are drawn or afterwards from its G-buffer
+void draw_viewport(string view, int x, int y, int width, int height) {
+	set_viewport(view, x, y, width, height);
+
+	if (!gDeferred)
+	{
+		draw_object(view);
+		draw_env(view);
+		return;
+	}
+
+	// geometry pass: surfaces only, into the viewport's G-buffer
+	GBuffer& gBuffer = gGBuffers[view];
+	gBuffer.bindForWriting(width, height);
+	gShader.setUniform("uRenderPass", 1);
+	draw_object(view);
+	draw_env(view);
+
+	// lighting pass: each pixel of the viewport shaded once
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(x, y, width, height);
+	gBuffer.bindTextures();
+	gShader.setUniform("uRenderPass", 2);
+	gShader.setUniform("uViewpoint", gCamera[view].getPosition());
+	gShader.setUniform("uInverseViewProjection",
+		inverse(gCamera[view].getProjMatrix() * gCamera[view].getViewMatrix()));
+	gShader.setUniform("uModelViewProjectionMatrix", mat4(1.0f));
+
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(gVAO4);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glEnable(GL_DEPTH_TEST);
+
+	// the scene's depth for the lines drawn over it
+	gBuffer.blitDepth(x, y);
+	gShader.setUniform("uRenderPass", 0);
+}
+
 // function to render the scene
 static void render_scene() {
 	// clear colour buffer and depth buffer
@@ -507,41 +650,54 @@ static void render_scene() {
 	gShader.use();
 
 	// set light properties 
-	gShader.setUniform("uLight.pos", gLight.pos);
-	gShader.setUniform("uLight.La", gLight.La);
-	gShader.setUniform("uLight.Ld", gLight.Ld);
-	gShader.setUniform("uLight.Ls", gLight.Ls);
-	gShader.setUniform("uLight.att", gLight.att);
+	gShader.setUniform("uAmbient", gLight.La);
+	vector<Light> lights(1, gLight);
+	lights.insert(lights.end(), gSceneLights.begin(), gSceneLights.begin() + gNumOfSceneLights);
+	gClusteredLighting.setLights(lights);
 
 	gShader.setUniform("uEnvironmentSampler", 0);
 	gShader.setUniform("uTextureSampler", 1);
 	gShader.setUniform("uTextureSampler2", 2);
 	gShader.setUniform("uNormalSampler", 3);
-	gShader.setUniform("uTextureSampler3", 4);
+	gShader.setUniform("uGBufferAlbedo", static_cast<int>(GBUFFER_ALBEDO_UNIT));
+	gShader.setUniform("uGBufferNormal", static_cast<int>(GBUFFER_NORMAL_UNIT));
+	gShader.setUniform("uGBufferDepth", static_cast<int>(GBUFFER_DEPTH_UNIT));
+	gShader.setUniform("uLightmap", static_cast<int>(LIGHTMAP_UNIT));
+	gShader.setUniform("uLightmapRange", LIGHTMAP_RANGE);
+	gShader.setUniform("uRenderPass", 0);
+
+	// the lightmap stands in for the scene light on the room while the light is where lightbake
+	// put it (forward shading only, the G-buffer has no room for the baked light)
+	bool bakedLighting = gBakedLighting && gLightmap && !gDeferred && gLight.type == 1
+		&& gLight.pos == ROOM_LIGHT_POSITION && gLight.Ld == ROOM_LIGHT_DIFFUSE && gLight.att == ROOM_LIGHT_ATTENUATION;
+	gShader.setUniform("uBakedLighting", bakedLighting);
+	if (bakedLighting)
+		gLightmap->bind(LIGHTMAP_UNIT);
+
+	// materials of the colour sets for the deferred lighting pass: ring, floor, walls, painting
+	const char* materialNames[] = { "General", "General", "Wall", "General" };
+	for (int i = 0; i < 4; i++)
+	{
+		string prefix = "uMaterials[" + to_string(i) + "].";
+		gShader.setUniform((prefix + "Ka").c_str(), gMaterials[materialNames[i]].Ka);
+		gShader.setUniform((prefix + "Kd").c_str(), gMaterials[materialNames[i]].Kd);
+		gShader.setUniform((prefix + "Ks").c_str(), gMaterials[materialNames[i]].Ks);
+		gShader.setUniform((prefix + "shininess").c_str(), gMaterials[materialNames[i]].shininess);
+	}
+
+	update_shadows();
 
 	/* ==========================================
 	*	DRAW VIEWPORTS
 	========================================== */  
 	// top right ================================
-	glViewport(400, 400, 400, 400);
-
-	draw_object("Top Right");
-
-	draw_env("Top Right");
+	draw_viewport("Top Right", 400, 400, 400, 400);
 
 	// bottom left ==============================
-	glViewport(0, 0, 400, 400);
-
-	draw_object("Bot Left");
-
-	draw_env("Bot Left"); 
+	draw_viewport("Bot Left", 0, 0, 400, 400);
 
 	// bottom right =============================
-	glViewport(400, 0, 400, 400);
-
-	draw_object("Bot Right");
-
-	draw_env("Bot Right");
+	draw_viewport("Bot Right", 400, 0, 400, 400);
 
 	// main =====================================
 	glViewport(0, 0, 800, 800);
@@ -633,11 +789,23 @@ int main(void) {
 	{
 		update_scene(window);	// update the scene  
 
+		gModel.update(gModelUploadBudget);	// continue loading the model
+
+		// time the frame's GPU work in the current shading mode
+		GpuTimer& timer = gDeferred ? gDeferredTimer : gForwardTimer;
+		timer.begin();
 		render_scene();			// render the scene
+		timer.end();
+		gForwardTime = static_cast<float>(gForwardTimer.getMilliseconds());
+		gDeferredTime = static_cast<float>(gDeferredTimer.getMilliseconds());
+
+		gTextureStreamer.update();	// stream texture levels the viewports asked for
 
 		// set polygon render mode to fill
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+		// the tweak bar's font texture relies on its own parameters
+		SamplerCache::unbind(0, 4);
 		TwDraw();				// draw tweak bar
 
 		glfwSwapBuffers(window);	// swap buffers
@@ -660,9 +828,25 @@ int main(void) {
 	glDeleteBuffers(1, &gVBO1);
 	glDeleteBuffers(1, &gVBO2);
 	glDeleteBuffers(1, &gVBO3);
+	glDeleteBuffers(1, &gVBO4);
+	glDeleteBuffers(1, &gVBO5);
+	glDeleteBuffers(1, &gVBO6);
 	glDeleteVertexArrays(1, &gVAO1);
 	glDeleteVertexArrays(1, &gVAO2);
 	glDeleteVertexArrays(1, &gVAO3);
+	glDeleteVertexArrays(1, &gVAO4);
+	// free textures while the context exists
+	gTextures.clear();
+	gTextureStreamer.clear();
+	gCubeEnvMap.reset();
+	gLightmap.reset();
+	gTextureAtlas.clear();
+	gClusteredLighting.clear();
+	gGBuffers.clear();
+	gShadowCache.clear();
+	gForwardTimer.clear();
+	gDeferredTimer.clear();
+	SamplerCache::shared().clear();
 
 	// delete and uninitialise tweak bar
 	TwDeleteBar(tweakBar);
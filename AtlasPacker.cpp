@@ -0,0 +1,227 @@
+#include "AtlasPacker.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// smallest power of two not below a value
+	int nextPowerOfTwo(int value)
+	{
+		int power = 1;
+		while (power < value)
+			power <<= 1;
+		return power;
+	}
+
+	// padded sizes rounded up to the gutter keep every tile aligned to it
+	int paddedSize(int size, int gutter)
+	{
+		return (size + 2 * gutter + gutter - 1) / gutter * gutter;
+	}
+
+	// texel an offset outside the image samples: wrapped around or clamped to the edge
+	int sourceTexel(int texel, int size, bool repeat)
+	{
+		if (repeat)
+			return (texel % size + size) % size;
+		return std::max(0, std::min(size - 1, texel));
+	}
+
+	// place the padded images in an area, in the given order
+	bool packRegions(const std::vector<const MipImage*>& images, const std::vector<size_t>& order,
+		int gutter, int width, int height, std::vector<AtlasRegion>& regions)
+	{
+		SkylinePacker packer(width, height);
+		for (size_t index : order)
+		{
+			const MipImage& image = *images[index];
+			int x, y;
+			if (!packer.insert(paddedSize(image.width, gutter), paddedSize(image.height, gutter), x, y))
+				return false;
+
+			AtlasRegion& region = regions[index];
+			region.x = x + gutter;
+			region.y = y + gutter;
+			region.width = image.width;
+			region.height = image.height;
+			region.offset[0] = static_cast<float>(region.x) / width;
+			region.offset[1] = static_cast<float>(region.y) / height;
+			region.scale[0] = static_cast<float>(region.width) / width;
+			region.scale[1] = static_cast<float>(region.height) / height;
+		}
+		return true;
+	}
+
+	// copy an image and its gutter into the atlas
+	void copyRegion(const MipImage& image, const AtlasRegion& region, bool repeat, int gutter, MipImage& atlas)
+	{
+		size_t texelSize = static_cast<size_t>(atlas.numOfChannels);
+		for (int y = -gutter; y < region.height + gutter; y++)
+		{
+			int sourceY = sourceTexel(y, image.height, repeat);
+			unsigned char* row = &atlas.pixels[((region.y + y) * static_cast<size_t>(atlas.width) + region.x) * texelSize];
+			const unsigned char* sourceRow = &image.pixels[sourceY * static_cast<size_t>(image.width) * texelSize];
+
+			// the image row, then the left and right gutters
+			std::memcpy(row, sourceRow, image.width * texelSize);
+			for (int x = 1; x <= gutter; x++)
+			{
+				std::memcpy(row - x * texelSize, sourceRow + sourceTexel(-x, image.width, repeat) * texelSize, texelSize);
+				std::memcpy(row + (image.width + x - 1) * texelSize,
+					sourceRow + sourceTexel(image.width + x - 1, image.width, repeat) * texelSize, texelSize);
+			}
+		}
+	}
+}
+
+SkylinePacker::SkylinePacker(int width, int height)
+	: mWidth(width), mHeight(height)
+{
+	mSkyline.push_back({ 0, 0, width });
+}
+
+int SkylinePacker::fitHeight(size_t index, int width, int height) const
+{
+	int x = mSkyline[index].x;
+	if (x + width > mWidth)
+		return -1;
+
+	// rest on the highest node under the rectangle
+	int y = 0;
+	for (int remaining = width; remaining > 0; index++)
+	{
+		y = std::max(y, mSkyline[index].y);
+		if (y + height > mHeight)
+			return -1;
+		remaining -= mSkyline[index].width;
+	}
+	return y;
+}
+
+bool SkylinePacker::insert(int width, int height, int& x, int& y)
+{
+	// lowest top edge wins, then the narrowest node to waste less space beside it
+	size_t best = mSkyline.size();
+	int bestTop = mHeight + 1, bestWidth = 0;
+	for (size_t i = 0; i < mSkyline.size(); i++)
+	{
+		int fit = fitHeight(i, width, height);
+		if (fit < 0)
+			continue;
+		if (fit + height < bestTop || (fit + height == bestTop && mSkyline[i].width < bestWidth))
+		{
+			best = i;
+			bestTop = fit + height;
+			bestWidth = mSkyline[i].width;
+		}
+	}
+	if (best == mSkyline.size())
+		return false;
+
+	x = mSkyline[best].x;
+	y = bestTop - height;
+
+	// raise the skyline under the rectangle, trimming the nodes it covers
+	mSkyline.insert(mSkyline.begin() + best, { x, bestTop, width });
+	for (size_t i = best + 1; i < mSkyline.size();)
+	{
+		int covered = x + width - mSkyline[i].x;
+		if (covered <= 0)
+			break;
+		if (covered < mSkyline[i].width)
+		{
+			mSkyline[i].x += covered;
+			mSkyline[i].width -= covered;
+			break;
+		}
+		mSkyline.erase(mSkyline.begin() + i);
+	}
+
+	// join neighbours at the same height
+	for (size_t i = 0; i + 1 < mSkyline.size();)
+	{
+		if (mSkyline[i].y == mSkyline[i + 1].y)
+		{
+			mSkyline[i].width += mSkyline[i + 1].width;
+			mSkyline.erase(mSkyline.begin() + i + 1);
+		}
+		else
+		{
+			i++;
+		}
+	}
+	return true;
+}
+
+bool buildAtlas(const std::vector<const MipImage*>& images, const std::vector<bool>& repeat,
+	int gutter, int maxSize, MipImage& atlas, std::vector<AtlasRegion>& regions)
+{
+	if (images.empty() || repeat.size() != images.size())
+		return false;
+
+	// tiles are aligned to the gutter, so it has to be a power of two
+	gutter = nextPowerOfTwo(std::max(gutter, 1));
+
+	int numOfChannels = images[0]->numOfChannels;
+	size_t area = 0;
+	for (const MipImage* image : images)
+	{
+		if (image->numOfChannels != numOfChannels || image->width <= 0 || image->height <= 0)
+			return false;
+		area += static_cast<size_t>(paddedSize(image->width, gutter)) * paddedSize(image->height, gutter);
+	}
+
+	// tallest images first keep the skyline flat
+	std::vector<size_t> order(images.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b)
+	{
+		return images[a]->height > images[b]->height
+			|| (images[a]->height == images[b]->height && images[a]->width > images[b]->width);
+	});
+
+	// grow from the smallest power of two area that could hold everything, widening first
+	int width = 1, height = 1;
+	while (static_cast<size_t>(width) * height < area)
+	{
+		if (width <= height)
+			width <<= 1;
+		else
+			height <<= 1;
+	}
+
+	if (width > maxSize || height > maxSize)
+		return false;
+
+	regions.assign(images.size(), AtlasRegion());
+	while (!packRegions(images, order, gutter, width, height, regions))
+	{
+		if (width <= height)
+			width <<= 1;
+		else
+			height <<= 1;
+		if (width > maxSize || height > maxSize)
+			return false;
+	}
+
+	atlas.width = width;
+	atlas.height = height;
+	atlas.numOfChannels = numOfChannels;
+	atlas.pixels.assign(static_cast<size_t>(width) * height * numOfChannels, 0);
+	for (size_t i = 0; i < images.size(); i++)
+		copyRegion(*images[i], regions[i], repeat[i], gutter, atlas);
+
+	return true;
+}
+
+int numOfAtlasLevels(int gutter, int smallestSize, int blockSize)
+{
+	// a level is clean while at least one gutter block and one image texel remain
+	gutter = nextPowerOfTwo(std::max(gutter, 1));
+	int numOfLevels = 1;
+	while ((gutter >> numOfLevels) >= blockSize && (smallestSize >> numOfLevels) > 0)
+		numOfLevels++;
+	return numOfLevels;
+}
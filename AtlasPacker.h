@@ -0,0 +1,65 @@
+#ifndef ATLAS_PACKER_H
+#define ATLAS_PACKER_H
+
+#include "MipGenerator.h"
+
+#include <cstddef>
+#include <vector>
+
+/*****************************************************************
+ * texture atlas layout
+ *
+ * rectangles are placed bottom-left first on a skyline (the top
+ * edge of everything placed so far); each image is surrounded by
+ * a gutter of texels copied from its own edges (clamped) or from
+ * its opposite edges (repeating), and every tile starts on a
+ * multiple of the gutter so the box filtered levels of the atlas
+ * never mix neighbouring images until the gutter is used up
+ *****************************************************************/
+
+const int DEFAULT_ATLAS_GUTTER = 8;		// keeps levels 0 to 3 of the atlas clean
+const int MAX_ATLAS_SIZE = 4096;
+
+// skyline bottom-left rectangle packer for a fixed size area
+class SkylinePacker
+{
+public:
+	SkylinePacker(int width, int height);
+
+	// place a rectangle, false if it does not fit
+	bool insert(int width, int height, int& x, int& y);
+
+private:
+	// a horizontal segment of the skyline
+	struct Node
+	{
+		int x, y, width;
+	};
+
+	// height the rectangle would rest at over the nodes starting at index, -1 if it does not fit
+	int fitHeight(size_t index, int width, int height) const;
+
+	int mWidth, mHeight;
+	std::vector<Node> mSkyline;		// ordered by x, covering the full width
+};
+
+// an image placed in the atlas
+struct AtlasRegion
+{
+	int x = 0, y = 0;				// bottom-left texel of the image (inside the gutter)
+	int width = 0, height = 0;
+	float offset[2] = { 0.0f, 0.0f };	// image texture coordinates to atlas texture coordinates
+	float scale[2] = { 1.0f, 1.0f };
+};
+
+// pack images with the same number of channels into one power of two atlas;
+// repeat flags which images are tiled (their gutters wrap around), regions
+// are returned in image order; false if the images differ or do not fit
+bool buildAtlas(const std::vector<const MipImage*>& images, const std::vector<bool>& repeat,
+	int gutter, int maxSize, MipImage& atlas, std::vector<AtlasRegion>& regions);
+
+// levels of an atlas that are still clean for a gutter and the smallest image size;
+// compressed atlases need the gutter to cover whole blocks of blockSize texels
+int numOfAtlasLevels(int gutter, int smallestSize, int blockSize = 1);
+
+#endif
@@ -0,0 +1,60 @@
+#include "BitmapView.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+	// file header (14 bytes) and BITMAPINFOHEADER fields
+	const size_t PIXEL_OFFSET_FIELD = 10;
+	const size_t INFO_SIZE_FIELD = 14;
+	const size_t WIDTH_FIELD = 18;
+	const size_t HEIGHT_FIELD = 22;
+	const size_t PLANES_FIELD = 26;
+	const size_t BITS_FIELD = 28;
+	const size_t COMPRESSION_FIELD = 30;
+	const size_t INFO_HEADER_END = 54;
+
+	const uint32_t MIN_INFO_SIZE = 40;
+	const uint32_t BI_RGB = 0;
+
+	// little endian field of a BMP header
+	template <typename T>
+	T readField(const unsigned char* data, size_t offset)
+	{
+		T value;
+		std::memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+}
+
+bool viewBitmap(const unsigned char* data, size_t size, BitmapView& view)
+{
+	if (data == nullptr || size < INFO_HEADER_END || data[0] != 'B' || data[1] != 'M')
+		return false;
+
+	uint32_t pixelOffset = readField<uint32_t>(data, PIXEL_OFFSET_FIELD);
+	uint32_t infoSize = readField<uint32_t>(data, INFO_SIZE_FIELD);
+	int32_t width = readField<int32_t>(data, WIDTH_FIELD);
+	int32_t height = readField<int32_t>(data, HEIGHT_FIELD);
+	uint16_t planes = readField<uint16_t>(data, PLANES_FIELD);
+	uint16_t bitsPerPixel = readField<uint16_t>(data, BITS_FIELD);
+	uint32_t compression = readField<uint32_t>(data, COMPRESSION_FIELD);
+
+	// negative heights are top-down and would need flipping
+	if (infoSize < MIN_INFO_SIZE || width <= 0 || height <= 0 || planes != 1
+		|| (bitsPerPixel != 24 && bitsPerPixel != 32) || compression != BI_RGB)
+		return false;
+
+	// rows are padded to four bytes
+	size_t rowBytes = (static_cast<size_t>(width) * bitsPerPixel / 8 + 3) & ~static_cast<size_t>(3);
+	if (pixelOffset < INFO_HEADER_END || pixelOffset > size || rowBytes * height > size - pixelOffset)
+		return false;
+
+	view.pixels = data + pixelOffset;
+	view.width = width;
+	view.height = height;
+	view.bitsPerPixel = bitsPerPixel;
+	view.rowBytes = rowBytes;
+	return true;
+}
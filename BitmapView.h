@@ -0,0 +1,27 @@
+#ifndef BITMAP_VIEW_H
+#define BITMAP_VIEW_H
+
+#include <cstddef>
+
+/*****************************************************************
+ * pixels of an uncompressed BMP file read in place
+ *
+ * bottom-up BMPs store their first row at the bottom, as OpenGL
+ * expects, with rows padded to four bytes, so a mapped file can
+ * be uploaded as GL_BGR / GL_BGRA with GL_UNPACK_ALIGNMENT 4 and
+ * no copy or flip. other bitmaps (palettes, RLE, bit fields,
+ * top-down rows) are left to a general decoder
+ *****************************************************************/
+struct BitmapView
+{
+	const unsigned char* pixels = nullptr;	// first (bottom) row
+	int width = 0;
+	int height = 0;
+	int bitsPerPixel = 0;					// 24 (BGR) or 32 (BGRA)
+	size_t rowBytes = 0;					// including padding
+};
+
+// true if the file is a BMP the view can describe
+bool viewBitmap(const unsigned char* data, size_t size, BitmapView& view);
+
+#endif
@@ -0,0 +1,500 @@
+#include "BlockCompressor.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_COMPRESSOR_SSE
+#endif
+
+namespace
+{
+	// block rows per parallel range
+	const size_t BLOCK_ROW_GRAIN = 4;
+
+	// iterations finding the principal axis of a block's colours
+	const int POWER_ITERATIONS = 8;
+
+	const int TEXELS_PER_BLOCK = BLOCK_SIZE * BLOCK_SIZE;
+
+	// four values of one channel
+	struct Lanes
+	{
+#ifdef BLOCK_COMPRESSOR_SSE
+		__m128 value;
+#else
+		float value[4];
+#endif
+	};
+
+	inline Lanes loadLanes(const float* source)
+	{
+		Lanes lanes;
+#ifdef BLOCK_COMPRESSOR_SSE
+		lanes.value = _mm_loadu_ps(source);
+#else
+		std::copy_n(source, 4, lanes.value);
+#endif
+		return lanes;
+	}
+
+	inline void storeLanes(float* destination, const Lanes& lanes)
+	{
+#ifdef BLOCK_COMPRESSOR_SSE
+		_mm_storeu_ps(destination, lanes.value);
+#else
+		std::copy_n(lanes.value, 4, destination);
+#endif
+	}
+
+	inline Lanes splat(float value)
+	{
+		Lanes lanes;
+#ifdef BLOCK_COMPRESSOR_SSE
+		lanes.value = _mm_set1_ps(value);
+#else
+		std::fill_n(lanes.value, 4, value);
+#endif
+		return lanes;
+	}
+
+	inline Lanes operator+(const Lanes& a, const Lanes& b)
+	{
+		Lanes result;
+#ifdef BLOCK_COMPRESSOR_SSE
+		result.value = _mm_add_ps(a.value, b.value);
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = a.value[k] + b.value[k];
+#endif
+		return result;
+	}
+
+	inline Lanes operator-(const Lanes& a, const Lanes& b)
+	{
+		Lanes result;
+#ifdef BLOCK_COMPRESSOR_SSE
+		result.value = _mm_sub_ps(a.value, b.value);
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = a.value[k] - b.value[k];
+#endif
+		return result;
+	}
+
+	inline Lanes operator*(const Lanes& a, const Lanes& b)
+	{
+		Lanes result;
+#ifdef BLOCK_COMPRESSOR_SSE
+		result.value = _mm_mul_ps(a.value, b.value);
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = a.value[k] * b.value[k];
+#endif
+		return result;
+	}
+
+	inline Lanes minLanes(const Lanes& a, const Lanes& b)
+	{
+		Lanes result;
+#ifdef BLOCK_COMPRESSOR_SSE
+		result.value = _mm_min_ps(a.value, b.value);
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = std::min(a.value[k], b.value[k]);
+#endif
+		return result;
+	}
+
+	inline Lanes maxLanes(const Lanes& a, const Lanes& b)
+	{
+		Lanes result;
+#ifdef BLOCK_COMPRESSOR_SSE
+		result.value = _mm_max_ps(a.value, b.value);
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = std::max(a.value[k], b.value[k]);
+#endif
+		return result;
+	}
+
+	// where x < y take a, else b
+	inline Lanes selectLess(const Lanes& x, const Lanes& y, const Lanes& a, const Lanes& b)
+	{
+		Lanes result;
+#ifdef BLOCK_COMPRESSOR_SSE
+		__m128 mask = _mm_cmplt_ps(x.value, y.value);
+		result.value = _mm_or_ps(_mm_and_ps(mask, a.value), _mm_andnot_ps(mask, b.value));
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = x.value[k] < y.value[k] ? a.value[k] : b.value[k];
+#endif
+		return result;
+	}
+
+	inline float sumLanes(const Lanes& lanes)
+	{
+		float values[4];
+		storeLanes(values, lanes);
+		return values[0] + values[1] + values[2] + values[3];
+	}
+
+	inline float minOfLanes(const Lanes& lanes)
+	{
+		float values[4];
+		storeLanes(values, lanes);
+		return std::min(std::min(values[0], values[1]), std::min(values[2], values[3]));
+	}
+
+	inline float maxOfLanes(const Lanes& lanes)
+	{
+		float values[4];
+		storeLanes(values, lanes);
+		return std::max(std::max(values[0], values[1]), std::max(values[2], values[3]));
+	}
+
+	// texels of one block as 0 to 255 floats, one row of 16 per channel (r, g, b, a)
+	struct Block
+	{
+		float channels[4][TEXELS_PER_BLOCK];
+	};
+
+	// gather a block, repeating the last row and column of the image for partial blocks
+	void loadBlock(const MipImage& image, int blockX, int blockY, Block& block)
+	{
+		int numOfChannels = image.numOfChannels;
+		for (int y = 0; y < BLOCK_SIZE; y++)
+		{
+			int sourceY = std::min(blockY * BLOCK_SIZE + y, image.height - 1);
+			for (int x = 0; x < BLOCK_SIZE; x++)
+			{
+				int sourceX = std::min(blockX * BLOCK_SIZE + x, image.width - 1);
+				const unsigned char* texel = &image.pixels[(static_cast<size_t>(sourceY) * image.width + sourceX) * numOfChannels];
+				int i = y * BLOCK_SIZE + x;
+				block.channels[0][i] = texel[0];
+				block.channels[1][i] = numOfChannels >= 2 ? texel[1] : texel[0];
+				block.channels[2][i] = numOfChannels >= 3 ? texel[2] : (numOfChannels == 1 ? texel[0] : 0.0f);
+				block.channels[3][i] = numOfChannels == 4 ? texel[3] : 255.0f;
+			}
+		}
+	}
+
+	void writeLittleEndian(unsigned char* destination, uint64_t value, int numOfBytes)
+	{
+		for (int i = 0; i < numOfBytes; i++)
+			destination[i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+
+	// endpoint colour as RGB565 and as the colour a decoder expands it to
+	struct Endpoint
+	{
+		uint16_t packed;
+		float colour[3];
+	};
+
+	Endpoint quantizeEndpoint(const float colour[3])
+	{
+		static const int bits[3] = { 5, 6, 5 };
+		int quantized[3];
+		Endpoint endpoint;
+		for (int c = 0; c < 3; c++)
+		{
+			int maximum = (1 << bits[c]) - 1;
+			quantized[c] = static_cast<int>(std::floor(std::max(0.0f, std::min(255.0f, colour[c])) * maximum / 255.0f + 0.5f));
+			// bit replication, as the hardware expands endpoints
+			endpoint.colour[c] = static_cast<float>((quantized[c] << (8 - bits[c])) | (quantized[c] >> (2 * bits[c] - 8)));
+		}
+		endpoint.packed = static_cast<uint16_t>((quantized[0] << 11) | (quantized[1] << 5) | quantized[2]);
+		return endpoint;
+	}
+
+	// nearest of the four palette colours for every texel; returns the summed squared error
+	float selectColourIndices(const Block& block, const Endpoint& first, const Endpoint& second,
+		float indices[TEXELS_PER_BLOCK])
+	{
+		// palette order of the four colour mode: first, second, 2/3 first, 1/3 first
+		Lanes palette[4][3];
+		for (int c = 0; c < 3; c++)
+		{
+			float a = first.colour[c], b = second.colour[c];
+			palette[0][c] = splat(a);
+			palette[1][c] = splat(b);
+			palette[2][c] = splat((2.0f * a + b) / 3.0f);
+			palette[3][c] = splat((a + 2.0f * b) / 3.0f);
+		}
+
+		Lanes error = splat(0.0f);
+		for (int i = 0; i < TEXELS_PER_BLOCK; i += 4)
+		{
+			Lanes texel[3] = { loadLanes(&block.channels[0][i]), loadLanes(&block.channels[1][i]), loadLanes(&block.channels[2][i]) };
+			Lanes best = splat(3.0f * 256.0f * 256.0f);
+			Lanes bestIndex = splat(0.0f);
+			for (int k = 0; k < 4; k++)
+			{
+				Lanes r = texel[0] - palette[k][0], g = texel[1] - palette[k][1], b = texel[2] - palette[k][2];
+				Lanes distance = r * r + g * g + b * b;
+				bestIndex = selectLess(distance, best, splat(static_cast<float>(k)), bestIndex);
+				best = minLanes(distance, best);
+			}
+			storeLanes(&indices[i], bestIndex);
+			error = error + best;
+		}
+		return sumLanes(error);
+	}
+
+	// least squares endpoints for fixed palette indices; false if they are degenerate
+	bool refineEndpoints(const Block& block, const float indices[TEXELS_PER_BLOCK], float first[3], float second[3])
+	{
+		// weight of the first endpoint for each palette index
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[3] = {}, bx[3] = {};
+		for (int i = 0; i < TEXELS_PER_BLOCK; i++)
+		{
+			float a = weights[static_cast<int>(indices[i])];
+			float b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 3; c++)
+			{
+				ax[c] += a * block.channels[c][i];
+				bx[c] += b * block.channels[c][i];
+			}
+		}
+
+		float determinant = aa * bb - ab * ab;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		for (int c = 0; c < 3; c++)
+		{
+			first[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+			second[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+		}
+		return true;
+	}
+
+	// 8 byte BC1 colour block
+	void encodeColourBlock(const Block& block, unsigned char* destination)
+	{
+		Lanes sum[3], minimum[3], maximum[3];
+		for (int c = 0; c < 3; c++)
+		{
+			sum[c] = splat(0.0f);
+			minimum[c] = splat(255.0f);
+			maximum[c] = splat(0.0f);
+			for (int i = 0; i < TEXELS_PER_BLOCK; i += 4)
+			{
+				Lanes texel = loadLanes(&block.channels[c][i]);
+				sum[c] = sum[c] + texel;
+				minimum[c] = minLanes(minimum[c], texel);
+				maximum[c] = maxLanes(maximum[c], texel);
+			}
+		}
+
+		float mean[3], axis[3];
+		for (int c = 0; c < 3; c++)
+		{
+			mean[c] = sumLanes(sum[c]) / TEXELS_PER_BLOCK;
+			axis[c] = maxOfLanes(maximum[c]) - minOfLanes(minimum[c]);
+		}
+
+		// covariance of the colours (xx, xy, xz, yy, yz, zz)
+		Lanes products[6];
+		for (int k = 0; k < 6; k++)
+			products[k] = splat(0.0f);
+		for (int i = 0; i < TEXELS_PER_BLOCK; i += 4)
+		{
+			Lanes r = loadLanes(&block.channels[0][i]) - splat(mean[0]);
+			Lanes g = loadLanes(&block.channels[1][i]) - splat(mean[1]);
+			Lanes b = loadLanes(&block.channels[2][i]) - splat(mean[2]);
+			products[0] = products[0] + r * r;
+			products[1] = products[1] + r * g;
+			products[2] = products[2] + r * b;
+			products[3] = products[3] + g * g;
+			products[4] = products[4] + g * b;
+			products[5] = products[5] + b * b;
+		}
+		float covariance[6];
+		for (int k = 0; k < 6; k++)
+			covariance[k] = sumLanes(products[k]);
+
+		// principal axis by power iteration, starting along the bounding box diagonal
+		if (axis[0] + axis[1] + axis[2] <= 0.0f)
+			axis[0] = axis[1] = axis[2] = 1.0f;
+		for (int iteration = 0; iteration < POWER_ITERATIONS; iteration++)
+		{
+			float next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+			float largest = std::max(std::abs(next[0]), std::max(std::abs(next[1]), std::abs(next[2])));
+			if (largest <= 0.0f)
+				break;
+			for (int c = 0; c < 3; c++)
+				axis[c] = next[c] / largest;
+		}
+		float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		for (int c = 0; c < 3; c++)
+			axis[c] /= length;
+
+		// extent of the texels along the axis
+		Lanes lowest = splat(1e9f), highest = splat(-1e9f);
+		for (int i = 0; i < TEXELS_PER_BLOCK; i += 4)
+		{
+			Lanes projection = (loadLanes(&block.channels[0][i]) - splat(mean[0])) * splat(axis[0])
+				+ (loadLanes(&block.channels[1][i]) - splat(mean[1])) * splat(axis[1])
+				+ (loadLanes(&block.channels[2][i]) - splat(mean[2])) * splat(axis[2]);
+			lowest = minLanes(lowest, projection);
+			highest = maxLanes(highest, projection);
+		}
+		float low = minOfLanes(lowest), high = maxOfLanes(highest);
+
+		float colour[2][3];
+		for (int c = 0; c < 3; c++)
+		{
+			colour[0][c] = mean[c] + axis[c] * high;
+			colour[1][c] = mean[c] + axis[c] * low;
+		}
+		Endpoint first = quantizeEndpoint(colour[0]), second = quantizeEndpoint(colour[1]);
+		float indices[TEXELS_PER_BLOCK];
+		float error = selectColourIndices(block, first, second, indices);
+
+		// one least squares step, kept if it lowers the error
+		if (error > 0.0f && refineEndpoints(block, indices, colour[0], colour[1]))
+		{
+			Endpoint refinedFirst = quantizeEndpoint(colour[0]), refinedSecond = quantizeEndpoint(colour[1]);
+			float refinedIndices[TEXELS_PER_BLOCK];
+			if (selectColourIndices(block, refinedFirst, refinedSecond, refinedIndices) < error)
+			{
+				first = refinedFirst;
+				second = refinedSecond;
+				std::copy_n(refinedIndices, TEXELS_PER_BLOCK, indices);
+			}
+		}
+
+		// the four colour mode needs the first endpoint larger; swapping exchanges index 0 with 1 and 2 with 3
+		uint32_t flip = 0;
+		if (first.packed < second.packed)
+		{
+			std::swap(first, second);
+			flip = 1;
+		}
+
+		uint32_t bits = 0;
+		if (first.packed != second.packed)
+		{
+			for (int i = 0; i < TEXELS_PER_BLOCK; i++)
+				bits |= ((static_cast<uint32_t>(indices[i]) ^ flip) & 3u) << (2 * i);
+		}
+
+		writeLittleEndian(destination, first.packed, 2);
+		writeLittleEndian(destination + 2, second.packed, 2);
+		writeLittleEndian(destination + 4, bits, 4);
+	}
+
+	// 8 byte BC4 block of one channel (BC3 alpha, each BC5 channel)
+	void encodeChannelBlock(const float values[TEXELS_PER_BLOCK], unsigned char* destination)
+	{
+		Lanes lowest = splat(255.0f), highest = splat(0.0f);
+		for (int i = 0; i < TEXELS_PER_BLOCK; i += 4)
+		{
+			lowest = minLanes(lowest, loadLanes(&values[i]));
+			highest = maxLanes(highest, loadLanes(&values[i]));
+		}
+		int first = static_cast<int>(std::floor(maxOfLanes(highest) + 0.5f));
+		int second = static_cast<int>(std::floor(minOfLanes(lowest) + 0.5f));
+
+		// eight value mode (first > second): position p from second (0) to first (7),
+		// stored as index 1 for p = 0, 0 for p = 7 and 8 - p in between
+		uint64_t bits = 0;
+		if (first > second)
+		{
+			float positions[TEXELS_PER_BLOCK];
+			Lanes scale = splat(7.0f / (first - second));
+			for (int i = 0; i < TEXELS_PER_BLOCK; i += 4)
+				storeLanes(&positions[i], (loadLanes(&values[i]) - splat(static_cast<float>(second))) * scale + splat(0.5f));
+
+			for (int i = 0; i < TEXELS_PER_BLOCK; i++)
+			{
+				int position = std::max(0, std::min(7, static_cast<int>(positions[i])));
+				uint64_t index = position == 7 ? 0 : (position == 0 ? 1 : 8 - position);
+				bits |= index << (3 * i);
+			}
+		}
+
+		destination[0] = static_cast<unsigned char>(first);
+		destination[1] = static_cast<unsigned char>(second);
+		writeLittleEndian(destination + 2, bits, 6);
+	}
+
+	void encodeBlock(const Block& block, BlockFormat format, unsigned char* destination)
+	{
+		switch (format)
+		{
+		case BLOCK_FORMAT_BC1:
+			encodeColourBlock(block, destination);
+			break;
+		case BLOCK_FORMAT_BC3:
+			encodeChannelBlock(block.channels[3], destination);
+			encodeColourBlock(block, destination + 8);
+			break;
+		case BLOCK_FORMAT_BC5:
+			encodeChannelBlock(block.channels[0], destination);
+			encodeChannelBlock(block.channels[1], destination + 8);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+size_t blockBytes(BlockFormat format)
+{
+	switch (format)
+	{
+	case BLOCK_FORMAT_BC1:
+		return 8;
+	case BLOCK_FORMAT_BC3:
+	case BLOCK_FORMAT_BC5:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t compressedSize(BlockFormat format, int width, int height)
+{
+	size_t blocksAcross = static_cast<size_t>(width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	size_t blocksDown = static_cast<size_t>(height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	return blocksAcross * blocksDown * blockBytes(format);
+}
+
+void compressImage(const MipImage& image, BlockFormat format, std::vector<unsigned char>& blocks)
+{
+	blocks.assign(compressedSize(format, image.width, image.height), 0);
+	if (blocks.empty())
+		return;
+
+	int blocksAcross = (image.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int blocksDown = (image.height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	size_t bytes = blockBytes(format);
+
+	parallelFor(0, blocksDown, BLOCK_ROW_GRAIN, [&](size_t first, size_t last)
+	{
+		Block block;
+		for (size_t blockY = first; blockY < last; blockY++)
+		{
+			for (int blockX = 0; blockX < blocksAcross; blockX++)
+			{
+				loadBlock(image, blockX, static_cast<int>(blockY), block);
+				encodeBlock(block, format, &blocks[(blockY * blocksAcross + blockX) * bytes]);
+			}
+		}
+	});
+}
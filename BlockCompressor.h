@@ -0,0 +1,40 @@
+#ifndef BLOCK_COMPRESSOR_H
+#define BLOCK_COMPRESSOR_H
+
+#include "MipGenerator.h"
+
+#include <cstddef>
+#include <vector>
+
+/*****************************************************************
+ * BC1, BC3 and BC5 (S3TC and RGTC) block compression
+ *
+ * each 4x4 block of colour gets two RGB565 endpoints on the
+ * principal axis of its texels, refined by least squares against
+ * the chosen palette indices; single channels (BC3 alpha, the two
+ * BC5 channels) get min/max endpoints with eight interpolated
+ * values. blocks are encoded four texels at a time with SSE where
+ * available, rows of blocks in parallel on the thread pool
+ *****************************************************************/
+
+enum BlockFormat
+{
+	BLOCK_FORMAT_NONE,		// 8-bit texels, not compressed
+	BLOCK_FORMAT_BC1,		// opaque RGB, 8 bytes per block
+	BLOCK_FORMAT_BC3,		// RGB with alpha, 16 bytes per block
+	BLOCK_FORMAT_BC5		// two channels (normal map x and y), 16 bytes per block
+};
+
+// width and height of a block in texels
+const int BLOCK_SIZE = 4;
+
+// bytes of one block, 0 for BLOCK_FORMAT_NONE
+size_t blockBytes(BlockFormat format);
+// bytes of a compressed image, partial blocks at the edges included
+size_t compressedSize(BlockFormat format, int width, int height);
+
+// compress an 8-bit image (rows in GL order, as generateMipChain produces them);
+// missing colour channels repeat the first (grey) or are zero, missing alpha is opaque
+void compressImage(const MipImage& image, BlockFormat format, std::vector<unsigned char>& blocks);
+
+#endif
@@ -0,0 +1,132 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+	// RGBA32F texels per light in the light data buffer
+	const int LIGHT_DATA_TEXELS = 5;
+}
+
+ClusteredLighting::ClusteredLighting()
+{
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+	clear();
+}
+
+void ClusteredLighting::setLights(const std::vector<Light>& lights)
+{
+	mLights.clear();
+	std::vector<glm::vec4> data;
+	for (const Light& light : lights)
+	{
+		if (light.type < CLUSTER_LIGHT_POINT || light.type > CLUSTER_LIGHT_SPOT)
+			continue;
+
+		// range of the brightest channel
+		glm::vec3 peak = light.Ld + light.Ls;
+		ClusterLight clusterLight;
+		clusterLight.type = light.type;
+		clusterLight.position = light.pos;
+		clusterLight.direction = light.type == CLUSTER_LIGHT_POINT ? glm::vec3(0.0f, -1.0f, 0.0f) : glm::normalize(light.dir);
+		clusterLight.range = light.type == CLUSTER_LIGHT_DIRECTIONAL ? LIGHT_RANGE_INFINITE
+			: lightRange(light.att, std::max(peak.x, std::max(peak.y, peak.z)));
+		clusterLight.cosOuterAngle = light.type == CLUSTER_LIGHT_SPOT ? std::cos(glm::radians(light.outerAngle)) : -1.0f;
+		mLights.push_back(clusterLight);
+
+		float cosInnerAngle = light.type == CLUSTER_LIGHT_SPOT ? std::cos(glm::radians(light.innerAngle)) : -1.0f;
+		data.push_back(glm::vec4(clusterLight.position, static_cast<float>(light.type)));
+		data.push_back(glm::vec4(clusterLight.direction, clusterLight.range));
+		data.push_back(glm::vec4(light.Ld, cosInnerAngle));
+		data.push_back(glm::vec4(light.Ls, clusterLight.cosOuterAngle));
+		data.push_back(glm::vec4(light.att, 0.0f));
+	}
+
+	// buffers cannot be empty
+	if (data.empty())
+		data.resize(LIGHT_DATA_TEXELS, glm::vec4(0.0f));
+	upload(mLightData, GL_RGBA32F, data.data(), data.size() * sizeof(glm::vec4));
+	mAssignTime = 0.0;
+}
+
+void ClusteredLighting::bindViewport(ShaderProgram& shader, const std::string& name, const glm::mat4& viewMatrix,
+	const glm::mat4& projMatrix, const glm::vec4& viewport)
+{
+	std::unique_ptr<Viewport>& entry = mViewports[name];
+	if (!entry)
+		entry.reset(new Viewport());
+
+	auto startTime = std::chrono::steady_clock::now();
+	entry->grid.assign(mLights, viewMatrix, projMatrix);
+	std::chrono::duration<double, std::milli> assignTime = std::chrono::steady_clock::now() - startTime;
+	mAssignTime += assignTime.count();
+
+	const std::vector<uint32_t>& ranges = entry->grid.getClusterRanges();
+	std::vector<uint32_t> indices = entry->grid.getLightIndices();
+	mNumOfAssignments = indices.size();
+	if (indices.empty())
+		indices.push_back(0);
+	upload(entry->ranges, GL_RG32UI, ranges.data(), ranges.size() * sizeof(uint32_t));
+	upload(entry->indices, GL_R32UI, indices.data(), indices.size() * sizeof(uint32_t));
+
+	glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, mLightData.texture);
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_RANGE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, entry->ranges.texture);
+	glActiveTexture(GL_TEXTURE0 + LIGHT_INDEX_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, entry->indices.texture);
+
+	shader.setUniform("uLightData", static_cast<int>(LIGHT_DATA_UNIT));
+	shader.setUniform("uClusterRanges", static_cast<int>(CLUSTER_RANGE_UNIT));
+	shader.setUniform("uLightIndices", static_cast<int>(LIGHT_INDEX_UNIT));
+	shader.setUniform("uClusterGrid", glm::ivec3(CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES));
+	shader.setUniform("uClusterViewport", viewport);
+	shader.setUniform("uClusterSlicing", entry->grid.getSliceScaleBias());
+	shader.setUniform("uViewMatrix", viewMatrix);
+}
+
+void ClusteredLighting::clear()
+{
+	release(mLightData);
+	for (auto& viewport : mViewports)
+	{
+		release(viewport.second->ranges);
+		release(viewport.second->indices);
+	}
+	mViewports.clear();
+	mLights.clear();
+}
+
+void ClusteredLighting::upload(BufferTexture& target, GLenum internalFormat, const void* data, size_t bytes)
+{
+	if (target.buffer == 0)
+	{
+		glGenBuffers(1, &target.buffer);
+		glGenTextures(1, &target.texture);
+	}
+
+	// orphan the storage so the previous frame's draws keep theirs
+	glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+	glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, target.texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, target.buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::release(BufferTexture& target)
+{
+	if (target.buffer != 0)
+	{
+		glDeleteTextures(1, &target.texture);
+		glDeleteBuffers(1, &target.buffer);
+		target = BufferTexture();
+	}
+}
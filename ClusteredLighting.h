@@ -0,0 +1,77 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include "LightClusters.h"
+#include "utilities.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// texture units of the light lists (after the scene's material textures)
+const GLuint LIGHT_DATA_UNIT = 4;
+const GLuint CLUSTER_RANGE_UNIT = 5;
+const GLuint LIGHT_INDEX_UNIT = 6;
+
+/*****************************************************************
+ * clustered forward lighting
+ *
+ * the scene's lights are uploaded once a frame to a texture
+ * buffer; each viewport bins them into its own cluster grid (see
+ * LightClusterGrid) and uploads the per cluster ranges and light
+ * indices to texture buffers of its own, so the fragment shader
+ * loops over the few lights of its cluster instead of all of them
+ * (texture buffers rather than storage buffers, which need
+ * OpenGL 4.3)
+ *****************************************************************/
+class ClusteredLighting
+{
+public:
+	ClusteredLighting();
+	~ClusteredLighting();
+
+	ClusteredLighting(const ClusteredLighting&) = delete;
+	ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+	// world space lights for this frame (lights switched off are left out)
+	void setLights(const std::vector<Light>& lights);
+	// bin the lights for a viewport's camera, then bind its lists and set the shader's
+	// cluster uniforms for drawing it (viewport: origin and size in pixels)
+	void bindViewport(ShaderProgram& shader, const std::string& name, const glm::mat4& viewMatrix,
+		const glm::mat4& projMatrix, const glm::vec4& viewport);
+	// free the buffers while the context exists
+	void clear();
+
+	size_t getNumOfLights() const { return mLights.size(); }
+	// light indices in the last bound viewport's clusters, summed over clusters
+	size_t getNumOfAssignments() const { return mNumOfAssignments; }
+	// milliseconds spent binning lights for all viewports since the last setLights
+	double getAssignTime() const { return mAssignTime; }
+
+private:
+	// buffer object read through a buffer texture
+	struct BufferTexture
+	{
+		GLuint buffer = 0;
+		GLuint texture = 0;
+	};
+
+	struct Viewport
+	{
+		LightClusterGrid grid;
+		BufferTexture ranges;
+		BufferTexture indices;
+	};
+
+	std::vector<ClusterLight> mLights;
+	BufferTexture mLightData;
+	std::map<std::string, std::unique_ptr<Viewport>> mViewports;
+	size_t mNumOfAssignments = 0;
+	double mAssignTime = 0.0;
+
+	static void upload(BufferTexture& target, GLenum internalFormat, const void* data, size_t bytes);
+	static void release(BufferTexture& target);
+};
+
+#endif
@@ -0,0 +1,156 @@
+#include "CookedTexture.h"
+#include "MeshCache.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const char COOKED_TEXTURE_MAGIC[4] = { 'C', 'T', 'E', 'X' };
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + COOKED_TEXTURE_ALIGNMENT - 1) / COOKED_TEXTURE_ALIGNMENT * COOKED_TEXTURE_ALIGNMENT;
+	}
+}
+
+std::string cookedTexturePath(const std::string& image)
+{
+	size_t dot = image.find_last_of('.');
+	size_t slash = image.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return image + ".ctex";
+	return image.substr(0, dot) + ".ctex";
+}
+
+const CookedTextureHeader* openCookedTexture(MappedFile& file, const std::string& path,
+	uint64_t sourceHash, const CookedTextureLevel*& levels)
+{
+	if (!file.open(path))
+		return nullptr;
+
+	const CookedTextureHeader* header = reinterpret_cast<const CookedTextureHeader*>(file.data());
+
+	// reject foreign, outdated or stale files
+	bool isValid = file.size() >= sizeof(CookedTextureHeader)
+		&& std::memcmp(header->magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC)) == 0
+		&& header->version == COOKED_TEXTURE_VERSION
+		&& (sourceHash == 0 || header->sourceHash == sourceHash)
+		&& header->numOfChannels >= 1 && header->numOfChannels <= 4
+		&& (header->numOfFaces == 1 || header->numOfFaces == 6)
+		&& header->numOfLevels >= 1 && header->numOfLevels <= MAX_COOKED_LEVELS
+		&& header->blockFormat <= BLOCK_FORMAT_BC5
+		&& sizeof(CookedTextureHeader) + header->numOfLevels * header->numOfFaces * sizeof(CookedTextureLevel) <= file.size();
+
+	// and truncated ones
+	levels = reinterpret_cast<const CookedTextureLevel*>(file.data() + sizeof(CookedTextureHeader));
+	BlockFormat format = isValid ? static_cast<BlockFormat>(header->blockFormat) : BLOCK_FORMAT_NONE;
+	for (uint32_t i = 0; isValid && i < header->numOfLevels * header->numOfFaces; i++)
+	{
+		uint64_t bytes = format != BLOCK_FORMAT_NONE ? compressedSize(format, levels[i].width, levels[i].height)
+			: static_cast<uint64_t>(levels[i].width) * levels[i].height * header->numOfChannels;
+		isValid = levels[i].offset <= file.size() && levels[i].bytes <= file.size() - levels[i].offset
+			&& levels[i].bytes == bytes;
+	}
+
+	if (!isValid)
+	{
+		file.close();
+		levels = nullptr;
+		return nullptr;
+	}
+
+	return header;
+}
+
+const CookedTextureHeader* openCookedImage(MappedFile& file, const std::string& image,
+	const CookedTextureLevel*& levels)
+{
+	// the cooked file must match the current source image, if there is one
+	std::string path = cookedTexturePath(image);
+	uint64_t sourceHash = 0;
+	if (path != image)
+	{
+		MappedFile source;
+		if (source.open(image))
+			sourceHash = hashData(source.data(), source.size());
+	}
+
+	return openCookedTexture(file, path, sourceHash, levels);
+}
+
+bool writeCookedTexture(const std::string& path, uint64_t sourceHash, unsigned int flags,
+	const std::vector<std::vector<MipImage>>& faces, BlockFormat format)
+{
+	if (faces.empty() || faces[0].empty() || faces[0].size() > MAX_COOKED_LEVELS)
+		return false;
+
+	CookedTextureHeader header = {};
+	std::memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC));
+	header.version = COOKED_TEXTURE_VERSION;
+	header.sourceHash = sourceHash;
+	header.width = faces[0][0].width;
+	header.height = faces[0][0].height;
+	header.numOfChannels = faces[0][0].numOfChannels;
+	header.numOfFaces = static_cast<uint32_t>(faces.size());
+	header.numOfLevels = static_cast<uint32_t>(faces[0].size());
+	header.flags = flags;
+	header.blockFormat = format;
+
+	// compressed levels in table order
+	std::vector<std::vector<unsigned char>> blocks;
+	if (format != BLOCK_FORMAT_NONE)
+	{
+		for (uint32_t level = 0; level < header.numOfLevels; level++)
+		{
+			for (const std::vector<MipImage>& face : faces)
+			{
+				if (face.size() != header.numOfLevels)
+					return false;
+				blocks.emplace_back();
+				compressImage(face[level], format, blocks.back());
+			}
+		}
+	}
+
+	// level table, then aligned texel data in table order
+	std::vector<CookedTextureLevel> levels;
+	uint64_t offset = sizeof(CookedTextureHeader) + header.numOfLevels * header.numOfFaces * sizeof(CookedTextureLevel);
+	for (uint32_t level = 0; level < header.numOfLevels; level++)
+	{
+		for (const std::vector<MipImage>& face : faces)
+		{
+			if (face.size() != header.numOfLevels)
+				return false;
+
+			const MipImage& image = face[level];
+			CookedTextureLevel record;
+			record.offset = alignOffset(offset);
+			record.bytes = blocks.empty() ? image.pixels.size() : blocks[levels.size()].size();
+			record.width = image.width;
+			record.height = image.height;
+			levels.push_back(record);
+			offset = record.offset + record.bytes;
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(levels.size() * sizeof(CookedTextureLevel)));
+	uint64_t written = sizeof(header) + levels.size() * sizeof(CookedTextureLevel);
+
+	for (uint32_t i = 0; i < levels.size(); i++)
+	{
+		static const char padding[COOKED_TEXTURE_ALIGNMENT] = {};
+		const MipImage& image = faces[i % header.numOfFaces][i / header.numOfFaces];
+		const unsigned char* data = blocks.empty() ? image.pixels.data() : blocks[i].data();
+		file.write(padding, static_cast<std::streamsize>(levels[i].offset - written));
+		file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(levels[i].bytes));
+		written = levels[i].offset + levels[i].bytes;
+	}
+
+	return file.good();
+}
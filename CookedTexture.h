@@ -0,0 +1,71 @@
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BlockCompressor.h"
+#include "MappedFile.h"
+#include "MipGenerator.h"
+
+/*****************************************************************
+ * container of textures cooked offline by texcook
+ *
+ * like KTX, a header and a table of levels are followed by the
+ * 8-bit texels or compressed blocks of every mip level and face
+ * (rows tightly packed, first row at the bottom), so each level of
+ * a mapped file can be passed straight to glTexImage2D or
+ * glCompressedTexImage2D
+ *****************************************************************/
+
+const uint32_t COOKED_TEXTURE_VERSION = 2;
+const uint32_t COOKED_TEXTURE_ALIGNMENT = 16;
+const uint32_t MAX_COOKED_LEVELS = 16;
+
+// one face of one mip level
+struct CookedTextureLevel
+{
+	uint64_t offset;			// from the start of the file
+	uint64_t bytes;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct CookedTextureHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;		// hash of the source image file (see hashData)
+	uint32_t width;
+	uint32_t height;
+	uint32_t numOfChannels;		// 1 to 4
+	uint32_t numOfFaces;		// 1, or 6 for a cube map (+x, -x, +y, -y, +z, -z)
+	uint32_t numOfLevels;		// full chain down to 1x1
+	uint32_t flags;				// MipFlags the levels were filtered with
+	uint32_t blockFormat;		// BlockFormat of the level data (BLOCK_FORMAT_NONE for 8-bit texels)
+	uint32_t reserved;
+	// followed by numOfLevels * numOfFaces CookedTextureLevel records, level major
+};
+
+// cooked file of a source image (extension replaced by .ctex)
+std::string cookedTexturePath(const std::string& image);
+
+// map a cooked texture; sourceHash is checked unless zero
+// returns the header inside the mapping, or nullptr if missing, stale or damaged,
+// and points levels at the level table
+const CookedTextureHeader* openCookedTexture(MappedFile& file, const std::string& path,
+	uint64_t sourceHash, const CookedTextureLevel*& levels);
+
+// map the cooked file of an image if it is current (see cookedTexturePath);
+// a .ctex given directly is opened without a source check
+const CookedTextureHeader* openCookedImage(MappedFile& file, const std::string& image,
+	const CookedTextureLevel*& levels);
+
+// write the mip chains of all faces (generateMipChain output), compressing every level
+// unless format is BLOCK_FORMAT_NONE
+bool writeCookedTexture(const std::string& path, uint64_t sourceHash, unsigned int flags,
+	const std::vector<std::vector<MipImage>>& faces, BlockFormat format = BLOCK_FORMAT_NONE);
+
+#endif
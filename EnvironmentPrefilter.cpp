@@ -0,0 +1,324 @@
+#include "EnvironmentPrefilter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// destination rows per parallel range
+	const size_t PREFILTER_ROW_GRAIN = 4;
+
+	const float PI = 3.14159265f;
+
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	inline Vector operator+(const Vector& a, const Vector& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline Vector operator*(const Vector& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	inline float dot(const Vector& a, const Vector& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline Vector cross(const Vector& a, const Vector& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+	inline Vector normalize(const Vector& a) { return a * (1.0f / std::sqrt(dot(a, a))); }
+
+	float srgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	unsigned char toByte(float value)
+	{
+		return static_cast<unsigned char>(std::floor(std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f));
+	}
+
+	// direction through a face position (s, t in [-1, 1]), as GL's cube map selection defines it
+	Vector faceDirection(int face, float s, float t)
+	{
+		switch (face)
+		{
+		case 0: return { 1.0f, -t, -s };
+		case 1: return { -1.0f, -t, s };
+		case 2: return { s, 1.0f, t };
+		case 3: return { s, -1.0f, -t };
+		case 4: return { s, -t, 1.0f };
+		default: return { -s, -t, -1.0f };
+		}
+	}
+
+	// face and position (s, t in [0, 1]) a direction hits
+	int directionFace(const Vector& direction, float& s, float& t)
+	{
+		float ax = std::abs(direction.x), ay = std::abs(direction.y), az = std::abs(direction.z);
+		int face;
+		float sc, tc, ma;
+		if (ax >= ay && ax >= az)
+		{
+			face = direction.x > 0.0f ? 0 : 1;
+			sc = direction.x > 0.0f ? -direction.z : direction.z;
+			tc = -direction.y;
+			ma = ax;
+		}
+		else if (ay >= az)
+		{
+			face = direction.y > 0.0f ? 2 : 3;
+			sc = direction.x;
+			tc = direction.y > 0.0f ? direction.z : -direction.z;
+			ma = ay;
+		}
+		else
+		{
+			face = direction.z > 0.0f ? 4 : 5;
+			sc = direction.z > 0.0f ? direction.x : -direction.x;
+			tc = -direction.y;
+			ma = az;
+		}
+		s = 0.5f * (sc / ma + 1.0f);
+		t = 0.5f * (tc / ma + 1.0f);
+		return face;
+	}
+
+	// linear RGB cube with a box filtered chain to read samples from
+	struct SourceCube
+	{
+		struct Level
+		{
+			int size;
+			std::vector<float> faces[6];	// RGB rows
+		};
+		std::vector<Level> levels;
+
+		// bilinear within the face a direction hits
+		Vector sampleLevel(const Vector& direction, int level) const
+		{
+			float s, t;
+			int face = directionFace(direction, s, t);
+			const Level& source = levels[level];
+			float x = std::max(0.0f, std::min(s * source.size - 0.5f, source.size - 1.0f));
+			float y = std::max(0.0f, std::min(t * source.size - 0.5f, source.size - 1.0f));
+			int x0 = static_cast<int>(x), y0 = static_cast<int>(y);
+			int x1 = std::min(x0 + 1, source.size - 1), y1 = std::min(y0 + 1, source.size - 1);
+			float fx = x - x0, fy = y - y0;
+
+			const float* texels = source.faces[face].data();
+			Vector result = { 0.0f, 0.0f, 0.0f };
+			const int xs[2] = { x0, x1 }, ys[2] = { y0, y1 };
+			const float wx[2] = { 1.0f - fx, fx }, wy[2] = { 1.0f - fy, fy };
+			for (int j = 0; j < 2; j++)
+			{
+				for (int i = 0; i < 2; i++)
+				{
+					const float* texel = texels + (static_cast<size_t>(ys[j]) * source.size + xs[i]) * 3;
+					result = result + Vector{ texel[0], texel[1], texel[2] } * (wx[i] * wy[j]);
+				}
+			}
+			return result;
+		}
+
+		// trilinear between the levels around lod
+		Vector sample(const Vector& direction, float lod) const
+		{
+			lod = std::max(0.0f, std::min(lod, static_cast<float>(levels.size() - 1)));
+			int level = static_cast<int>(lod);
+			float fraction = lod - level;
+			Vector result = sampleLevel(direction, level);
+			if (fraction > 0.0f && level + 1 < static_cast<int>(levels.size()))
+				result = result * (1.0f - fraction) + sampleLevel(direction, level + 1) * fraction;
+			return result;
+		}
+	};
+
+	void buildSourceCube(const MipImage* const faces[6], bool srgb, SourceCube& cube)
+	{
+		int size = faces[0]->width;
+		cube.levels.resize(numOfMipLevels(size, size));
+		cube.levels[0].size = size;
+		for (int face = 0; face < 6; face++)
+		{
+			const MipImage& image = *faces[face];
+			std::vector<float>& texels = cube.levels[0].faces[face];
+			texels.resize(static_cast<size_t>(size) * size * 3);
+			for (size_t i = 0; i < static_cast<size_t>(size) * size; i++)
+			{
+				const unsigned char* texel = &image.pixels[i * image.numOfChannels];
+				for (int c = 0; c < 3; c++)
+				{
+					float value = texel[image.numOfChannels >= 3 ? c : 0] / 255.0f;
+					texels[i * 3 + c] = srgb ? srgbToLinear(value) : value;
+				}
+			}
+		}
+
+		// 2x2 averages in linear light
+		for (size_t level = 1; level < cube.levels.size(); level++)
+		{
+			const SourceCube::Level& previous = cube.levels[level - 1];
+			SourceCube::Level& current = cube.levels[level];
+			current.size = std::max(1, previous.size / 2);
+			for (int face = 0; face < 6; face++)
+			{
+				current.faces[face].resize(static_cast<size_t>(current.size) * current.size * 3);
+				for (int y = 0; y < current.size; y++)
+				{
+					for (int x = 0; x < current.size; x++)
+					{
+						for (int c = 0; c < 3; c++)
+						{
+							float sum = 0.0f;
+							for (int j = 0; j < 2; j++)
+							{
+								for (int i = 0; i < 2; i++)
+								{
+									int sourceX = std::min(2 * x + i, previous.size - 1);
+									int sourceY = std::min(2 * y + j, previous.size - 1);
+									sum += previous.faces[face][(static_cast<size_t>(sourceY) * previous.size + sourceX) * 3 + c];
+								}
+							}
+							current.faces[face][(static_cast<size_t>(y) * current.size + x) * 3 + c] = sum * 0.25f;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// a light direction of the lobe around +z with its weight and source level
+	struct LobeSample
+	{
+		Vector direction;
+		float weight;		// N.L
+		float lod;
+	};
+
+	// van der Corput radical inverse for the Hammersley point set
+	float radicalInverse(unsigned int bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xaaaaaaaau) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xccccccccu) >> 2u);
+		bits = ((bits & 0x0f0f0f0fu) << 4u) | ((bits & 0xf0f0f0f0u) >> 4u);
+		bits = ((bits & 0x00ff00ffu) << 8u) | ((bits & 0xff00ff00u) >> 8u);
+		return static_cast<float>(bits) * 2.3283064365386963e-10f;
+	}
+
+	// GGX importance samples (normal = view = +z); the source level of each sample
+	// covers the solid angle its probability leaves to it
+	std::vector<LobeSample> lobeSamples(float roughness, int numOfSamples, int sourceSize)
+	{
+		float alpha = roughness * roughness;
+		float alpha2 = alpha * alpha;
+		float texelSolidAngle = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+
+		std::vector<LobeSample> samples;
+		for (int i = 0; i < numOfSamples; i++)
+		{
+			float u = static_cast<float>(i) / numOfSamples;
+			float v = radicalInverse(static_cast<unsigned int>(i));
+			float phi = 2.0f * PI * u;
+			float cosTheta = std::sqrt((1.0f - v) / (1.0f + (alpha2 - 1.0f) * v));
+			float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+			Vector half = { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+
+			// reflect the view direction (+z) about the half vector
+			Vector light = half * (2.0f * cosTheta) + Vector{ 0.0f, 0.0f, -1.0f };
+			if (light.z <= 0.0f)
+				continue;
+
+			// pdf of the light direction is D(h) (N.H) / (4 V.H) = D(h) / 4
+			float denominator = cosTheta * cosTheta * (alpha2 - 1.0f) + 1.0f;
+			float distribution = alpha2 / (PI * denominator * denominator);
+			float sampleSolidAngle = 4.0f / (numOfSamples * distribution);
+			float lod = std::max(0.0f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f);
+
+			samples.push_back({ light, light.z, lod });
+		}
+		return samples;
+	}
+}
+
+float prefilterRoughness(int level, int numOfLevels)
+{
+	return numOfLevels > 1 ? static_cast<float>(level) / (numOfLevels - 1) : 0.0f;
+}
+
+void prefilterEnvironment(const MipImage* const faces[6], unsigned int flags, int numOfSamples,
+	std::vector<std::vector<MipImage>>& levels)
+{
+	bool srgb = (flags & MIP_SRGB) != 0;
+	int size = faces[0]->width;
+	int numOfLevels = numOfMipLevels(size, size);
+
+	SourceCube source;
+	buildSourceCube(faces, srgb, source);
+
+	levels.assign(6, std::vector<MipImage>(numOfLevels));
+	for (int level = 0; level < numOfLevels; level++)
+	{
+		int levelSize = std::max(1, size >> level);
+		for (int face = 0; face < 6; face++)
+		{
+			MipImage& image = levels[face][level];
+			image.width = levelSize;
+			image.height = levelSize;
+			image.numOfChannels = 3;
+			image.pixels.resize(static_cast<size_t>(levelSize) * levelSize * 3);
+		}
+
+		// level 0 is a mirror, the source itself
+		std::vector<LobeSample> samples;
+		if (level > 0)
+			samples = lobeSamples(prefilterRoughness(level, numOfLevels), numOfSamples, size);
+
+		parallelFor(0, static_cast<size_t>(6) * levelSize, PREFILTER_ROW_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t row = first; row < last; row++)
+			{
+				int face = static_cast<int>(row / levelSize);
+				int y = static_cast<int>(row % levelSize);
+				unsigned char* destination = &levels[face][level].pixels[static_cast<size_t>(y) * levelSize * 3];
+
+				for (int x = 0; x < levelSize; x++)
+				{
+					float s = 2.0f * (x + 0.5f) / levelSize - 1.0f;
+					float t = 2.0f * (y + 0.5f) / levelSize - 1.0f;
+					Vector normal = normalize(faceDirection(face, s, t));
+
+					Vector colour;
+					if (samples.empty())
+					{
+						colour = source.sampleLevel(normal, 0);
+					}
+					else
+					{
+						// tangent frame around the texel direction
+						Vector up = std::abs(normal.z) < 0.999f ? Vector{ 0.0f, 0.0f, 1.0f } : Vector{ 1.0f, 0.0f, 0.0f };
+						Vector tangent = normalize(cross(up, normal));
+						Vector bitangent = cross(normal, tangent);
+
+						colour = { 0.0f, 0.0f, 0.0f };
+						float totalWeight = 0.0f;
+						for (const LobeSample& sample : samples)
+						{
+							Vector light = tangent * sample.direction.x + bitangent * sample.direction.y + normal * sample.direction.z;
+							colour = colour + source.sample(light, sample.lod) * sample.weight;
+							totalWeight += sample.weight;
+						}
+						colour = colour * (totalWeight > 0.0f ? 1.0f / totalWeight : 0.0f);
+					}
+
+					float channels[3] = { colour.x, colour.y, colour.z };
+					for (int c = 0; c < 3; c++)
+						destination[x * 3 + c] = toByte(srgb ? linearToSrgb(channels[c]) : channels[c]);
+				}
+			}
+		});
+	}
+}
@@ -0,0 +1,32 @@
+#ifndef ENVIRONMENT_PREFILTER_H
+#define ENVIRONMENT_PREFILTER_H
+
+#include "MipGenerator.h"
+
+#include <vector>
+
+/*****************************************************************
+ * GGX prefiltered environment cube maps
+ *
+ * mip level i of the result holds the environment convolved with
+ * the GGX lobe of roughness i / (levels - 1), so a reflection of
+ * any roughness is a single textureLod fetch. texels are filtered
+ * by importance sampling the lobe (V = N = R), each sample read
+ * from the coarser source level matching its solid angle to keep
+ * the sample count low. every texel's direction is sampled across
+ * face boundaries, so neighbouring faces agree along their edges
+ * (with GL_TEXTURE_CUBE_MAP_SEAMLESS the result has no seams)
+ *****************************************************************/
+
+const int DEFAULT_PREFILTER_SAMPLES = 64;
+
+// faces in GL order (+x, -x, +y, -y, +z, -z), square, of equal size and with rows in
+// GL order; levels receives one full chain per face (level 0 a copy of the face, RGB)
+// flags: MIP_SRGB to filter in linear light
+void prefilterEnvironment(const MipImage* const faces[6], unsigned int flags, int numOfSamples,
+	std::vector<std::vector<MipImage>>& levels);
+
+// GGX roughness a level of a prefiltered chain was filtered for
+float prefilterRoughness(int level, int numOfLevels);
+
+#endif
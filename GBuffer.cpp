@@ -0,0 +1,104 @@
+#include "GBuffer.h"
+#include "SamplerCache.h"
+
+namespace
+{
+	// render target texture of the G-buffer
+	GLuint createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+}
+
+GBuffer::GBuffer()
+{
+}
+
+GBuffer::~GBuffer()
+{
+	clear();
+}
+
+void GBuffer::bindForWriting(int width, int height)
+{
+	if (width != mWidth || height != mHeight)
+		create(width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glViewport(0, 0, width, height);
+	const GLfloat black[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, black);
+	glClearBufferfv(GL_COLOR, 1, black);
+	glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+}
+
+void GBuffer::bindTextures() const
+{
+	// read with texelFetch, the sampler only keeps the single level textures complete
+	SamplerState state;
+	state.magFilter = GL_NEAREST;
+	state.minFilter = GL_NEAREST;
+	state.wrapS = GL_CLAMP_TO_EDGE;
+	state.wrapT = GL_CLAMP_TO_EDGE;
+	GLuint sampler = SamplerCache::shared().get(state);
+
+	const GLuint units[] = { GBUFFER_ALBEDO_UNIT, GBUFFER_NORMAL_UNIT, GBUFFER_DEPTH_UNIT };
+	const GLuint textures[] = { mAlbedo, mNormal, mDepth };
+	for (int i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + units[i]);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glBindSampler(units[i], sampler);
+	}
+}
+
+void GBuffer::blitDepth(int x, int y) const
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, mWidth, mHeight, x, y, x + mWidth, y + mHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void GBuffer::clear()
+{
+	if (mFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &mFramebuffer);
+		glDeleteTextures(1, &mAlbedo);
+		glDeleteTextures(1, &mNormal);
+		glDeleteTextures(1, &mDepth);
+		mFramebuffer = mAlbedo = mNormal = mDepth = 0;
+	}
+	mWidth = mHeight = 0;
+}
+
+void GBuffer::create(int width, int height)
+{
+	clear();
+	mWidth = width;
+	mHeight = height;
+
+	// depth with stencil to match the default framebuffer for blitting
+	mAlbedo = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+	mNormal = createTarget(GL_RG16, GL_RG, GL_UNSIGNED_SHORT, width, height);
+	mDepth = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+
+	glGenFramebuffers(1, &mFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mAlbedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mNormal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, mDepth, 0);
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "G-buffer framebuffer incomplete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
@@ -0,0 +1,53 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "utilities.h"
+
+// texture units of the G-buffer in the lighting pass (after the clustered light lists)
+const GLuint GBUFFER_ALBEDO_UNIT = 7;
+const GLuint GBUFFER_NORMAL_UNIT = 8;
+const GLuint GBUFFER_DEPTH_UNIT = 9;
+
+/*****************************************************************
+ * geometry buffer of a viewport for deferred shading
+ *
+ * the geometry pass writes each visible fragment's surface once:
+ * albedo with the material ID in alpha (RGBA8), the octahedral
+ * normal (RG16) and depth (24 bits), 12 bytes a pixel. a lighting
+ * pass over the viewport then shades every pixel exactly once
+ * from these, whatever the overdraw of the geometry pass
+ *****************************************************************/
+class GBuffer
+{
+public:
+	GBuffer();
+	~GBuffer();
+
+	GBuffer(const GBuffer&) = delete;
+	GBuffer& operator=(const GBuffer&) = delete;
+
+	// bind and clear for the geometry pass, (re)allocating for the viewport's size
+	void bindForWriting(int width, int height);
+	// bind the albedo, normal and depth textures to their units for the lighting pass
+	void bindTextures() const;
+	// copy the depth into the default framebuffer at a viewport's origin, so anything
+	// forward shaded afterwards is depth tested against the scene
+	void blitDepth(int x, int y) const;
+	// free the framebuffer while the context exists
+	void clear();
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+
+private:
+	GLuint mFramebuffer = 0;
+	GLuint mAlbedo = 0;
+	GLuint mNormal = 0;
+	GLuint mDepth = 0;
+	int mWidth = 0;
+	int mHeight = 0;
+
+	void create(int width, int height);
+};
+
+#endif
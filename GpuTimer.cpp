@@ -0,0 +1,76 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+	clear();
+}
+
+void GpuTimer::begin()
+{
+	if (mQueries[0] == 0)
+		glGenQueries(NUM_OF_QUERIES, mQueries);
+
+	// skip the frame rather than wait when every query is still in flight
+	readBack();
+	mActive = !mPending[mNext];
+	if (mActive)
+		glBeginQuery(GL_TIME_ELAPSED, mQueries[mNext]);
+}
+
+void GpuTimer::end()
+{
+	if (!mActive)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	mPending[mNext] = true;
+	mNext = (mNext + 1) % NUM_OF_QUERIES;
+	mActive = false;
+}
+
+void GpuTimer::clear()
+{
+	if (mQueries[0] != 0)
+	{
+		glDeleteQueries(NUM_OF_QUERIES, mQueries);
+		for (int i = 0; i < NUM_OF_QUERIES; i++)
+		{
+			mQueries[i] = 0;
+			mPending[i] = false;
+		}
+	}
+}
+
+void GpuTimer::readBack()
+{
+	for (int i = 0; i < NUM_OF_QUERIES; i++)
+	{
+		if (!mPending[i])
+			continue;
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(mQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+			continue;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(mQueries[i], GL_QUERY_RESULT, &nanoseconds);
+		mTotal += static_cast<double>(nanoseconds);
+		mNumOfFrames++;
+		mPending[i] = false;
+	}
+
+	// average once a second, like the frame statistics
+	auto now = std::chrono::steady_clock::now();
+	if (mNumOfFrames > 0 && now - mLastAverage >= std::chrono::seconds(1))
+	{
+		mMilliseconds = mTotal / mNumOfFrames / 1.0e6;
+		mTotal = 0.0;
+		mNumOfFrames = 0;
+		mLastAverage = now;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "utilities.h"
+
+#include <chrono>
+
+/*****************************************************************
+ * GPU time of a span of commands from timer queries
+ *
+ * a few queries are kept in flight and read back only once their
+ * results are available, so timing never stalls the pipeline; the
+ * time reported is that of a frame a few frames old, averaged
+ * over the last second's frames
+ *****************************************************************/
+class GpuTimer
+{
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// start and stop timing this frame's commands (not nested with other timers)
+	void begin();
+	void end();
+	// average milliseconds of the frames measured in the last second (0 until measured)
+	double getMilliseconds() const { return mMilliseconds; }
+	// free the queries while the context exists
+	void clear();
+
+private:
+	static const int NUM_OF_QUERIES = 4;
+
+	GLuint mQueries[NUM_OF_QUERIES] = {};
+	bool mPending[NUM_OF_QUERIES] = {};
+	int mNext = 0;
+	bool mActive = false;		// this frame is being timed (a query was free)
+	double mTotal = 0.0;		// nanoseconds of the frames read back since the last average
+	int mNumOfFrames = 0;
+	std::chrono::steady_clock::time_point mLastAverage = std::chrono::steady_clock::now();
+	double mMilliseconds = 0.0;
+
+	void readBack();
+};
+
+#endif
@@ -0,0 +1,404 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+namespace
+{
+	const int NUM_OF_CLUSTERS = CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES;
+	const int CLUSTERS_PER_SLICE = CLUSTER_TILES_X * CLUSTER_TILES_Y;
+
+	// one value of four lights, or a mask of four test results
+	struct Lanes
+	{
+#ifdef LIGHT_CLUSTERS_SSE
+		__m128 value;
+#else
+		float value[4];		// masks hold 1 or 0
+#endif
+	};
+
+	inline Lanes loadLanes(const float* source)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_loadu_ps(source);
+#else
+		std::copy_n(source, 4, lanes.value);
+#endif
+		return lanes;
+	}
+
+	inline Lanes splat(float value)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_set1_ps(value);
+#else
+		std::fill_n(lanes.value, 4, value);
+#endif
+		return lanes;
+	}
+
+	inline Lanes operator+(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_add_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = a.value[i] + b.value[i];
+#endif
+		return lanes;
+	}
+
+	inline Lanes operator-(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_sub_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = a.value[i] - b.value[i];
+#endif
+		return lanes;
+	}
+
+	inline Lanes operator*(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_mul_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = a.value[i] * b.value[i];
+#endif
+		return lanes;
+	}
+
+	inline Lanes maxLanes(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_max_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = std::max(a.value[i], b.value[i]);
+#endif
+		return lanes;
+	}
+
+	inline Lanes sqrtLanes(const Lanes& a)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_sqrt_ps(a.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = std::sqrt(a.value[i]);
+#endif
+		return lanes;
+	}
+
+	// mask of a <= b
+	inline Lanes lessEqual(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_cmple_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = a.value[i] <= b.value[i] ? 1.0f : 0.0f;
+#endif
+		return lanes;
+	}
+
+	inline Lanes andMask(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_and_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = a.value[i] != 0.0f && b.value[i] != 0.0f ? 1.0f : 0.0f;
+#endif
+		return lanes;
+	}
+
+	inline Lanes orMask(const Lanes& a, const Lanes& b)
+	{
+		Lanes lanes;
+#ifdef LIGHT_CLUSTERS_SSE
+		lanes.value = _mm_or_ps(a.value, b.value);
+#else
+		for (int i = 0; i < 4; i++)
+			lanes.value[i] = a.value[i] != 0.0f || b.value[i] != 0.0f ? 1.0f : 0.0f;
+#endif
+		return lanes;
+	}
+
+	// bit i set if lane i of a mask is set
+	inline int maskBits(const Lanes& mask)
+	{
+#ifdef LIGHT_CLUSTERS_SSE
+		return _mm_movemask_ps(mask.value);
+#else
+		int bits = 0;
+		for (int i = 0; i < 4; i++)
+			bits |= mask.value[i] != 0.0f ? 1 << i : 0;
+		return bits;
+#endif
+	}
+
+	// view space lights of one slice, four to a group (the last group padded)
+	struct SliceLights
+	{
+		std::vector<uint32_t> indices;
+		std::vector<float> x, y, z, radius;
+		std::vector<float> dirX, dirY, dirZ, cosAngle, sinAngle;
+		std::vector<float> isSpot;		// 1 for cone tests, 0 for spheres only
+
+		void add(uint32_t index, const glm::vec3& position, const glm::vec3& direction, float range,
+			bool spot, float cosOuter)
+		{
+			indices.push_back(index);
+			x.push_back(position.x);
+			y.push_back(position.y);
+			z.push_back(position.z);
+			radius.push_back(range);
+			dirX.push_back(direction.x);
+			dirY.push_back(direction.y);
+			dirZ.push_back(direction.z);
+			cosAngle.push_back(cosOuter);
+			sinAngle.push_back(std::sqrt(std::max(0.0f, 1.0f - cosOuter * cosOuter)));
+			isSpot.push_back(spot ? 1.0f : 0.0f);
+		}
+
+		void pad()
+		{
+			while (x.size() % 4 != 0)
+			{
+				x.push_back(0.0f);
+				y.push_back(0.0f);
+				z.push_back(0.0f);
+				radius.push_back(0.0f);
+				dirX.push_back(0.0f);
+				dirY.push_back(0.0f);
+				dirZ.push_back(0.0f);
+				cosAngle.push_back(1.0f);
+				sinAngle.push_back(0.0f);
+				isSpot.push_back(0.0f);
+			}
+		}
+	};
+
+	// point on the line between a near and a far plane point at a view depth
+	glm::vec3 pointAtDepth(const glm::vec3& nearPoint, const glm::vec3& farPoint, float depth)
+	{
+		float t = (-depth - nearPoint.z) / (farPoint.z - nearPoint.z);
+		return nearPoint + (farPoint - nearPoint) * t;
+	}
+}
+
+float lightRange(const glm::vec3& attenuation, float intensity)
+{
+	// solve constant + linear d + quadratic d^2 = intensity / cutoff
+	float target = intensity / LIGHT_CUTOFF;
+	if (attenuation.x >= target)
+		return 0.0f;
+	if (attenuation.z > 0.0f)
+	{
+		float discriminant = attenuation.y * attenuation.y + 4.0f * attenuation.z * (target - attenuation.x);
+		return (-attenuation.y + std::sqrt(discriminant)) / (2.0f * attenuation.z);
+	}
+	if (attenuation.y > 0.0f)
+		return (target - attenuation.x) / attenuation.y;
+	return LIGHT_RANGE_INFINITE;
+}
+
+glm::vec2 LightClusterGrid::getSliceScaleBias() const
+{
+	float logRatio = std::log(mFarDepth / mNearDepth);
+	return glm::vec2(CLUSTER_SLICES / logRatio, -CLUSTER_SLICES * std::log(mNearDepth) / logRatio);
+}
+
+void LightClusterGrid::buildBounds(const glm::mat4& projMatrix)
+{
+	mProjMatrix = projMatrix;
+	glm::mat4 inverseProj = glm::inverse(projMatrix);
+	auto unproject = [&inverseProj](float x, float y, float z)
+	{
+		glm::vec4 point = inverseProj * glm::vec4(x, y, z, 1.0f);
+		return glm::vec3(point) / point.w;
+	};
+
+	mNearDepth = std::max(-unproject(0.0f, 0.0f, -1.0f).z, 1.0e-4f);
+	mFarDepth = std::max(-unproject(0.0f, 0.0f, 1.0f).z, mNearDepth * 1.001f);
+
+	// rays through the tile corners
+	std::vector<glm::vec3> nearPoints, farPoints;
+	for (int y = 0; y <= CLUSTER_TILES_Y; y++)
+	{
+		for (int x = 0; x <= CLUSTER_TILES_X; x++)
+		{
+			float ndcX = -1.0f + 2.0f * x / CLUSTER_TILES_X;
+			float ndcY = -1.0f + 2.0f * y / CLUSTER_TILES_Y;
+			nearPoints.push_back(unproject(ndcX, ndcY, -1.0f));
+			farPoints.push_back(unproject(ndcX, ndcY, 1.0f));
+		}
+	}
+
+	mClusterBounds.resize(NUM_OF_CLUSTERS);
+	for (int slice = 0; slice < CLUSTER_SLICES; slice++)
+	{
+		float depths[2] = {
+			mNearDepth * std::pow(mFarDepth / mNearDepth, static_cast<float>(slice) / CLUSTER_SLICES),
+			mNearDepth * std::pow(mFarDepth / mNearDepth, static_cast<float>(slice + 1) / CLUSTER_SLICES) };
+
+		for (int y = 0; y < CLUSTER_TILES_Y; y++)
+		{
+			for (int x = 0; x < CLUSTER_TILES_X; x++)
+			{
+				Bounds& bounds = mClusterBounds[(slice * CLUSTER_TILES_Y + y) * CLUSTER_TILES_X + x];
+				bounds.min = glm::vec3(FLT_MAX);
+				bounds.max = glm::vec3(-FLT_MAX);
+				for (int corner = 0; corner < 4; corner++)
+				{
+					int ray = (y + corner / 2) * (CLUSTER_TILES_X + 1) + x + corner % 2;
+					for (float depth : depths)
+					{
+						glm::vec3 point = pointAtDepth(nearPoints[ray], farPoints[ray], depth);
+						bounds.min = glm::min(bounds.min, point);
+						bounds.max = glm::max(bounds.max, point);
+					}
+				}
+			}
+		}
+	}
+}
+
+void LightClusterGrid::assign(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix,
+	const glm::mat4& projMatrix)
+{
+	if (mClusterBounds.empty() || projMatrix != mProjMatrix)
+		buildBounds(projMatrix);
+
+	// lights in view space
+	std::vector<glm::vec3> positions(lights.size()), directions(lights.size());
+	glm::mat3 viewRotation(viewMatrix);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		positions[i] = glm::vec3(viewMatrix * glm::vec4(lights[i].position, 1.0f));
+		directions[i] = glm::normalize(viewRotation * lights[i].direction);
+	}
+
+	mClusterRanges.assign(NUM_OF_CLUSTERS * 2, 0);
+	std::vector<std::vector<uint32_t>> sliceIndices(CLUSTER_SLICES);
+
+	parallelFor(0, CLUSTER_SLICES, 1, [&](size_t first, size_t last)
+	{
+		for (size_t slice = first; slice < last; slice++)
+		{
+			// lights whose bounding sphere reaches the slice's depths
+			const Bounds& sliceStart = mClusterBounds[slice * CLUSTERS_PER_SLICE];
+			float nearDepth = -sliceStart.max.z, farDepth = -sliceStart.min.z;
+			for (int cluster = 1; cluster < CLUSTERS_PER_SLICE; cluster++)
+			{
+				const Bounds& bounds = mClusterBounds[slice * CLUSTERS_PER_SLICE + cluster];
+				nearDepth = std::min(nearDepth, -bounds.max.z);
+				farDepth = std::max(farDepth, -bounds.min.z);
+			}
+
+			SliceLights candidates;
+			for (size_t i = 0; i < lights.size(); i++)
+			{
+				const ClusterLight& light = lights[i];
+				float range = light.type == CLUSTER_LIGHT_DIRECTIONAL ? LIGHT_RANGE_INFINITE : light.range;
+				float depth = -positions[i].z;
+				if (depth + range < nearDepth || depth - range > farDepth)
+					continue;
+				candidates.add(static_cast<uint32_t>(i), positions[i], directions[i], range,
+					light.type == CLUSTER_LIGHT_SPOT, light.cosOuterAngle);
+			}
+			size_t numOfCandidates = candidates.indices.size();
+			candidates.pad();
+
+			std::vector<uint32_t>& indices = sliceIndices[slice];
+			for (int cluster = 0; cluster < CLUSTERS_PER_SLICE; cluster++)
+			{
+				size_t clusterIndex = slice * CLUSTERS_PER_SLICE + cluster;
+				const Bounds& bounds = mClusterBounds[clusterIndex];
+				Lanes minX = splat(bounds.min.x), minY = splat(bounds.min.y), minZ = splat(bounds.min.z);
+				Lanes maxX = splat(bounds.max.x), maxY = splat(bounds.max.y), maxZ = splat(bounds.max.z);
+
+				// bounding sphere of the cluster for the cone tests
+				glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+				float clusterRadius = glm::length(bounds.max - center);
+				Lanes centerX = splat(center.x), centerY = splat(center.y), centerZ = splat(center.z);
+				Lanes sphereRadius = splat(clusterRadius), negativeRadius = splat(-clusterRadius);
+				Lanes zero = splat(0.0f);
+
+				uint32_t count = 0;
+				for (size_t group = 0; group < numOfCandidates; group += 4)
+				{
+					Lanes x = loadLanes(&candidates.x[group]);
+					Lanes y = loadLanes(&candidates.y[group]);
+					Lanes z = loadLanes(&candidates.z[group]);
+					Lanes radius = loadLanes(&candidates.radius[group]);
+
+					// distance from the light to the box against its range
+					Lanes dx = maxLanes(maxLanes(minX - x, x - maxX), zero);
+					Lanes dy = maxLanes(maxLanes(minY - y, y - maxY), zero);
+					Lanes dz = maxLanes(maxLanes(minZ - z, z - maxZ), zero);
+					Lanes inside = lessEqual(dx * dx + dy * dy + dz * dz, radius * radius);
+
+					// cone against the cluster's sphere: its distance from the cone's side,
+					// its projection on the axis against the cone's length and apex
+					Lanes vx = centerX - x, vy = centerY - y, vz = centerZ - z;
+					Lanes axial = vx * loadLanes(&candidates.dirX[group]) + vy * loadLanes(&candidates.dirY[group])
+						+ vz * loadLanes(&candidates.dirZ[group]);
+					Lanes lateral = sqrtLanes(maxLanes(vx * vx + vy * vy + vz * vz - axial * axial, zero));
+					Lanes sideDistance = loadLanes(&candidates.cosAngle[group]) * lateral
+						- axial * loadLanes(&candidates.sinAngle[group]);
+					Lanes inCone = andMask(andMask(lessEqual(sideDistance, sphereRadius), lessEqual(axial, sphereRadius + radius)),
+						lessEqual(negativeRadius, axial));
+					Lanes notSpot = lessEqual(loadLanes(&candidates.isSpot[group]), zero);
+
+					int bits = maskBits(andMask(inside, orMask(notSpot, inCone)));
+					if (numOfCandidates - group < 4)
+						bits &= (1 << (numOfCandidates - group)) - 1;
+					for (int lane = 0; bits != 0; lane++, bits >>= 1)
+					{
+						if (bits & 1)
+						{
+							indices.push_back(candidates.indices[group + lane]);
+							count++;
+						}
+					}
+				}
+				mClusterRanges[clusterIndex * 2 + 1] = count;
+			}
+		}
+	});
+
+	// slices' lists one after another
+	mLightIndices.clear();
+	uint32_t offset = 0;
+	for (int slice = 0; slice < CLUSTER_SLICES; slice++)
+	{
+		for (int cluster = 0; cluster < CLUSTERS_PER_SLICE; cluster++)
+		{
+			size_t clusterIndex = slice * CLUSTERS_PER_SLICE + cluster;
+			mClusterRanges[clusterIndex * 2] = offset;
+			offset += mClusterRanges[clusterIndex * 2 + 1];
+		}
+		mLightIndices.insert(mLightIndices.end(), sliceIndices[slice].begin(), sliceIndices[slice].end());
+	}
+}
@@ -0,0 +1,86 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/*****************************************************************
+ * lights binned into a 3D grid of clusters over a view frustum
+ *
+ * the viewport is split into tiles and the view depth into slices
+ * spaced exponentially between the near and far planes; each
+ * cluster lists the lights whose range overlaps it (spheres for
+ * point lights, cones for spotlights, every cluster for lights
+ * without falloff), so a fragment only shades with the lights of
+ * its own cluster. slices are assigned in parallel, each testing
+ * four lights at a time against its clusters with SSE
+ *****************************************************************/
+
+const int CLUSTER_TILES_X = 16;
+const int CLUSTER_TILES_Y = 16;
+const int CLUSTER_SLICES = 16;
+
+// intensity below which a light no longer changes an 8-bit colour
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+// range of lights that reach every cluster (directional, or no distance falloff)
+const float LIGHT_RANGE_INFINITE = 1.0e18f;
+
+enum ClusterLightType
+{
+	CLUSTER_LIGHT_POINT = 1,
+	CLUSTER_LIGHT_DIRECTIONAL = 2,
+	CLUSTER_LIGHT_SPOT = 3
+};
+
+// light as the clusters see it, in world space
+struct ClusterLight
+{
+	int type = CLUSTER_LIGHT_POINT;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);		// unit, spotlights
+	float range = 0.0f;					// distance the light reaches (see lightRange)
+	float cosOuterAngle = -1.0f;		// spotlights: cosine of the cone's half angle
+};
+
+// distance at which attenuation (constant, linear, quadratic) brings a light of the given
+// peak intensity below LIGHT_CUTOFF, LIGHT_RANGE_INFINITE for lights that do not fall off
+float lightRange(const glm::vec3& attenuation, float intensity);
+
+class LightClusterGrid
+{
+public:
+	// bin lights for a view; the projection may be perspective or orthographic
+	void assign(const std::vector<ClusterLight>& lights, const glm::mat4& viewMatrix, const glm::mat4& projMatrix);
+
+	// per cluster (x fastest, then y, then slice): offset into the indices and number of lights
+	const std::vector<uint32_t>& getClusterRanges() const { return mClusterRanges; }
+	// light indices of all clusters
+	const std::vector<uint32_t>& getLightIndices() const { return mLightIndices; }
+
+	// view depth of the near and far planes the slices span
+	float getNearDepth() const { return mNearDepth; }
+	float getFarDepth() const { return mFarDepth; }
+	// slice of a view depth is floor(log(depth) * scale + bias)
+	glm::vec2 getSliceScaleBias() const;
+
+private:
+	struct Bounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	glm::mat4 mProjMatrix = glm::mat4(0.0f);		// projection the bounds were built for
+	std::vector<Bounds> mClusterBounds;			// view space
+	float mNearDepth = 0.0f;
+	float mFarDepth = 0.0f;
+
+	std::vector<uint32_t> mClusterRanges;
+	std::vector<uint32_t> mLightIndices;
+
+	void buildBounds(const glm::mat4& projMatrix);
+};
+
+#endif
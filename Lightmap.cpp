@@ -0,0 +1,113 @@
+#include "Lightmap.h"
+#include "AtlasPacker.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// chart sizes at a texel density (texels per world unit), at least 2x2 texels
+	void chartSizes(const std::vector<LightmapSurface>& surfaces, float density, std::vector<LightmapChart>& charts)
+	{
+		charts.resize(surfaces.size());
+		for (size_t i = 0; i < surfaces.size(); i++)
+		{
+			const LightmapSurface& surface = surfaces[i];
+			charts[i].width = std::max(2, static_cast<int>(std::ceil(glm::length(surface.corners[1] - surface.corners[0]) * density)));
+			charts[i].height = std::max(2, static_cast<int>(std::ceil(glm::length(surface.corners[2] - surface.corners[0]) * density)));
+		}
+	}
+
+	// place the padded charts, tallest first
+	bool placeCharts(std::vector<LightmapChart>& charts, int size)
+	{
+		std::vector<size_t> order(charts.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&charts](size_t a, size_t b) {
+			return charts[a].height > charts[b].height;
+		});
+
+		SkylinePacker packer(size, size);
+		for (size_t index : order)
+		{
+			LightmapChart& chart = charts[index];
+			int x, y;
+			if (!packer.insert(chart.width + 2 * LIGHTMAP_PADDING, chart.height + 2 * LIGHTMAP_PADDING, x, y))
+				return false;
+			chart.x = x + LIGHTMAP_PADDING;
+			chart.y = y + LIGHTMAP_PADDING;
+		}
+		return true;
+	}
+}
+
+bool packLightmap(const std::vector<LightmapSurface>& surfaces, int size, std::vector<LightmapChart>& charts)
+{
+	// largest density that fits, by bisection
+	float low = 0.0f;
+	float high = static_cast<float>(size);
+	for (const LightmapSurface& surface : surfaces)
+	{
+		float extent = std::max(glm::length(surface.corners[1] - surface.corners[0]),
+			glm::length(surface.corners[2] - surface.corners[0]));
+		if (extent > 0.0f)
+			high = std::min(high, size / extent);
+	}
+
+	std::vector<LightmapChart> trial;
+	bool packed = false;
+	for (int iteration = 0; iteration < 24; iteration++)
+	{
+		float density = 0.5f * (low + high);
+		chartSizes(surfaces, density, trial);
+		if (placeCharts(trial, size))
+		{
+			low = density;
+			charts = trial;
+			packed = true;
+		}
+		else
+			high = density;
+	}
+	if (!packed)
+	{
+		chartSizes(surfaces, 0.0f, trial);
+		if (!placeCharts(trial, size))
+			return false;
+		charts = trial;
+	}
+
+	// corners on the texel centres at the chart's edges
+	for (LightmapChart& chart : charts)
+	{
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float s = static_cast<float>(corner % 2);
+			float t = static_cast<float>(corner / 2);
+			chart.texCoords[corner] = glm::vec2((chart.x + 0.5f + s * (chart.width - 1)) / size,
+				(chart.y + 0.5f + t * (chart.height - 1)) / size);
+		}
+	}
+	return true;
+}
+
+glm::vec3 chartPosition(const LightmapSurface& surface, const LightmapChart& chart, float x, float y)
+{
+	float s = glm::clamp((x - chart.x) / (chart.width - 1), 0.0f, 1.0f);
+	float t = glm::clamp((y - chart.y) / (chart.height - 1), 0.0f, 1.0f);
+	return surface.corners[0] + s * (surface.corners[1] - surface.corners[0])
+		+ t * (surface.corners[2] - surface.corners[0]);
+}
+
+unsigned char encodeLightmap(float light)
+{
+	float value = std::sqrt(std::max(0.0f, std::min(1.0f, light / LIGHTMAP_RANGE)));
+	return static_cast<unsigned char>(value * 255.0f + 0.5f);
+}
+
+float decodeLightmap(unsigned char value)
+{
+	float encoded = value / 255.0f;
+	return encoded * encoded * LIGHTMAP_RANGE;
+}
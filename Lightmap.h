@@ -0,0 +1,52 @@
+#ifndef LIGHTMAP_H
+#define LIGHTMAP_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/*****************************************************************
+ * lightmap layout of static planar surfaces
+ *
+ * every surface is a parallelogram (a strip of four corners) that
+ * becomes one chart of the lightmap: its size in texels follows
+ * its size in the world at one texel density for all charts, the
+ * largest that packs every chart into the map, and the corners get
+ * a second set of texture coordinates on the chart's texel centres.
+ * the baker (lightbake) and the renderer lay the map out with the
+ * same surfaces, so both agree on the coordinates
+ *****************************************************************/
+
+const int LIGHTMAP_SIZE = 256;			// texels across the lightmap
+const int LIGHTMAP_PADDING = 2;			// texels between charts, filled by dilation
+// baked light is stored as sqrt(light / LIGHTMAP_RANGE) in 8 bits
+const float LIGHTMAP_RANGE = 4.0f;
+
+// static surface for baking
+struct LightmapSurface
+{
+	glm::vec3 corners[4];				// triangle strip order: (0,0), (1,0), (0,1), (1,1)
+	glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);	// lit side
+	glm::vec3 albedo = glm::vec3(0.5f);	// diffuse reflectance for light bouncing off it
+};
+
+// texels of a surface in the lightmap
+struct LightmapChart
+{
+	int x = 0, y = 0;					// bottom-left texel
+	int width = 0, height = 0;
+	glm::vec2 texCoords[4];				// lightmap coordinates of the surface's corners
+};
+
+// lay out a chart for each surface in a size x size lightmap; false if they do not fit
+bool packLightmap(const std::vector<LightmapSurface>& surfaces, int size, std::vector<LightmapChart>& charts);
+
+// world position of a point of a chart in lightmap texels (texel centres at whole
+// numbers), clamped to its surface
+glm::vec3 chartPosition(const LightmapSurface& surface, const LightmapChart& chart, float x, float y);
+
+// 8-bit texel of baked light and back
+unsigned char encodeLightmap(float light);
+float decodeLightmap(unsigned char value);
+
+#endif
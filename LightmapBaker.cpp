@@ -0,0 +1,271 @@
+#include "LightmapBaker.h"
+#include "ThreadPool.h"
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace
+{
+	const float PI = 3.14159265f;
+	const float RAY_OFFSET = 1e-3f;			// rays leave a surface this far along its normal
+	const float RAY_LENGTH = 100.0f;
+	const int FILTER_ITERATIONS = 4;		// a-trous steps 1, 2, 4 and 8 texels
+	const float FILTER_SIGMA = 4.0f;		// luminance edge stop in standard deviations of the noise
+
+	float luminance(const glm::vec3& colour)
+	{
+		return glm::dot(colour, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+	}
+
+	// surfaces and their BVH, read by all threads
+	struct BakeScene
+	{
+		const std::vector<LightmapSurface>* surfaces;
+		const std::vector<BakeLight>* lights;
+		TriangleBvh bvh;
+	};
+
+	// light reaching a point of a surface straight from the lights
+	glm::vec3 directLight(const BakeScene& scene, const glm::vec3& position, const glm::vec3& normal)
+	{
+		glm::vec3 light(0.0f);
+		glm::vec3 origin = position + normal * RAY_OFFSET;
+		for (const BakeLight& lamp : *scene.lights)
+		{
+			glm::vec3 toLight = lamp.position - origin;
+			float distance = glm::length(toLight);
+			glm::vec3 l = toLight / distance;
+			float cosine = glm::dot(l, normal);
+			if (cosine <= 0.0f || scene.bvh.occluded(origin, l, distance))
+				continue;
+
+			float attenuation = 1.0f / (lamp.attenuation.x + distance * lamp.attenuation.y
+				+ distance * distance * lamp.attenuation.z);
+			light += lamp.diffuse * cosine * attenuation;
+		}
+		return light;
+	}
+
+	// direction around a normal with probability proportional to the cosine
+	glm::vec3 cosineDirection(const glm::vec3& normal, float u1, float u2)
+	{
+		glm::vec3 helper = std::abs(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 tangent = glm::normalize(glm::cross(helper, normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+
+		float radius = std::sqrt(u1);
+		float angle = 2.0f * PI * u2;
+		return tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle))
+			+ normal * std::sqrt(std::max(0.0f, 1.0f - u1));
+	}
+
+	// light reaching a point of a surface off the other surfaces, along one path; with
+	// cosine-weighted directions each bounce scales the light by the albedo it hits
+	glm::vec3 indirectLight(const BakeScene& scene, glm::vec3 position, glm::vec3 normal, int numOfBounces,
+		std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		glm::vec3 light(0.0f);
+		glm::vec3 throughput(1.0f);
+		for (int bounce = 0; bounce < numOfBounces; bounce++)
+		{
+			glm::vec3 direction = cosineDirection(normal, uniform(random), uniform(random));
+			glm::vec3 origin = position + normal * RAY_OFFSET;
+			BvhHit hit;
+			if (!scene.bvh.intersect(origin, direction, RAY_LENGTH, hit))
+				break;	// out through the ceiling
+			const LightmapSurface& surface = (*scene.surfaces)[hit.id];
+			if (glm::dot(direction, surface.normal) >= 0.0f)
+				break;	// back of a surface
+
+			position = origin + direction * hit.distance;
+			normal = surface.normal;
+			throughput *= surface.albedo;
+			light += throughput * directLight(scene, position, normal);
+
+			// russian roulette ends dim paths without biasing the rest
+			if (bounce > 0)
+			{
+				float survival = std::min(0.95f, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+				if (uniform(random) >= survival)
+					break;
+				throughput /= survival;
+			}
+		}
+		return light;
+	}
+
+	// edge-stopping a-trous filter of the indirect light within each chart
+	void denoise(std::vector<glm::vec3>& light, const std::vector<float>& variance, const std::vector<int>& chartIds,
+		int size)
+	{
+		const float kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+		std::vector<glm::vec3> filtered(light.size());
+		for (int iteration = 0; iteration < FILTER_ITERATIONS; iteration++)
+		{
+			int step = 1 << iteration;
+			parallelFor(0, size, 8, [&](size_t firstRow, size_t lastRow) {
+				for (int y = static_cast<int>(firstRow); y < static_cast<int>(lastRow); y++)
+				{
+					for (int x = 0; x < size; x++)
+					{
+						int index = y * size + x;
+						filtered[index] = light[index];
+						if (chartIds[index] < 0)
+							continue;
+
+						float centre = luminance(light[index]);
+						float edgeStop = FILTER_SIGMA * std::sqrt(variance[index]) + 1e-4f;
+						glm::vec3 sum(0.0f);
+						float weightSum = 0.0f;
+						for (int j = -2; j <= 2; j++)
+						{
+							int sy = y + j * step;
+							if (sy < 0 || sy >= size)
+								continue;
+							for (int i = -2; i <= 2; i++)
+							{
+								int sx = x + i * step;
+								if (sx < 0 || sx >= size || chartIds[sy * size + sx] != chartIds[index])
+									continue;
+								const glm::vec3& sample = light[sy * size + sx];
+								float weight = kernel[i + 2] * kernel[j + 2]
+									* std::exp(-std::abs(luminance(sample) - centre) / edgeStop);
+								sum += sample * weight;
+								weightSum += weight;
+							}
+						}
+						filtered[index] = sum / weightSum;
+					}
+				}
+			});
+			light.swap(filtered);
+		}
+	}
+
+	// spread the charts' edges over the padding around them
+	void dilate(std::vector<glm::vec3>& texels, std::vector<int> chartIds, int size)
+	{
+		for (int pass = 0; pass < LIGHTMAP_PADDING; pass++)
+		{
+			std::vector<int> filled = chartIds;
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					int index = y * size + x;
+					if (chartIds[index] >= 0)
+						continue;
+
+					glm::vec3 sum(0.0f);
+					int count = 0;
+					for (int sy = std::max(0, y - 1); sy <= std::min(size - 1, y + 1); sy++)
+					{
+						for (int sx = std::max(0, x - 1); sx <= std::min(size - 1, x + 1); sx++)
+						{
+							if (chartIds[sy * size + sx] >= 0)
+							{
+								sum += texels[sy * size + sx];
+								count++;
+							}
+						}
+					}
+					if (count > 0)
+					{
+						texels[index] = sum / static_cast<float>(count);
+						filled[index] = 0;
+					}
+				}
+			}
+			chartIds.swap(filled);
+		}
+	}
+}
+
+void bakeLightmap(const std::vector<LightmapSurface>& surfaces, const std::vector<LightmapChart>& charts,
+	const std::vector<BakeLight>& lights, const BakeSettings& settings, int size, std::vector<glm::vec3>& texels)
+{
+	BakeScene scene;
+	scene.surfaces = &surfaces;
+	scene.lights = &lights;
+	std::vector<BvhTriangle> triangles;
+	for (size_t i = 0; i < surfaces.size(); i++)
+	{
+		// the strip's two triangles
+		const glm::vec3* corners = surfaces[i].corners;
+		BvhTriangle triangle;
+		triangle.id = static_cast<int>(i);
+		triangle.vertices[0] = corners[0];
+		triangle.vertices[1] = corners[1];
+		triangle.vertices[2] = corners[2];
+		triangles.push_back(triangle);
+		triangle.vertices[0] = corners[2];
+		triangle.vertices[1] = corners[1];
+		triangle.vertices[2] = corners[3];
+		triangles.push_back(triangle);
+	}
+	scene.bvh.build(triangles);
+
+	size_t numOfTexels = static_cast<size_t>(size) * size;
+	std::vector<glm::vec3> direct(numOfTexels, glm::vec3(0.0f));
+	std::vector<glm::vec3> indirect(numOfTexels, glm::vec3(0.0f));
+	std::vector<float> variance(numOfTexels, 0.0f);		// of the mean indirect luminance
+	std::vector<int> chartIds(numOfTexels, -1);
+	for (size_t i = 0; i < charts.size(); i++)
+	{
+		const LightmapChart& chart = charts[i];
+		for (int y = chart.y; y < chart.y + chart.height; y++)
+			std::fill(chartIds.begin() + y * size + chart.x, chartIds.begin() + y * size + chart.x + chart.width, static_cast<int>(i));
+	}
+
+	// rows on all cores, each with its own random sequence so the result does not depend on the threads
+	int numOfSamples = std::max(1, settings.numOfSamples);
+	parallelFor(0, size, 1, [&](size_t firstRow, size_t lastRow) {
+		for (int y = static_cast<int>(firstRow); y < static_cast<int>(lastRow); y++)
+		{
+			std::mt19937 random(static_cast<unsigned int>(y) * 2654435761u + 1u);
+			std::uniform_real_distribution<float> uniform(-0.5f, 0.5f);
+			for (int x = 0; x < size; x++)
+			{
+				int index = y * size + x;
+				if (chartIds[index] < 0)
+					continue;
+				const LightmapSurface& surface = surfaces[chartIds[index]];
+				const LightmapChart& chart = charts[chartIds[index]];
+
+				glm::vec3 directSum(0.0f);
+				glm::vec3 indirectSum(0.0f);
+				float luminanceSum = 0.0f;
+				float luminanceSquares = 0.0f;
+				for (int sample = 0; sample < numOfSamples; sample++)
+				{
+					glm::vec3 position = chartPosition(surface, chart, x + uniform(random), y + uniform(random));
+					directSum += directLight(scene, position, surface.normal);
+					glm::vec3 bounced = indirectLight(scene, position, surface.normal, settings.numOfBounces, random);
+					indirectSum += bounced;
+					luminanceSum += luminance(bounced);
+					luminanceSquares += luminance(bounced) * luminance(bounced);
+				}
+
+				float mean = luminanceSum / numOfSamples;
+				direct[index] = directSum / static_cast<float>(numOfSamples);
+				indirect[index] = indirectSum / static_cast<float>(numOfSamples);
+				variance[index] = std::max(0.0f, luminanceSquares / numOfSamples - mean * mean) / numOfSamples;
+			}
+		}
+	});
+
+	// direct light is smooth at this many samples, only the bounces are noisy
+	if (settings.denoise)
+		denoise(indirect, variance, chartIds, size);
+
+	texels.assign(numOfTexels, glm::vec3(0.0f));
+	for (size_t i = 0; i < numOfTexels; i++)
+	{
+		if (chartIds[i] >= 0)
+			texels[i] = direct[i] + indirect[i];
+	}
+	dilate(texels, chartIds, size);
+}
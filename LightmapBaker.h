@@ -0,0 +1,47 @@
+#ifndef LIGHTMAP_BAKER_H
+#define LIGHTMAP_BAKER_H
+
+#include "Lightmap.h"
+
+#include <vector>
+
+// point light shining on the surfaces, as the shader lights them
+struct BakeLight
+{
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 diffuse = glm::vec3(1.0f);		// Ld
+	glm::vec3 attenuation = glm::vec3(1.0f, 0.0f, 0.0f);	// constant, linear, quadratic
+};
+
+struct BakeSettings
+{
+	int numOfSamples = 256;				// paths per texel
+	int numOfBounces = 3;				// indirect bounces of each path
+	bool denoise = true;				// filter the noise of the indirect light
+};
+
+/*****************************************************************
+ * CPU path tracer baking the light reaching static surfaces
+ *
+ * each texel of the charts traces paths from points jittered
+ * over its footprint: the lights reach every vertex of a path
+ * unless a shadow ray is blocked, and paths leave the texel and
+ * bounce between the surfaces in cosine-weighted directions,
+ * carrying the albedo of every surface they hit (rays through the
+ * open ceiling are lost). rays are cast through a BVH of the
+ * surfaces and the rows of the map are traced on all cores.
+ *
+ * texels hold the light falling on the surface without the
+ * surface's own albedo, in the shader's units: Ld * cos * att
+ * for direct light, so the renderer multiplies it by Kd and the
+ * texture colour as it would the diffuse light of the lamp.
+ * the indirect part is denoised with an edge-stopping a-trous
+ * filter that stays inside each chart, and the texels between
+ * charts are filled from their neighbours so filtering across a
+ * chart's border does not darken it
+ *****************************************************************/
+// light of size x size texels (bottom row first), black outside the charts' dilation
+void bakeLightmap(const std::vector<LightmapSurface>& surfaces, const std::vector<LightmapChart>& charts,
+	const std::vector<BakeLight>& lights, const BakeSettings& settings, int size, std::vector<glm::vec3>& texels);
+
+#endif
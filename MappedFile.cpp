@@ -0,0 +1,118 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	// open file for reading
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mSize = static_cast<size_t>(fileSize.QuadPart);
+
+	// empty files cannot be mapped but are still valid
+	if (mSize > 0)
+	{
+		mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mMapping == nullptr)
+		{
+			close();
+			return false;
+		}
+
+		mData = static_cast<const unsigned char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+		if (mData == nullptr)
+		{
+			close();
+			return false;
+		}
+	}
+#else
+	// open file for reading
+	mFile = ::open(filename.c_str(), O_RDONLY);
+	if (mFile < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(mFile, &status) != 0)
+	{
+		close();
+		return false;
+	}
+
+	mSize = static_cast<size_t>(status.st_size);
+
+	// empty files cannot be mapped but are still valid
+	if (mSize > 0)
+	{
+		void* mapping = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+
+		madvise(mapping, mSize, MADV_SEQUENTIAL);
+		mData = static_cast<const unsigned char*>(mapping);
+	}
+#endif
+
+	mIsOpen = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+
+	mMapping = nullptr;
+	mFile = nullptr;
+#else
+	if (mData != nullptr)
+		munmap(const_cast<unsigned char*>(mData), mSize);
+	if (mFile >= 0)
+		::close(mFile);
+
+	mFile = -1;
+#endif
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+}
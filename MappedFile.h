@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/*****************************************************************
+ * read-only memory mapped file
+ *****************************************************************/
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// a mapping owns OS handles, so it cannot be copied
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// map the whole file into memory
+	bool open(const std::string& filename);
+	// unmap and release the file
+	void close();
+
+	const unsigned char* data() const { return mData; }
+	size_t size() const { return mSize; }
+	bool isOpen() const { return mIsOpen; }
+
+private:
+	const unsigned char* mData = nullptr;
+	size_t mSize = 0;
+	bool mIsOpen = false;
+
+#ifdef _WIN32
+	void* mFile = nullptr;		// file handle
+	void* mMapping = nullptr;	// file mapping handle
+#else
+	int mFile = -1;				// file descriptor
+#endif
+};
+
+#endif
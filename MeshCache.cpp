@@ -0,0 +1,218 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	const char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+
+	// index types as GL enumerates them (the cook tool has no GL headers)
+	const uint32_t INDEX_TYPE_UNSIGNED_SHORT = 0x1403;
+	const uint32_t INDEX_TYPE_UNSIGNED_INT = 0x1405;
+
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+	}
+
+	// check a section lies inside the file
+	bool sectionFits(uint64_t offset, uint64_t bytes, size_t fileSize)
+	{
+		return offset <= fileSize && bytes <= fileSize - offset;
+	}
+
+	// check a range of count items starting at first lies inside total
+	bool rangeFits(uint32_t first, uint32_t count, uint64_t total)
+	{
+		return static_cast<uint64_t>(first) + count <= total;
+	}
+
+	// check the sections agree with the header's counts and each other's ranges
+	bool isConsistent(const MeshCacheHeader& header, const MeshCacheData& data)
+	{
+		uint64_t indexSize;
+		if (header.indexType == INDEX_TYPE_UNSIGNED_SHORT)
+			indexSize = 2;
+		else if (header.indexType == INDEX_TYPE_UNSIGNED_INT)
+			indexSize = 4;
+		else
+			return false;
+
+		if (header.stride == 0 || static_cast<uint64_t>(header.numOfVertices) * header.stride > header.vertexBytes)
+			return false;
+		for (uint32_t i = 0; i < header.numOfAttributes; i++)
+		{
+			if (header.attributes[i].offset >= header.stride)
+				return false;
+		}
+
+		const uint64_t numOfIndices = header.indexBytes / indexSize;
+		for (uint32_t i = 0; i < header.numOfLods; i++)
+		{
+			if (!rangeFits(data.lods[i].firstIndex, data.lods[i].numOfIndices, numOfIndices))
+				return false;
+		}
+		for (uint32_t i = 0; i < header.numOfMeshlets; i++)
+		{
+			if (!rangeFits(data.meshlets[i].firstIndex, data.meshlets[i].numOfIndices, numOfIndices))
+				return false;
+		}
+
+		// every submesh draws at least one level
+		for (uint32_t i = 0; i < header.numOfSubmeshes; i++)
+		{
+			const MeshCacheSubmesh& submesh = data.submeshes[i];
+			if (submesh.numOfLods == 0
+				|| !rangeFits(submesh.firstLod, submesh.numOfLods, header.numOfLods)
+				|| !rangeFits(submesh.firstMeshlet, submesh.numOfMeshlets, header.numOfMeshlets)
+				|| submesh.materialIndex >= header.numOfMaterials
+				|| submesh.baseVertex >= header.numOfVertices)
+				return false;
+		}
+		return true;
+	}
+}
+
+uint64_t hashData(const void* data, size_t size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull ^ size;
+
+	// FNV style mixing over 8 byte words with an extra shift for the high bits
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++)
+		hash = (hash ^ bytes[i]) * prime;
+
+	return hash ^ (hash >> 32);
+}
+
+std::string meshCachePath(const std::string& source, uint64_t sourceHash, uint32_t importFlags)
+{
+	// one cache file per source contents and flag combination
+	uint64_t key = sourceHash ^ (static_cast<uint64_t>(importFlags) * 0x9e3779b97f4a7c15ull);
+
+	std::ostringstream path;
+	path << source << '.' << std::hex << std::setw(16) << std::setfill('0') << key << ".meshcache";
+	return path.str();
+}
+
+const MeshCacheHeader* openMeshCache(MappedFile& file, const std::string& path,
+	uint64_t sourceHash, uint32_t importFlags, MeshCacheData& data)
+{
+	if (!file.open(path))
+		return nullptr;
+
+	const MeshCacheHeader* header = reinterpret_cast<const MeshCacheHeader*>(file.data());
+
+	// reject foreign, outdated, stale or truncated files
+	bool isValid = file.size() >= sizeof(MeshCacheHeader)
+		&& std::memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0
+		&& header->version == MESH_CACHE_VERSION
+		&& header->sourceHash == sourceHash
+		&& header->importFlags == importFlags
+		&& header->numOfAttributes <= MAX_VERTEX_ATTRIBUTES
+		&& sectionFits(header->vertexOffset, header->vertexBytes, file.size())
+		&& sectionFits(header->indexOffset, header->indexBytes, file.size())
+		&& sectionFits(header->lodOffset, static_cast<uint64_t>(header->numOfLods) * sizeof(MeshCacheLod), file.size())
+		&& sectionFits(header->submeshOffset, static_cast<uint64_t>(header->numOfSubmeshes) * sizeof(MeshCacheSubmesh),
+			file.size())
+		&& sectionFits(header->materialOffset, static_cast<uint64_t>(header->numOfMaterials) * sizeof(MeshCacheMaterial),
+			file.size())
+		&& sectionFits(header->meshletOffset, static_cast<uint64_t>(header->numOfMeshlets) * sizeof(Meshlet), file.size())
+		&& header->lodOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header->submeshOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header->materialOffset % MESH_CACHE_ALIGNMENT == 0
+		&& header->meshletOffset % MESH_CACHE_ALIGNMENT == 0;
+
+	if (isValid)
+	{
+		const unsigned char* base = file.data();
+		data.vertices = base + header->vertexOffset;
+		data.indices = base + header->indexOffset;
+		data.lods = reinterpret_cast<const MeshCacheLod*>(base + header->lodOffset);
+		data.submeshes = reinterpret_cast<const MeshCacheSubmesh*>(base + header->submeshOffset);
+		data.materials = reinterpret_cast<const MeshCacheMaterial*>(base + header->materialOffset);
+		data.meshlets = reinterpret_cast<const Meshlet*>(base + header->meshletOffset);
+		isValid = isConsistent(*header, data);
+	}
+
+	if (!isValid)
+	{
+		data = MeshCacheData();
+		file.close();
+		return nullptr;
+	}
+	return header;
+}
+
+bool writeMeshCache(const std::string& path, MeshCacheHeader header, const MeshCacheData& data)
+{
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+
+	// lay out aligned sections after the header
+	const uint64_t lodBytes = header.numOfLods * sizeof(MeshCacheLod);
+	const uint64_t submeshBytes = header.numOfSubmeshes * sizeof(MeshCacheSubmesh);
+	const uint64_t materialBytes = header.numOfMaterials * sizeof(MeshCacheMaterial);
+	const uint64_t meshletBytes = header.numOfMeshlets * sizeof(Meshlet);
+	header.vertexOffset = alignOffset(sizeof(MeshCacheHeader));
+	header.indexOffset = alignOffset(header.vertexOffset + header.vertexBytes);
+	header.lodOffset = alignOffset(header.indexOffset + header.indexBytes);
+	header.submeshOffset = alignOffset(header.lodOffset + lodBytes);
+	header.materialOffset = alignOffset(header.submeshOffset + submeshBytes);
+	header.meshletOffset = alignOffset(header.materialOffset + materialBytes);
+
+	// write next to the cache and move it into place once complete,
+	// so a reader never maps a partly written file
+	const std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	// write a section followed by padding up to the next offset
+	uint64_t written = 0;
+	auto writeSection = [&file, &written](uint64_t offset, const void* data, uint64_t bytes)
+	{
+		static const char padding[MESH_CACHE_ALIGNMENT] = {};
+		file.write(padding, static_cast<std::streamsize>(offset - written));
+		file.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+		written = offset + bytes;
+	};
+
+	writeSection(0, &header, sizeof(header));
+	writeSection(header.vertexOffset, data.vertices, header.vertexBytes);
+	writeSection(header.indexOffset, data.indices, header.indexBytes);
+	writeSection(header.lodOffset, data.lods, lodBytes);
+	writeSection(header.submeshOffset, data.submeshes, submeshBytes);
+	writeSection(header.materialOffset, data.materials, materialBytes);
+	writeSection(header.meshletOffset, data.meshlets, meshletBytes);
+
+	file.close();
+	if (!file.good())
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	// rename does not replace an existing file on Windows
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
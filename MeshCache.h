@@ -0,0 +1,126 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MappedFile.h"
+#include "MeshletBuilder.h"
+
+/*****************************************************************
+ * binary cache of GPU ready meshes
+ *
+ * a cache file holds a header describing the interleaved vertex
+ * layout, bounds and levels of detail, followed by the raw vertex,
+ * index, lod, submesh, material and meshlet sections, so a mapped file can
+ * be handed straight to the GL buffer upload
+ *****************************************************************/
+
+const uint32_t MESH_CACHE_VERSION = 4;
+const uint32_t MAX_VERTEX_ATTRIBUTES = 8;
+const uint32_t MESH_CACHE_ALIGNMENT = 16;
+
+// one attribute of the interleaved vertex data (glVertexAttribPointer arguments)
+struct MeshCacheAttribute
+{
+	uint32_t location;
+	uint32_t size;
+	uint32_t type;
+	uint32_t normalized;
+	uint32_t offset;
+};
+
+// level of detail stored as a range of the index section
+struct MeshCacheLod
+{
+	uint32_t firstIndex;
+	uint32_t numOfIndices;
+	float error;
+};
+
+// part of the mesh drawn with one material; its levels of detail
+// and full resolution meshlets are ranges of the lod and meshlet sections
+struct MeshCacheSubmesh
+{
+	uint32_t baseVertex;
+	uint32_t materialIndex;
+	uint32_t firstLod;
+	uint32_t numOfLods;
+	uint32_t firstMeshlet;
+	uint32_t numOfMeshlets;
+};
+
+struct MeshCacheMaterial
+{
+	float ambient[3];
+	float diffuse[3];
+	float specular[3];
+	float shininess;
+};
+
+struct MeshCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;		// hash of the source file contents
+	uint32_t importFlags;		// processing applied when importing the source
+
+	// interleaved vertex layout
+	uint32_t stride;
+	uint32_t numOfAttributes;
+	MeshCacheAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+
+	// bounding box and sphere
+	float boundsMin[3];
+	float boundsMax[3];
+	float center[3];
+	float radius;
+
+	uint32_t numOfVertices;
+	uint32_t hasTexCoords;
+	uint32_t isQuantized;		// positions relative to the bounds, packed normals
+	uint32_t indexType;			// GL index type
+	uint32_t numOfLods;			// lod records of all submeshes
+	uint32_t numOfSubmeshes;
+	uint32_t numOfMaterials;
+	uint32_t numOfMeshlets;		// meshlets of all submeshes (index ranges are absolute)
+
+	// sections (byte offsets from the start of the file)
+	uint64_t vertexOffset;
+	uint64_t vertexBytes;
+	uint64_t indexOffset;
+	uint64_t indexBytes;
+	uint64_t lodOffset;
+	uint64_t submeshOffset;
+	uint64_t materialOffset;
+	uint64_t meshletOffset;
+};
+
+// section contents of a cache file
+struct MeshCacheData
+{
+	const void* vertices = nullptr;
+	const void* indices = nullptr;
+	const MeshCacheLod* lods = nullptr;
+	const MeshCacheSubmesh* submeshes = nullptr;
+	const MeshCacheMaterial* materials = nullptr;
+	const Meshlet* meshlets = nullptr;
+};
+
+// 64-bit hash of a block of memory
+uint64_t hashData(const void* data, size_t size);
+
+// cache file name for a source file imported with the given flags
+std::string meshCachePath(const std::string& source, uint64_t sourceHash, uint32_t importFlags);
+
+// map a cache file and check it matches the source and import flags
+// returns the header inside the mapping, or nullptr if missing or stale,
+// and points data at the sections inside the mapping
+const MeshCacheHeader* openMeshCache(MappedFile& file, const std::string& path,
+	uint64_t sourceHash, uint32_t importFlags, MeshCacheData& data);
+
+// write a cache file; the header's section offsets are filled in here
+bool writeMeshCache(const std::string& path, MeshCacheHeader header, const MeshCacheData& data);
+
+#endif
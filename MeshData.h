@@ -0,0 +1,51 @@
+#ifndef MESH_DATA_H
+#define MESH_DATA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// material parameters read from a model file
+struct MaterialData
+{
+	std::string name;
+	float ambient[3] = { 0.2f, 0.2f, 0.2f };
+	float diffuse[3] = { 0.8f, 0.8f, 0.8f };
+	float specular[3] = { 0.0f, 0.0f, 0.0f };
+	float shininess = 1.0f;
+	std::string diffuseMap;		// texture file, empty if none
+};
+
+// part of a mesh drawn with one material
+// indices of a submesh are relative to its first vertex (base vertex)
+struct SubmeshData
+{
+	size_t firstIndex = 0;
+	size_t numOfIndices = 0;
+	size_t firstVertex = 0;
+	size_t numOfVertices = 0;
+	unsigned int materialIndex = 0;
+};
+
+/*****************************************************************
+ * triangle mesh in system memory, one array per attribute
+ * (filled by the loaders before any processing or GPU upload)
+ *****************************************************************/
+struct MeshData
+{
+	std::vector<float> positions;		// xyz per vertex
+	std::vector<float> normals;			// xyz per vertex
+	std::vector<float> texCoords;		// uv per vertex, empty if the mesh has none
+	std::vector<float> tangents;		// xyz and handedness per vertex, empty unless generated
+	std::vector<unsigned int> indices;	// triangle lists of all submeshes
+
+	std::vector<SubmeshData> submeshes;	// at least one once loaded
+	std::vector<MaterialData> materials;
+
+	size_t numOfVertices() const { return positions.size() / 3; }
+	size_t numOfTriangles() const { return indices.size() / 3; }
+	bool hasTexCoords() const { return !texCoords.empty(); }
+	bool hasTangents() const { return !tangents.empty(); }
+};
+
+#endif
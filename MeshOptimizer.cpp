@@ -0,0 +1,315 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const unsigned int INVALID_VERTEX = ~0u;
+
+	// FIFO cache simulated with the time each vertex entered the cache
+	class CacheSimulator
+	{
+	public:
+		CacheSimulator(size_t vertexCount, unsigned int cacheSize)
+			: mTimestamps(vertexCount, 0), mTime(cacheSize + 1), mCacheSize(cacheSize)
+		{}
+
+		// returns the number of vertices of the triangle that missed the cache
+		unsigned int addTriangle(const unsigned int* triangle)
+		{
+			unsigned int misses = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				if (mTime - mTimestamps[triangle[k]] > mCacheSize)
+				{
+					mTimestamps[triangle[k]] = mTime++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+		void flush() { mTime += mCacheSize + 1; }
+
+	private:
+		std::vector<unsigned int> mTimestamps;
+		unsigned int mTime;
+		unsigned int mCacheSize;
+	};
+
+	// vertex to triangle adjacency in compressed row form
+	struct Adjacency
+	{
+		std::vector<unsigned int> offsets;		// first entry of each vertex
+		std::vector<unsigned int> triangles;
+
+		Adjacency(const std::vector<unsigned int>& indices, size_t vertexCount)
+			: offsets(vertexCount + 1, 0), triangles(indices.size())
+		{
+			for (unsigned int index : indices)
+				offsets[index + 1]++;
+			for (size_t i = 0; i < vertexCount; i++)
+				offsets[i + 1] += offsets[i];
+
+			std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+		}
+	};
+}
+
+VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int>& indices,
+	size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStatistics statistics;
+	if (indices.empty() || vertexCount == 0)
+		return statistics;
+
+	CacheSimulator cache(vertexCount, cacheSize);
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		statistics.numOfTransformed += cache.addTriangle(&indices[i]);
+
+	statistics.acmr = static_cast<float>(statistics.numOfTransformed) / (indices.size() / 3);
+	statistics.atvr = static_cast<float>(statistics.numOfTransformed) / vertexCount;
+	return statistics;
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& result,
+	const std::vector<unsigned int>& indices, size_t vertexCount,
+	unsigned int cacheSize, std::vector<size_t>* clusters)
+{
+	// Tipsify (Sander et al. 2007): emit all triangles around a fanning vertex,
+	// then move on to a neighbour that will still be in the cache
+	size_t triangleCount = indices.size() / 3;
+	result.resize(triangleCount * 3);
+	if (clusters != nullptr)
+		clusters->clear();
+
+	Adjacency adjacency(indices, vertexCount);
+
+	// triangles not emitted yet around each vertex
+	std::vector<unsigned int> liveCount(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+		liveCount[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd, candidates;
+	deadEnd.reserve(indices.size());
+
+	unsigned int time = cacheSize + 1;
+	size_t cursor = 0, output = 0;
+
+	// start from the first used vertex
+	while (cursor < vertexCount && liveCount[cursor] == 0)
+		cursor++;
+	unsigned int fanning = cursor < vertexCount ? static_cast<unsigned int>(cursor) : INVALID_VERTEX;
+	bool coldCache = true;
+
+	while (fanning != INVALID_VERTEX)
+	{
+		if (coldCache && clusters != nullptr)
+			clusters->push_back(output / 3);
+
+		// emit the remaining triangles around the fanning vertex
+		candidates.clear();
+		for (unsigned int i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++)
+		{
+			unsigned int triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+				continue;
+
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int vertex = indices[triangle * 3 + k];
+				result[output++] = vertex;
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveCount[vertex]--;
+
+				if (time - timestamps[vertex] > cacheSize)
+					timestamps[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// prefer the oldest candidate that stays in the cache while its triangles are emitted
+		unsigned int next = INVALID_VERTEX;
+		int bestPriority = -1;
+		for (unsigned int vertex : candidates)
+		{
+			if (liveCount[vertex] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - timestamps[vertex] + 2 * liveCount[vertex] <= cacheSize)
+				priority = static_cast<int>(time - timestamps[vertex]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		// dead end: most recently used vertex with triangles left, else the next in input order
+		coldCache = next == INVALID_VERTEX;
+		while (next == INVALID_VERTEX && !deadEnd.empty())
+		{
+			unsigned int vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveCount[vertex] > 0)
+				next = vertex;
+		}
+		while (next == INVALID_VERTEX && cursor < vertexCount)
+		{
+			if (liveCount[cursor] > 0)
+				next = static_cast<unsigned int>(cursor);
+			else
+				cursor++;
+		}
+
+		fanning = next;
+	}
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<size_t>& clusters,
+	const float* positions, size_t vertexCount, size_t stride,
+	float threshold, unsigned int cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || clusters.empty())
+		return;
+
+	auto position = [positions, stride](unsigned int vertex)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+	};
+
+	// split clusters where the cache has warmed up enough that a new start
+	// costs at most threshold times the cluster's own miss ratio
+	std::vector<size_t> starts;
+	CacheSimulator cache(vertexCount, cacheSize);
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		cache.flush();
+		unsigned int clusterMisses = 0;
+		for (size_t t = begin; t < end; t++)
+			clusterMisses += cache.addTriangle(&indices[t * 3]);
+		float clusterThreshold = threshold * clusterMisses / (end - begin);
+
+		cache.flush();
+		starts.push_back(begin);
+		unsigned int runningMisses = 0, runningTriangles = 0;
+
+		for (size_t t = begin; t < end; t++)
+		{
+			runningMisses += cache.addTriangle(&indices[t * 3]);
+			runningTriangles++;
+
+			if (t + 1 < end && static_cast<float>(runningMisses) / runningTriangles <= clusterThreshold)
+			{
+				starts.push_back(t + 1);
+				cache.flush();
+				runningMisses = runningTriangles = 0;
+			}
+		}
+	}
+
+	// area weighted centroid and normal of each cluster and of the mesh
+	std::vector<float> sortKeys(starts.size());
+	std::vector<float> centroids(starts.size() * 3, 0.0f), normals(starts.size() * 3, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		size_t end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+		float area = 0.0f;
+
+		for (size_t t = starts[c]; t < end; t++)
+		{
+			const float* p0 = position(indices[t * 3]);
+			const float* p1 = position(indices[t * 3 + 1]);
+			const float* p2 = position(indices[t * 3 + 2]);
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (int k = 0; k < 3; k++)
+			{
+				centroids[c * 3 + k] += (p0[k] + p1[k] + p2[k]) * triangleArea / 3.0f;
+				normals[c * 3 + k] += n[k];
+			}
+			area += triangleArea;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			meshCentroid[k] += centroids[c * 3 + k];
+			centroids[c * 3 + k] /= std::max(area, 1e-20f);
+		}
+		meshArea += area;
+	}
+
+	for (int k = 0; k < 3; k++)
+		meshCentroid[k] /= std::max(meshArea, 1e-20f);
+
+	// clusters far out along their facing direction tend to occlude the rest
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		const float* n = &normals[c * 3];
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+		sortKeys[c] = 0.0f;
+		for (int k = 0; k < 3; k++)
+			sortKeys[c] += (centroids[c * 3 + k] - meshCentroid[k]) * n[k] * scale;
+	}
+
+	std::vector<size_t> order(starts.size());
+	for (size_t c = 0; c < order.size(); c++)
+		order[c] = c;
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b)
+	{
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	// write clusters in sorted order
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (size_t c : order)
+	{
+		size_t end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+		sorted.insert(sorted.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+	}
+	indices.swap(sorted);
+}
+
+void optimizeVertexFetch(std::vector<unsigned int>& remap,
+	std::vector<unsigned int>& indices, size_t vertexCount)
+{
+	remap.assign(vertexCount, INVALID_VERTEX);
+	unsigned int next = 0;
+
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == INVALID_VERTEX)
+			remap[index] = next++;
+		index = remap[index];
+	}
+
+	// keep unused vertices so vertex ranges do not change
+	for (unsigned int& entry : remap)
+	{
+		if (entry == INVALID_VERTEX)
+			entry = next++;
+	}
+}
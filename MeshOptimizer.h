@@ -0,0 +1,50 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+/*****************************************************************
+ * index and vertex reordering for GPU efficiency
+ *
+ * triangles are reordered for the post-transform vertex cache
+ * (Tipsify), clusters of them sorted to reduce overdraw, and
+ * vertices renumbered in order of first use so the vertex buffer
+ * is fetched sequentially
+ *****************************************************************/
+
+// entries of the simulated FIFO post-transform cache
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStatistics
+{
+	size_t numOfTransformed = 0;	// cache misses
+	float acmr = 0.0f;				// average cache miss ratio (transformed vertices per triangle)
+	float atvr = 0.0f;				// average transform to vertex ratio (1.0 is optimal)
+};
+
+// simulate the post-transform cache over a triangle list
+VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int>& indices,
+	size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// reorder triangles for the post-transform cache
+// clusters (optional) receives the first triangle of every run that
+// starts after a dead end, i.e. with a cold cache
+void optimizeVertexCache(std::vector<unsigned int>& result,
+	const std::vector<unsigned int>& indices, size_t vertexCount,
+	unsigned int cacheSize = VERTEX_CACHE_SIZE, std::vector<size_t>* clusters = nullptr);
+
+// sort the clusters of a cache optimized triangle list so triangles on the
+// outside of the mesh facing away from its centre are drawn first
+// clusters are split further while the cache miss ratio stays within
+// threshold times that of the whole cluster (e.g. 1.05)
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<size_t>& clusters,
+	const float* positions, size_t vertexCount, size_t stride,
+	float threshold, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// renumber vertices in order of first use and rewrite the indices
+// remap[oldIndex] receives the new index; unused vertices go last
+void optimizeVertexFetch(std::vector<unsigned int>& remap,
+	std::vector<unsigned int>& indices, size_t vertexCount);
+
+#endif
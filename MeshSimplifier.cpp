@@ -0,0 +1,327 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	struct Vec3
+	{
+		float x, y, z;
+	};
+
+	Vec3 sub(const Vec3& a, const Vec3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	Vec3 cross(const Vec3& a, const Vec3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	float dot(const Vec3& a, const Vec3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// symmetric 4x4 matrix of summed squared plane distances plus total weight
+	struct Quadric
+	{
+		double a2 = 0, b2 = 0, c2 = 0, ab = 0, ac = 0, bc = 0;
+		double ad = 0, bd = 0, cd = 0, d2 = 0, w = 0;
+
+		void addPlane(const Vec3& n, float d, float weight)
+		{
+			a2 += weight * n.x * n.x; b2 += weight * n.y * n.y; c2 += weight * n.z * n.z;
+			ab += weight * n.x * n.y; ac += weight * n.x * n.z; bc += weight * n.y * n.z;
+			ad += weight * n.x * d; bd += weight * n.y * d; cd += weight * n.z * d;
+			d2 += weight * d * d;
+			w += weight;
+		}
+
+		void add(const Quadric& q)
+		{
+			a2 += q.a2; b2 += q.b2; c2 += q.c2; ab += q.ab; ac += q.ac; bc += q.bc;
+			ad += q.ad; bd += q.bd; cd += q.cd; d2 += q.d2; w += q.w;
+		}
+
+		// mean squared distance of p to the accumulated planes
+		float evaluate(const Vec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double e = a2 * x * x + b2 * y * y + c2 * z * z
+				+ 2.0 * (ab * x * y + ac * x * z + bc * y * z)
+				+ 2.0 * (ad * x + bd * y + cd * z) + d2;
+
+			return w > 0.0 ? static_cast<float>(std::fabs(e) / w) : 0.0f;
+		}
+	};
+
+	// candidate half-edge collapse
+	struct Collapse
+	{
+		unsigned int from;	// canonical vertex removed by the collapse
+		unsigned int to;	// vertex index it is moved onto
+		float error;		// squared error introduced
+	};
+
+	// hash of a position's bit pattern
+	struct PositionKey
+	{
+		uint32_t x, y, z;
+
+		bool operator==(const PositionKey& other) const
+		{
+			return x == other.x && y == other.y && z == other.z;
+		}
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return (key.x * 73856093u) ^ (key.y * 19349663u) ^ (key.z * 83492791u);
+		}
+	};
+}
+
+float simplifyMesh(std::vector<unsigned int>& result,
+	const std::vector<unsigned int>& indices,
+	const float* positions, size_t vertexCount, size_t stride,
+	size_t targetIndexCount, float targetError)
+{
+	result = indices;
+
+	if (indices.size() < 3 || vertexCount == 0)
+		return 0.0f;
+
+	// read the position of a vertex from the strided vertex data
+	auto position = [&](unsigned int i) -> Vec3
+	{
+		const float* p = reinterpret_cast<const float*>(
+			reinterpret_cast<const char*>(positions) + i * stride);
+		return { p[0], p[1], p[2] };
+	};
+
+	// map vertices that share a position (normal/uv seams) onto one canonical vertex
+	std::vector<unsigned int> canonical(vertexCount);
+	std::vector<unsigned char> locked(vertexCount, 0);
+	{
+		std::unordered_map<PositionKey, unsigned int, PositionKeyHash> unique;
+		unique.reserve(vertexCount);
+
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			Vec3 p = position(i);
+			PositionKey key;
+			std::memcpy(&key.x, &p.x, sizeof(float));
+			std::memcpy(&key.y, &p.y, sizeof(float));
+			std::memcpy(&key.z, &p.z, sizeof(float));
+
+			auto found = unique.emplace(key, i);
+			canonical[i] = found.first->second;
+
+			// seam vertices keep their position so attribute discontinuities survive
+			if (!found.second)
+				locked[canonical[i]] = 1;
+		}
+	}
+
+	// lock vertices on open borders and non-manifold edges
+	{
+		std::unordered_map<uint64_t, unsigned int> edges;
+		edges.reserve(indices.size());
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = canonical[indices[i + e]];
+				unsigned int b = canonical[indices[i + (e + 1) % 3]];
+				uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+				edges[key]++;
+			}
+		}
+
+		for (const auto& edge : edges)
+		{
+			if (edge.second != 2)
+			{
+				locked[static_cast<unsigned int>(edge.first >> 32)] = 1;
+				locked[static_cast<unsigned int>(edge.first & 0xffffffffu)] = 1;
+			}
+		}
+	}
+
+	// accumulate area weighted plane quadrics
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		Vec3 p0 = position(indices[i]);
+		Vec3 p1 = position(indices[i + 1]);
+		Vec3 p2 = position(indices[i + 2]);
+
+		Vec3 n = cross(sub(p1, p0), sub(p2, p0));
+		float length = std::sqrt(dot(n, n));
+		if (length == 0.0f)
+			continue;
+
+		n = { n.x / length, n.y / length, n.z / length };
+		float d = -dot(n, p0);
+		float area = 0.5f * length;
+
+		for (int k = 0; k < 3; k++)
+			quadrics[canonical[indices[i + k]]].addPlane(n, d, area);
+	}
+
+	const float maxError = targetError * targetError;
+	float error = 0.0f;
+
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1);
+	std::vector<unsigned int> vertexTriangles;
+	std::vector<Collapse> candidates;
+	std::vector<unsigned int> collapseTarget(vertexCount);
+	std::vector<unsigned char> touched(vertexCount);
+
+	// collapse edges in passes until the target is reached or nothing can be collapsed
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		// triangles adjacent to each canonical vertex
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (unsigned int index : result)
+			triangleOffsets[canonical[index] + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			triangleOffsets[i + 1] += triangleOffsets[i];
+
+		vertexTriangles.resize(result.size());
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+			vertexTriangles[fill[canonical[result[i]]]++] = static_cast<unsigned int>(i / 3);
+
+		// gather every edge of the mesh as a potential collapse in both directions
+		candidates.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = result[i + e];
+				unsigned int b = result[i + (e + 1) % 3];
+
+				if (!locked[canonical[a]])
+					candidates.push_back({ canonical[a], b, quadrics[canonical[a]].evaluate(position(b)) });
+				if (!locked[canonical[b]])
+					candidates.push_back({ canonical[b], a, quadrics[canonical[b]].evaluate(position(a)) });
+			}
+		}
+
+		if (candidates.empty())
+			break;
+
+		std::sort(candidates.begin(), candidates.end(),
+			[](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		// every collapse removes about two triangles
+		size_t goal = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		size_t collapses = 0;
+
+		std::fill(collapseTarget.begin(), collapseTarget.end(), UINT_MAX);
+		std::fill(touched.begin(), touched.end(), 0);
+
+		for (const Collapse& collapse : candidates)
+		{
+			if (collapses >= goal || collapse.error > maxError)
+				break;
+
+			unsigned int from = collapse.from;
+			unsigned int to = canonical[collapse.to];
+
+			// one collapse per neighbourhood per pass keeps the flip test valid
+			if (touched[from] || touched[to])
+				continue;
+
+			// reject collapses that would flip any of the remaining triangles
+			Vec3 target = position(collapse.to);
+			bool flips = false;
+
+			for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1] && !flips; t++)
+			{
+				const unsigned int* triangle = &result[vertexTriangles[t] * 3];
+				Vec3 p[3], q[3];
+				bool degenerate = false;
+
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int c = canonical[triangle[k]];
+					degenerate = degenerate || c == to;
+					p[k] = position(triangle[k]);
+					q[k] = c == from ? target : p[k];
+				}
+
+				// triangles containing the edge disappear
+				if (degenerate)
+					continue;
+
+				Vec3 before = cross(sub(p[1], p[0]), sub(p[2], p[0]));
+				Vec3 after = cross(sub(q[1], q[0]), sub(q[2], q[0]));
+				float limit = 0.25f * std::sqrt(dot(before, before) * dot(after, after));
+
+				flips = dot(before, after) <= limit;
+			}
+
+			if (flips)
+				continue;
+
+			// lock the one-ring of the removed vertex for the rest of this pass
+			for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+			{
+				const unsigned int* triangle = &result[vertexTriangles[t] * 3];
+				for (int k = 0; k < 3; k++)
+					touched[canonical[triangle[k]]] = 1;
+			}
+
+			collapseTarget[from] = collapse.to;
+			quadrics[to].add(quadrics[from]);
+			locked[from] = 1;
+
+			error = std::max(error, collapse.error);
+			collapses++;
+		}
+
+		if (collapses == 0)
+			break;
+
+		// apply collapses and drop triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			unsigned int triangle[3];
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int index = result[i + k];
+				unsigned int target = collapseTarget[canonical[index]];
+				triangle[k] = target != UINT_MAX ? target : index;
+			}
+
+			unsigned int c0 = canonical[triangle[0]];
+			unsigned int c1 = canonical[triangle[1]];
+			unsigned int c2 = canonical[triangle[2]];
+
+			if (c0 != c1 && c1 != c2 && c0 != c2)
+			{
+				result[write++] = triangle[0];
+				result[write++] = triangle[1];
+				result[write++] = triangle[2];
+			}
+		}
+		result.resize(write);
+	}
+
+	return std::sqrt(error);
+}
@@ -0,0 +1,24 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+/*****************************************************************
+ * quadric error metric (QEM) mesh simplification
+ *
+ * collapses edges onto existing vertices (half-edge collapse) so
+ * every simplified index list still references the original
+ * vertex buffer, which lets LODs share one VBO
+ *****************************************************************/
+
+// simplify a triangle list towards targetIndexCount indices
+// positions: first float of the xyz position of vertex 0
+// stride: distance in bytes between consecutive vertex positions
+// returns the object space error of the result (approximate distance)
+float simplifyMesh(std::vector<unsigned int>& result,
+	const std::vector<unsigned int>& indices,
+	const float* positions, size_t vertexCount, size_t stride,
+	size_t targetIndexCount, float targetError);
+
+#endif
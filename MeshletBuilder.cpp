@@ -0,0 +1,166 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// cones wider than this (smallest normal dot axis) never face away completely
+	const float MIN_CONE_DOT = 0.1f;
+
+	float dot3(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// bounding sphere and normal cone of the triangles in [first, last)
+	void computeBounds(Meshlet& meshlet, const unsigned int* indices, size_t first, size_t last,
+		const float* positions, size_t stride)
+	{
+		auto position = [positions, stride](unsigned int vertex)
+		{
+			return reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + vertex * stride);
+		};
+
+		// sphere around the centre of the bounding box
+		float boundsMin[3] = { INFINITY, INFINITY, INFINITY };
+		float boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (size_t i = first; i < last; i++)
+		{
+			const float* p = position(indices[i]);
+			for (int k = 0; k < 3; k++)
+			{
+				boundsMin[k] = std::min(boundsMin[k], p[k]);
+				boundsMax[k] = std::max(boundsMax[k], p[k]);
+			}
+		}
+		for (int k = 0; k < 3; k++)
+			meshlet.center[k] = 0.5f * (boundsMin[k] + boundsMax[k]);
+
+		meshlet.radius = 0.0f;
+		for (size_t i = first; i < last; i++)
+		{
+			const float* p = position(indices[i]);
+			float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+			meshlet.radius = std::max(meshlet.radius, std::sqrt(dot3(d, d)));
+		}
+
+		// unit triangle normals, skipping degenerate triangles
+		std::vector<float> normals;
+		normals.reserve(last - first);
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		for (size_t i = first; i + 2 < last; i += 3)
+		{
+			const float* p0 = position(indices[i]);
+			const float* p1 = position(indices[i + 1]);
+			const float* p2 = position(indices[i + 2]);
+
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float length = std::sqrt(dot3(n, n));
+			if (length == 0.0f)
+				continue;
+
+			for (int k = 0; k < 3; k++)
+			{
+				normals.push_back(n[k] / length);
+				axis[k] += n[k] / length;
+			}
+		}
+
+		// the cone is only useful if every normal lies well within a hemisphere
+		float axisLength = std::sqrt(dot3(axis, axis));
+		float minDot = -1.0f;
+		if (axisLength > 0.0f)
+		{
+			for (int k = 0; k < 3; k++)
+				axis[k] /= axisLength;
+
+			minDot = 1.0f;
+			for (size_t i = 0; i < normals.size(); i += 3)
+				minDot = std::min(minDot, dot3(&normals[i], axis));
+		}
+
+		std::copy_n(axis, 3, meshlet.coneAxis);
+		meshlet.coneCutoff = minDot < MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+void buildMeshlets(std::vector<Meshlet>& meshlets, const unsigned int* indices, size_t numOfIndices,
+	const float* positions, size_t vertexCount, size_t stride)
+{
+	// meshlet each vertex was last added to, so shared vertices are counted once
+	std::vector<size_t> owner(vertexCount, ~size_t(0));
+	size_t meshletId = 0;
+	size_t first = 0, numOfVertices = 0;
+
+	for (size_t i = 0; i + 2 < numOfIndices; i += 3)
+	{
+		size_t newVertices = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			bool isShared = owner[indices[i + k]] == meshletId;
+			for (int j = 0; j < k && !isShared; j++)
+				isShared = indices[i + j] == indices[i + k];
+			if (!isShared)
+				newVertices++;
+		}
+
+		// close the meshlet once either limit would be exceeded
+		if (numOfVertices + newVertices > MESHLET_MAX_VERTICES || (i - first) / 3 == MESHLET_MAX_TRIANGLES)
+		{
+			Meshlet meshlet;
+			meshlet.firstIndex = static_cast<uint32_t>(first);
+			meshlet.numOfIndices = static_cast<uint32_t>(i - first);
+			computeBounds(meshlet, indices, first, i, positions, stride);
+			meshlets.push_back(meshlet);
+
+			meshletId++;
+			first = i;
+			numOfVertices = 0;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (owner[indices[i + k]] != meshletId)
+			{
+				owner[indices[i + k]] = meshletId;
+				numOfVertices++;
+			}
+		}
+	}
+
+	size_t last = numOfIndices / 3 * 3;
+	if (last > first)
+	{
+		Meshlet meshlet;
+		meshlet.firstIndex = static_cast<uint32_t>(first);
+		meshlet.numOfIndices = static_cast<uint32_t>(last - first);
+		computeBounds(meshlet, indices, first, last, positions, stride);
+		meshlets.push_back(meshlet);
+	}
+}
+
+bool isMeshletVisible(const Meshlet& meshlet, const MeshletCullView& view)
+{
+	// sphere entirely behind any plane
+	for (int i = 0; i < 6; i++)
+	{
+		if (dot3(view.planes[i], meshlet.center) + view.planes[i][3] < -meshlet.radius)
+			return false;
+	}
+
+	if (meshlet.coneCutoff >= 1.0f)
+		return true;
+
+	// every triangle faces away when the view direction lies inside the
+	// cone's complement around its axis
+	if (view.isOrthographic)
+		return dot3(view.direction, meshlet.coneAxis) < meshlet.coneCutoff;
+
+	float toCenter[3] = { meshlet.center[0] - view.position[0], meshlet.center[1] - view.position[1],
+		meshlet.center[2] - view.position[2] };
+	float distance = std::sqrt(dot3(toCenter, toCenter));
+	return dot3(toCenter, meshlet.coneAxis) < meshlet.coneCutoff * distance + meshlet.radius;
+}
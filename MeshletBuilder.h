@@ -0,0 +1,50 @@
+#ifndef MESHLET_BUILDER_H
+#define MESHLET_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*****************************************************************
+ * meshlets: small clusters of a triangle list that can be culled
+ * as a whole
+ *
+ * each meshlet is a contiguous range of the (cache optimized)
+ * index list, so survivors are drawn straight from the index
+ * buffer; a bounding sphere and a cone around the triangle
+ * normals let whole clusters be rejected outside the frustum or
+ * facing away from the camera
+ *****************************************************************/
+
+// limits matching typical mesh shader outputs
+const size_t MESHLET_MAX_VERTICES = 64;
+const size_t MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet
+{
+	uint32_t firstIndex;		// offset into the index list (in indices)
+	uint32_t numOfIndices;
+	float center[3];			// bounding sphere
+	float radius;
+	float coneAxis[3];			// average triangle normal
+	float coneCutoff;			// sine of the cone's half angle, 1 if it cannot be culled
+};
+
+// camera seen from the object space of a mesh
+struct MeshletCullView
+{
+	float planes[6][4];			// frustum planes (xyz normalized, inside is positive)
+	float position[3];			// camera position (perspective)
+	float direction[3];			// view direction (orthographic)
+	bool isOrthographic;
+};
+
+// split a triangle list into meshlets; firstIndex is relative to indices
+// positions has stride bytes between vertices
+void buildMeshlets(std::vector<Meshlet>& meshlets, const unsigned int* indices, size_t numOfIndices,
+	const float* positions, size_t vertexCount, size_t stride);
+
+// false if the meshlet is outside the frustum or all its triangles face away
+bool isMeshletVisible(const Meshlet& meshlet, const MeshletCullView& view);
+
+#endif
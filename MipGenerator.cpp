@@ -0,0 +1,375 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE
+#endif
+
+namespace
+{
+	// destination rows per parallel range
+	const size_t MIP_ROW_GRAIN = 16;
+
+	// Kaiser kernel radius (destination texels) and shape
+	const float KAISER_RADIUS = 3.0f;
+	const float KAISER_ALPHA = 4.0f;
+
+	const float PI = 3.14159265f;
+
+	// one texel as four floats (missing channels zero, alpha one)
+	struct Texel
+	{
+#ifdef MIP_GENERATOR_SSE
+		__m128 value;
+#else
+		float value[4];
+#endif
+	};
+
+	inline Texel loadTexel(const float* source)
+	{
+		Texel texel;
+#ifdef MIP_GENERATOR_SSE
+		texel.value = _mm_loadu_ps(source);
+#else
+		std::copy_n(source, 4, texel.value);
+#endif
+		return texel;
+	}
+
+	inline void storeTexel(float* destination, const Texel& texel)
+	{
+#ifdef MIP_GENERATOR_SSE
+		_mm_storeu_ps(destination, texel.value);
+#else
+		std::copy_n(texel.value, 4, destination);
+#endif
+	}
+
+	inline Texel zeroTexel()
+	{
+		Texel texel;
+#ifdef MIP_GENERATOR_SSE
+		texel.value = _mm_setzero_ps();
+#else
+		std::fill_n(texel.value, 4, 0.0f);
+#endif
+		return texel;
+	}
+
+	// sum + texel * weight
+	inline Texel multiplyAdd(const Texel& sum, const Texel& texel, float weight)
+	{
+		Texel result;
+#ifdef MIP_GENERATOR_SSE
+		result.value = _mm_add_ps(sum.value, _mm_mul_ps(texel.value, _mm_set1_ps(weight)));
+#else
+		for (int k = 0; k < 4; k++)
+			result.value[k] = sum.value[k] + texel.value[k] * weight;
+#endif
+		return result;
+	}
+
+	// image of four float channels
+	struct LinearImage
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<float> texels;
+
+		float* row(int y) { return &texels[static_cast<size_t>(y) * width * 4]; }
+		const float* row(int y) const { return &texels[static_cast<size_t>(y) * width * 4]; }
+	};
+
+	float srgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	}
+
+	unsigned char toByte(float value)
+	{
+		return static_cast<unsigned char>(std::floor(std::max(0.0f, std::min(1.0f, value)) * 255.0f + 0.5f));
+	}
+
+	int wrapCoordinate(int coordinate, int size, bool wrap)
+	{
+		if (wrap)
+			return ((coordinate % size) + size) % size;
+		return std::max(0, std::min(size - 1, coordinate));
+	}
+
+	// decode bytes to linear light (normal maps to [-1, 1])
+	void decodeImage(const MipImage& image, unsigned int flags, LinearImage& output)
+	{
+		float table[256];
+		for (int i = 0; i < 256; i++)
+		{
+			float value = i / 255.0f;
+			if (flags & MIP_NORMAL_MAP)
+				table[i] = value * 2.0f - 1.0f;
+			else if (flags & MIP_SRGB)
+				table[i] = srgbToLinear(value);
+			else
+				table[i] = value;
+		}
+
+		output.width = image.width;
+		output.height = image.height;
+		output.texels.assign(static_cast<size_t>(image.width) * image.height * 4, 0.0f);
+
+		size_t numOfTexels = static_cast<size_t>(image.width) * image.height;
+		int colourChannels = std::min(image.numOfChannels, 3);
+		for (size_t i = 0; i < numOfTexels; i++)
+		{
+			const unsigned char* source = &image.pixels[i * image.numOfChannels];
+			float* texel = &output.texels[i * 4];
+			for (int k = 0; k < colourChannels; k++)
+				texel[k] = table[source[k]];
+			// grey and alpha images keep alpha in their last channel
+			texel[3] = (image.numOfChannels == 2 || image.numOfChannels == 4)
+				? source[image.numOfChannels - 1] / 255.0f : 1.0f;
+		}
+	}
+
+	void encodeImage(const LinearImage& input, int numOfChannels, unsigned int flags, MipImage& image)
+	{
+		image.width = input.width;
+		image.height = input.height;
+		image.numOfChannels = numOfChannels;
+		image.pixels.resize(static_cast<size_t>(input.width) * input.height * numOfChannels);
+
+		int colourChannels = std::min(numOfChannels, 3);
+		parallelFor(0, input.height, MIP_ROW_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t y = first; y < last; y++)
+			{
+				const float* row = input.row(static_cast<int>(y));
+				unsigned char* output = &image.pixels[y * input.width * numOfChannels];
+				for (int x = 0; x < input.width; x++)
+				{
+					const float* texel = row + x * 4;
+					unsigned char* pixel = output + x * numOfChannels;
+					for (int k = 0; k < colourChannels; k++)
+					{
+						if (flags & MIP_NORMAL_MAP)
+							pixel[k] = toByte(texel[k] * 0.5f + 0.5f);
+						else if (flags & MIP_SRGB)
+							pixel[k] = toByte(linearToSrgb(texel[k]));
+						else
+							pixel[k] = toByte(texel[k]);
+					}
+					if (numOfChannels == 2 || numOfChannels == 4)
+						pixel[numOfChannels - 1] = toByte(texel[3]);
+				}
+			}
+		});
+	}
+
+	// average of the 2x2 texels under each destination texel
+	void downsampleBox(const LinearImage& source, LinearImage& destination, bool wrap)
+	{
+		parallelFor(0, destination.height, MIP_ROW_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t y = first; y < last; y++)
+			{
+				const float* row0 = source.row(wrapCoordinate(static_cast<int>(y) * 2, source.height, wrap));
+				const float* row1 = source.row(wrapCoordinate(static_cast<int>(y) * 2 + 1, source.height, wrap));
+				float* output = destination.row(static_cast<int>(y));
+
+				for (int x = 0; x < destination.width; x++)
+				{
+					int x0 = wrapCoordinate(x * 2, source.width, wrap) * 4;
+					int x1 = wrapCoordinate(x * 2 + 1, source.width, wrap) * 4;
+
+					Texel sum = zeroTexel();
+					sum = multiplyAdd(sum, loadTexel(row0 + x0), 0.25f);
+					sum = multiplyAdd(sum, loadTexel(row0 + x1), 0.25f);
+					sum = multiplyAdd(sum, loadTexel(row1 + x0), 0.25f);
+					sum = multiplyAdd(sum, loadTexel(row1 + x1), 0.25f);
+					storeTexel(output + x * 4, sum);
+				}
+			}
+		});
+	}
+
+	// zeroth order modified Bessel function of the first kind
+	float besselI0(float x)
+	{
+		float sum = 1.0f, term = 1.0f;
+		for (int k = 1; k < 32 && term > sum * 1e-8f; k++)
+		{
+			float factor = x / (2.0f * k);
+			term *= factor * factor;
+			sum += term;
+		}
+		return sum;
+	}
+
+	float kaiser(float t)
+	{
+		float x = t / KAISER_RADIUS;
+		if (std::abs(x) >= 1.0f)
+			return 0.0f;
+		float sinc = t == 0.0f ? 1.0f : std::sin(PI * t) / (PI * t);
+		return sinc * besselI0(KAISER_ALPHA * std::sqrt(1.0f - x * x)) / besselI0(KAISER_ALPHA);
+	}
+
+	// normalized taps of one destination coordinate
+	struct FilterTaps
+	{
+		int first = 0;
+		std::vector<float> weights;
+	};
+
+	std::vector<FilterTaps> kaiserTaps(int sourceSize, int destinationSize)
+	{
+		float ratio = static_cast<float>(sourceSize) / destinationSize;
+		std::vector<FilterTaps> taps(destinationSize);
+		for (int i = 0; i < destinationSize; i++)
+		{
+			// kernel is KAISER_RADIUS destination texels wide on each side
+			float center = (i + 0.5f) * ratio - 0.5f;
+			int first = static_cast<int>(std::floor(center - KAISER_RADIUS * ratio));
+			int last = static_cast<int>(std::ceil(center + KAISER_RADIUS * ratio));
+
+			float total = 0.0f;
+			taps[i].first = first;
+			for (int s = first; s <= last; s++)
+			{
+				float weight = kaiser((s - center) / ratio);
+				taps[i].weights.push_back(weight);
+				total += weight;
+			}
+			for (float& weight : taps[i].weights)
+				weight /= total;
+		}
+		return taps;
+	}
+
+	// separable Kaiser filter, horizontal then vertical
+	void downsampleKaiser(const LinearImage& source, LinearImage& destination, bool wrap)
+	{
+		std::vector<FilterTaps> columns = kaiserTaps(source.width, destination.width);
+		std::vector<FilterTaps> rows = kaiserTaps(source.height, destination.height);
+
+		LinearImage horizontal;
+		horizontal.width = destination.width;
+		horizontal.height = source.height;
+		horizontal.texels.resize(static_cast<size_t>(horizontal.width) * horizontal.height * 4);
+
+		parallelFor(0, source.height, MIP_ROW_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t y = first; y < last; y++)
+			{
+				const float* input = source.row(static_cast<int>(y));
+				float* output = horizontal.row(static_cast<int>(y));
+				for (int x = 0; x < destination.width; x++)
+				{
+					const FilterTaps& taps = columns[x];
+					Texel sum = zeroTexel();
+					for (size_t t = 0; t < taps.weights.size(); t++)
+					{
+						int column = wrapCoordinate(taps.first + static_cast<int>(t), source.width, wrap);
+						sum = multiplyAdd(sum, loadTexel(input + column * 4), taps.weights[t]);
+					}
+					storeTexel(output + x * 4, sum);
+				}
+			}
+		});
+
+		parallelFor(0, destination.height, MIP_ROW_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t y = first; y < last; y++)
+			{
+				const FilterTaps& taps = rows[y];
+				float* output = destination.row(static_cast<int>(y));
+				for (int x = 0; x < destination.width; x++)
+					storeTexel(output + x * 4, zeroTexel());
+
+				// accumulate whole source rows so reads stay sequential
+				for (size_t t = 0; t < taps.weights.size(); t++)
+				{
+					const float* input = horizontal.row(wrapCoordinate(taps.first + static_cast<int>(t), source.height, wrap));
+					for (int x = 0; x < destination.width; x++)
+						storeTexel(output + x * 4, multiplyAdd(loadTexel(output + x * 4), loadTexel(input + x * 4), taps.weights[t]));
+				}
+			}
+		});
+	}
+
+	void renormalize(LinearImage& image)
+	{
+		size_t numOfTexels = static_cast<size_t>(image.width) * image.height;
+		for (size_t i = 0; i < numOfTexels; i++)
+		{
+			float* texel = &image.texels[i * 4];
+			float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+			if (length > 0.0f)
+			{
+				texel[0] /= length;
+				texel[1] /= length;
+				texel[2] /= length;
+			}
+			else
+			{
+				texel[0] = texel[1] = 0.0f;
+				texel[2] = 1.0f;
+			}
+		}
+	}
+}
+
+int numOfMipLevels(int width, int height)
+{
+	int numOfLevels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(1, width / 2);
+		height = std::max(1, height / 2);
+		numOfLevels++;
+	}
+	return numOfLevels;
+}
+
+void generateMipChain(const MipImage& image, MipFilter filter, unsigned int flags,
+	std::vector<MipImage>& levels)
+{
+	levels.assign(1, image);
+
+	// every level is filtered from the full precision previous one
+	LinearImage current;
+	decodeImage(image, flags, current);
+
+	bool wrap = (flags & MIP_WRAP) != 0;
+	int numOfLevels = numOfMipLevels(image.width, image.height);
+	for (int level = 1; level < numOfLevels; level++)
+	{
+		LinearImage next;
+		next.width = std::max(1, current.width / 2);
+		next.height = std::max(1, current.height / 2);
+		next.texels.resize(static_cast<size_t>(next.width) * next.height * 4);
+
+		if (filter == MIP_FILTER_KAISER)
+			downsampleKaiser(current, next, wrap);
+		else
+			downsampleBox(current, next, wrap);
+
+		if (flags & MIP_NORMAL_MAP)
+			renormalize(next);
+
+		levels.push_back(MipImage());
+		encodeImage(next, image.numOfChannels, flags, levels.back());
+		current.texels.swap(next.texels);
+		current.width = next.width;
+		current.height = next.height;
+	}
+}
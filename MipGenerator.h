@@ -0,0 +1,45 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <vector>
+
+/*****************************************************************
+ * offline mip chain generation
+ *
+ * levels are filtered from the previous level in linear light
+ * (sRGB colour is decoded first and encoded again for each level)
+ * with a 2x2 box or a Kaiser windowed sinc kernel; pixels are
+ * processed as four floats with SSE where available
+ *****************************************************************/
+
+enum MipFilter
+{
+	MIP_FILTER_BOX,			// average of 2x2 texels
+	MIP_FILTER_KAISER		// windowed sinc, sharper minification without ringing
+};
+
+enum MipFlags
+{
+	MIP_SRGB = 1 << 0,			// colour channels are sRGB encoded (alpha is always linear)
+	MIP_NORMAL_MAP = 1 << 1,	// texels are unit vectors in [0, 1], renormalized per level
+	MIP_WRAP = 1 << 2,			// repeat at the edges instead of clamping (GL_REPEAT textures)
+	MIP_GGX = 1 << 3			// cube levels prefiltered for GGX reflections (see EnvironmentPrefilter.h)
+};
+
+// 8-bit image with tightly packed rows in GL order (first row at the bottom)
+struct MipImage
+{
+	int width = 0;
+	int height = 0;
+	int numOfChannels = 0;		// 1 to 4
+	std::vector<unsigned char> pixels;
+};
+
+// levels receives the full chain down to 1x1, levels[0] being a copy of image
+void generateMipChain(const MipImage& image, MipFilter filter, unsigned int flags,
+	std::vector<MipImage>& levels);
+
+// number of levels of a full chain for an image size
+int numOfMipLevels(int width, int height);
+
+#endif
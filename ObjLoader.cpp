@@ -0,0 +1,924 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	// minimum amount of text handed to one parsing task
+	const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	// flags for indices that were negative (relative) in the file
+	const int RELATIVE_V = 1;
+	const int RELATIVE_VT = 2;
+	const int RELATIVE_VN = 4;
+
+	// triangle corner: 0-based position/uv/normal indices, -1 if absent
+	struct Corner
+	{
+		int v = -1;
+		int vt = -1;
+		int vn = -1;
+		int relative = 0;	// relative indices are stored relative to the chunk start
+
+		bool operator==(const Corner& other) const
+		{
+			return v == other.v && vt == other.vt && vn == other.vn;
+		}
+	};
+
+	// usemtl statement: material of the faces from a corner onwards
+	struct MaterialSwitch
+	{
+		size_t corner;
+		std::string name;
+	};
+
+	// line aligned piece of the file and everything parsed from it
+	struct Chunk
+	{
+		const char* begin = nullptr;
+		const char* end = nullptr;
+		std::vector<float> positions;
+		std::vector<float> texCoords;
+		std::vector<float> normals;
+		std::vector<Corner> corners;	// triangulated faces
+		std::vector<MaterialSwitch> materials;
+		std::vector<std::string> libraries;	// mtllib file names
+		bool isValid = true;
+	};
+
+	const double POWERS_OF_10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool isDigit(char c)
+	{
+		return static_cast<unsigned int>(c - '0') < 10u;
+	}
+
+	inline const char* skipSpace(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+			p++;
+		return p;
+	}
+
+	// parse a decimal number such as -1.25e-3 (no locale, no allocation)
+	const char* parseFloat(const char* p, const char* end, float& value)
+	{
+		p = skipSpace(p, end);
+
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		// up to 19 significant digits fit into the mantissa
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int numOfDigits = 0;
+
+		for (; p < end && isDigit(*p); p++)
+		{
+			if (numOfDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				numOfDigits += mantissa != 0;
+			}
+			else
+				exponent++;
+		}
+
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && isDigit(*p); p++)
+			{
+				if (numOfDigits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					numOfDigits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+'))
+				negativeExponent = *p++ == '-';
+
+			int e = 0;
+			for (; p < end && isDigit(*p); p++)
+				e = std::min(e * 10 + (*p - '0'), 9999);
+			exponent += negativeExponent ? -e : e;
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (exponent < 0 && exponent >= -22)
+			result /= POWERS_OF_10[-exponent];
+		else if (exponent > 0 && exponent <= 22)
+			result *= POWERS_OF_10[exponent];
+		else if (exponent != 0)
+			result *= std::pow(10.0, exponent);
+
+		value = static_cast<float>(negative ? -result : result);
+		return p;
+	}
+
+	// parse a signed integer, returns nullptr if there are no digits
+	const char* parseInt(const char* p, const char* end, int& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = *p++ == '-';
+
+		if (p >= end || !isDigit(*p))
+			return nullptr;
+
+		int result = 0;
+		for (; p < end && isDigit(*p); p++)
+			result = result * 10 + (*p - '0');
+
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// convert a 1-based (or negative relative) OBJ index into a 0-based one
+	bool resolveIndex(int raw, size_t numOfElements, int flag, int& index, int& relative)
+	{
+		if (raw > 0)
+		{
+			index = raw - 1;
+		}
+		else if (raw < 0)
+		{
+			// elements before this chunk are added during the merge
+			index = static_cast<int>(numOfElements) + raw;
+			relative |= flag;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	// parse the corners of one face line
+	bool parseFace(const char* p, const char* end, const Chunk& chunk, std::vector<Corner>& polygon)
+	{
+		polygon.clear();
+
+		for (p = skipSpace(p, end); p < end; p = skipSpace(p, end))
+		{
+			Corner corner;
+			int raw;
+
+			// position index
+			p = parseInt(p, end, raw);
+			if (p == nullptr || !resolveIndex(raw, chunk.positions.size() / 3, RELATIVE_V, corner.v, corner.relative))
+				return false;
+
+			if (p < end && *p == '/')
+			{
+				// optional texture coordinate index
+				if (++p < end && *p != '/')
+				{
+					p = parseInt(p, end, raw);
+					if (p == nullptr || !resolveIndex(raw, chunk.texCoords.size() / 2, RELATIVE_VT, corner.vt, corner.relative))
+						return false;
+				}
+
+				// optional normal index
+				if (p < end && *p == '/')
+				{
+					p = parseInt(p + 1, end, raw);
+					if (p == nullptr || !resolveIndex(raw, chunk.normals.size() / 3, RELATIVE_VN, corner.vn, corner.relative))
+						return false;
+				}
+			}
+
+			polygon.push_back(corner);
+		}
+
+		return polygon.size() >= 3;
+	}
+
+	// rest of a line without surrounding white space
+	std::string parseName(const char* p, const char* end)
+	{
+		p = skipSpace(p, end);
+		while (end > p && isSpace(end[-1]))
+			end--;
+		return std::string(p, end);
+	}
+
+	inline bool isKeyword(const char* p, size_t length, const char* keyword, size_t keywordLength)
+	{
+		return length > keywordLength && std::memcmp(p, keyword, keywordLength) == 0 && isSpace(p[keywordLength]);
+	}
+
+	void parseChunk(Chunk& chunk)
+	{
+		std::vector<Corner> polygon;
+		const char* p = chunk.begin;
+
+		while (p < chunk.end)
+		{
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+			if (lineEnd == nullptr)
+				lineEnd = chunk.end;
+
+			p = skipSpace(p, lineEnd);
+			size_t length = lineEnd - p;
+
+			if (length >= 2 && p[0] == 'v' && isSpace(p[1]))
+			{
+				// vertex position
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				p = parseFloat(p + 2, lineEnd, x);
+				p = parseFloat(p, lineEnd, y);
+				parseFloat(p, lineEnd, z);
+
+				chunk.positions.push_back(x);
+				chunk.positions.push_back(y);
+				chunk.positions.push_back(z);
+			}
+			else if (length >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2]))
+			{
+				// texture coordinate (w is ignored)
+				float u = 0.0f, v = 0.0f;
+				p = parseFloat(p + 3, lineEnd, u);
+				parseFloat(p, lineEnd, v);
+
+				chunk.texCoords.push_back(u);
+				chunk.texCoords.push_back(v);
+			}
+			else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
+			{
+				// vertex normal
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				p = parseFloat(p + 3, lineEnd, x);
+				p = parseFloat(p, lineEnd, y);
+				parseFloat(p, lineEnd, z);
+
+				chunk.normals.push_back(x);
+				chunk.normals.push_back(y);
+				chunk.normals.push_back(z);
+			}
+			else if (length >= 2 && p[0] == 'f' && isSpace(p[1]))
+			{
+				if (!parseFace(p + 2, lineEnd, chunk, polygon))
+				{
+					chunk.isValid = false;
+					return;
+				}
+
+				// triangulate polygon as a fan
+				for (size_t i = 1; i + 1 < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i]);
+					chunk.corners.push_back(polygon[i + 1]);
+				}
+			}
+			else if (isKeyword(p, length, "usemtl", 6))
+			{
+				// material of the following faces
+				chunk.materials.push_back({ chunk.corners.size(), parseName(p + 7, lineEnd) });
+			}
+			else if (isKeyword(p, length, "mtllib", 6))
+			{
+				chunk.libraries.push_back(parseName(p + 7, lineEnd));
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+
+	inline uint32_t hashCorner(const Corner& corner)
+	{
+		return (static_cast<uint32_t>(corner.v) * 73856093u)
+			^ (static_cast<uint32_t>(corner.vt) * 19349663u)
+			^ (static_cast<uint32_t>(corner.vn) * 83492791u);
+	}
+
+	// read the materials of an .mtl library, appending to the list
+	void loadMaterialLibrary(const std::string& filename, std::vector<MaterialData>& materials)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			std::cerr << "Unable to open material library: " << filename << std::endl;
+			return;
+		}
+
+		std::string line, keyword, rest;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			keyword.clear();
+			stream >> keyword;
+
+			if (keyword == "newmtl")
+			{
+				MaterialData material;
+				std::getline(stream, rest);
+				material.name = parseName(rest.c_str(), rest.c_str() + rest.size());
+				materials.push_back(material);
+			}
+			else if (materials.empty())
+			{
+				// parameters before the first newmtl have no material
+				continue;
+			}
+			else if (keyword == "Ka")
+			{
+				MaterialData& material = materials.back();
+				stream >> material.ambient[0] >> material.ambient[1] >> material.ambient[2];
+			}
+			else if (keyword == "Kd")
+			{
+				MaterialData& material = materials.back();
+				stream >> material.diffuse[0] >> material.diffuse[1] >> material.diffuse[2];
+			}
+			else if (keyword == "Ks")
+			{
+				MaterialData& material = materials.back();
+				stream >> material.specular[0] >> material.specular[1] >> material.specular[2];
+			}
+			else if (keyword == "Ns")
+			{
+				stream >> materials.back().shininess;
+			}
+			else if (keyword == "map_Kd")
+			{
+				std::getline(stream, rest);
+				materials.back().diffuseMap = parseName(rest.c_str(), rest.c_str() + rest.size());
+			}
+		}
+	}
+
+	// area weighted smooth normals shared by all vertices at the same OBJ position
+	void generateNormals(MeshData& mesh, const std::vector<Corner>& vertices, size_t numOfPositions)
+	{
+		std::vector<float> accumulated(numOfPositions * 3, 0.0f);
+
+		for (const SubmeshData& submesh : mesh.submeshes)
+		{
+			const unsigned int* indices = &mesh.indices[submesh.firstIndex];
+			const size_t base = submesh.firstVertex;
+
+			for (size_t i = 0; i < submesh.numOfIndices; i += 3)
+			{
+				const float* p0 = &mesh.positions[(base + indices[i]) * 3];
+				const float* p1 = &mesh.positions[(base + indices[i + 1]) * 3];
+				const float* p2 = &mesh.positions[(base + indices[i + 2]) * 3];
+
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+
+				for (int k = 0; k < 3; k++)
+				{
+					float* sum = &accumulated[vertices[base + indices[i + k]].v * 3];
+					sum[0] += n[0];
+					sum[1] += n[1];
+					sum[2] += n[2];
+				}
+			}
+		}
+
+		mesh.normals.resize(mesh.positions.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const float* sum = &accumulated[vertices[i].v * 3];
+			float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+
+			mesh.normals[i * 3] = sum[0] * scale;
+			mesh.normals[i * 3 + 1] = sum[1] * scale;
+			mesh.normals[i * 3 + 2] = sum[2] * scale;
+		}
+	}
+
+	// split text into line aligned chunks, a few per thread for load balancing
+	void splitChunks(const char* text, const char* textEnd, std::vector<Chunk>& chunks)
+	{
+		size_t size = textEnd - text;
+		size_t numOfThreads = ThreadPool::shared().size() + 1;
+		size_t numOfChunks = std::max<size_t>(1, std::min(size / MIN_CHUNK_SIZE, numOfThreads * 4));
+
+		chunks.assign(numOfChunks, Chunk());
+		const char* chunkBegin = text;
+		for (size_t i = 0; i < numOfChunks; i++)
+		{
+			const char* chunkEnd = textEnd;
+			if (i + 1 < numOfChunks)
+			{
+				// move split point to the start of the next line
+				chunkEnd = std::max(chunkBegin, text + size * (i + 1) / numOfChunks);
+				const char* newline = static_cast<const char*>(std::memchr(chunkEnd, '\n', textEnd - chunkEnd));
+				chunkEnd = newline != nullptr ? newline + 1 : textEnd;
+			}
+
+			chunks[i].begin = chunkBegin;
+			chunks[i].end = chunkEnd;
+			chunkBegin = chunkEnd;
+		}
+	}
+
+	// element counts of a chunk for the scanning pass
+	void countChunk(const Chunk& chunk, ObjStreamInfo& counts)
+	{
+		const char* p = chunk.begin;
+		while (p < chunk.end)
+		{
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+			if (lineEnd == nullptr)
+				lineEnd = chunk.end;
+
+			p = skipSpace(p, lineEnd);
+			size_t length = lineEnd - p;
+
+			if (length >= 2 && p[0] == 'v' && isSpace(p[1]))
+			{
+				counts.numOfPositions++;
+			}
+			else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
+			{
+				counts.numOfNormals++;
+			}
+			else if (length >= 2 && p[0] == 'f' && isSpace(p[1]))
+			{
+				// a fan of corners - 2 triangles
+				size_t numOfCorners = 0;
+				for (const char* q = p + 1; q < lineEnd; q++)
+					numOfCorners += isSpace(q[-1]) && !isSpace(q[0]);
+				counts.numOfTriangles += numOfCorners >= 3 ? numOfCorners - 2 : 0;
+			}
+
+			p = lineEnd + 1;
+		}
+	}
+
+	// reads a file in line aligned windows of at most a fixed size
+	class WindowReader
+	{
+	public:
+		WindowReader(const char* filename, size_t windowBytes)
+			: mFile(filename, std::ios::binary), mBuffer(windowBytes)
+		{}
+
+		bool isOpen() const { return mFile.is_open(); }
+		// true if reading stopped at a line longer than the window
+		bool isLineTooLong() const { return mIsLineTooLong; }
+
+		// next window of complete lines, false at the end of the file
+		bool next(const char*& begin, const char*& end)
+		{
+			// carry the incomplete last line of the previous window over
+			std::memmove(mBuffer.data(), mBuffer.data() + mEnd, mFilled - mEnd);
+			mFilled -= mEnd;
+			mEnd = 0;
+
+			mFile.read(mBuffer.data() + mFilled, static_cast<std::streamsize>(mBuffer.size() - mFilled));
+			mFilled += static_cast<size_t>(mFile.gcount());
+			if (mFilled == 0)
+				return false;
+
+			// cut after the last complete line until the file ends
+			mEnd = mFilled;
+			if (!mFile.eof())
+			{
+				while (mEnd > 0 && mBuffer[mEnd - 1] != '\n')
+					mEnd--;
+				if (mEnd == 0)
+				{
+					mIsLineTooLong = true;
+					return false;
+				}
+			}
+
+			begin = mBuffer.data();
+			end = begin + mEnd;
+			return true;
+		}
+
+	private:
+		std::ifstream mFile;
+		std::vector<char> mBuffer;
+		size_t mFilled = 0;		// bytes in the buffer
+		size_t mEnd = 0;		// end of the current window
+		bool mIsLineTooLong = false;
+	};
+}
+
+bool loadObj(const char* filename, MeshData& mesh)
+{
+	MappedFile file;
+	if (!file.open(filename))
+		return false;
+
+	mesh.submeshes.clear();
+	mesh.materials.clear();
+
+	const char* text = reinterpret_cast<const char*>(file.data());
+	std::vector<Chunk> chunks;
+	splitChunks(text, text + file.size(), chunks);
+	size_t numOfChunks = chunks.size();
+
+	// parse chunks in parallel
+	parallelFor(0, chunks.size(), 1, [&chunks](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+			parseChunk(chunks[i]);
+	});
+
+	// offsets of each chunk's elements in the merged arrays
+	std::vector<size_t> positionBase(numOfChunks), texCoordBase(numOfChunks);
+	std::vector<size_t> normalBase(numOfChunks), cornerBase(numOfChunks);
+	size_t numOfPositions = 0, numOfTexCoords = 0, numOfNormals = 0, numOfCorners = 0;
+	std::vector<MaterialSwitch> materialSwitches;
+	std::vector<std::string> libraries;
+
+	for (size_t i = 0; i < numOfChunks; i++)
+	{
+		if (!chunks[i].isValid)
+		{
+			std::cerr << "Malformed face in: " << filename << std::endl;
+			return false;
+		}
+
+		positionBase[i] = numOfPositions;
+		texCoordBase[i] = numOfTexCoords;
+		normalBase[i] = numOfNormals;
+		cornerBase[i] = numOfCorners;
+
+		numOfPositions += chunks[i].positions.size() / 3;
+		numOfTexCoords += chunks[i].texCoords.size() / 2;
+		numOfNormals += chunks[i].normals.size() / 3;
+		numOfCorners += chunks[i].corners.size();
+
+		// material statements in file order
+		for (MaterialSwitch& materialSwitch : chunks[i].materials)
+			materialSwitches.push_back({ cornerBase[i] + materialSwitch.corner, std::move(materialSwitch.name) });
+		for (std::string& library : chunks[i].libraries)
+			libraries.push_back(std::move(library));
+	}
+
+	if (numOfCorners == 0)
+	{
+		std::cerr << "No faces in: " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<float> positions(numOfPositions * 3);
+	std::vector<float> texCoords(numOfTexCoords * 2);
+	std::vector<float> normals(numOfNormals * 3);
+	std::vector<Corner> corners(numOfCorners);
+	bool hasTexCoords = false, hasNormals = numOfCorners > 0;
+	bool isValid = true;
+	std::mutex flagsMutex;
+
+	// concatenate attributes and turn chunk relative indices into absolute ones
+	parallelFor(0, chunks.size(), 1, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			Chunk& chunk = chunks[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[i] * 3);
+			std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), texCoords.begin() + texCoordBase[i] * 2);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[i] * 3);
+
+			bool chunkHasTexCoords = false, chunkHasNormals = true, chunkIsValid = true;
+			Corner* output = corners.data() + cornerBase[i];
+
+			for (Corner corner : chunk.corners)
+			{
+				if (corner.relative & RELATIVE_V)
+					corner.v += static_cast<int>(positionBase[i]);
+				if (corner.relative & RELATIVE_VT)
+					corner.vt += static_cast<int>(texCoordBase[i]);
+				if (corner.relative & RELATIVE_VN)
+					corner.vn += static_cast<int>(normalBase[i]);
+
+				chunkIsValid = chunkIsValid && corner.v >= 0 && static_cast<size_t>(corner.v) < numOfPositions
+					&& corner.vt < static_cast<int>(numOfTexCoords) && corner.vn < static_cast<int>(numOfNormals)
+					&& (corner.vt >= 0 || !(corner.relative & RELATIVE_VT))
+					&& (corner.vn >= 0 || !(corner.relative & RELATIVE_VN));
+				chunkHasTexCoords = chunkHasTexCoords || corner.vt >= 0;
+				chunkHasNormals = chunkHasNormals && corner.vn >= 0;
+
+				corner.relative = 0;
+				*output++ = corner;
+			}
+
+			// release chunk memory early
+			chunk = Chunk();
+
+			if (!chunkIsValid || chunkHasTexCoords || !chunkHasNormals)
+			{
+				std::lock_guard<std::mutex> lock(flagsMutex);
+				isValid = isValid && chunkIsValid;
+				hasTexCoords = hasTexCoords || chunkHasTexCoords;
+				hasNormals = hasNormals && chunkHasNormals;
+			}
+		}
+	});
+
+	if (!isValid)
+	{
+		std::cerr << "Face index out of range in: " << filename << std::endl;
+		return false;
+	}
+
+	// material libraries are looked up next to the OBJ file
+	std::string directory(filename);
+	directory.erase(directory.find_last_of("/\\") + 1);
+	for (const std::string& library : libraries)
+		loadMaterialLibrary(directory + library, mesh.materials);
+
+	// faces without (or with an unknown) material get a default one
+	std::unordered_map<std::string, unsigned int> materialIds;
+	for (size_t i = 0; i < mesh.materials.size(); i++)
+		materialIds.emplace(mesh.materials[i].name, static_cast<unsigned int>(i));
+
+	auto materialIndex = [&mesh, &materialIds](const std::string& name)
+	{
+		auto found = materialIds.find(name);
+		if (found != materialIds.end())
+			return found->second;
+
+		MaterialData material;
+		material.name = name.empty() ? "default" : name;
+		mesh.materials.push_back(material);
+		return materialIds[name] = static_cast<unsigned int>(mesh.materials.size() - 1);
+	};
+
+	// material of every triangle
+	size_t numOfTriangles = numOfCorners / 3;
+	std::vector<unsigned int> triangleMaterials(numOfTriangles);
+	std::string materialName;
+	size_t triangle = 0;
+
+	for (size_t i = 0; i <= materialSwitches.size(); i++)
+	{
+		size_t switchTriangle = i < materialSwitches.size() ? materialSwitches[i].corner / 3 : numOfTriangles;
+		if (switchTriangle > triangle)
+		{
+			std::fill(triangleMaterials.begin() + triangle, triangleMaterials.begin() + switchTriangle,
+				materialIndex(materialName));
+			triangle = switchTriangle;
+		}
+		if (i < materialSwitches.size())
+			materialName = materialSwitches[i].name;
+	}
+
+	// group triangles by material, keeping file order within each group
+	size_t numOfMaterials = mesh.materials.size();
+	std::vector<size_t> materialStart(numOfMaterials + 1, 0);
+	for (unsigned int material : triangleMaterials)
+		materialStart[material + 1]++;
+	for (size_t i = 0; i < numOfMaterials; i++)
+		materialStart[i + 1] += materialStart[i];
+
+	// the common single material file keeps its triangles in place
+	std::vector<uint32_t> order;
+	if (numOfTriangles > 0 && materialStart[triangleMaterials[0] + 1] - materialStart[triangleMaterials[0]] < numOfTriangles)
+	{
+		order.resize(numOfTriangles);
+		std::vector<size_t> next(materialStart.begin(), materialStart.end() - 1);
+		for (size_t i = 0; i < numOfTriangles; i++)
+			order[next[triangleMaterials[i]]++] = static_cast<uint32_t>(i);
+	}
+	std::vector<unsigned int>().swap(triangleMaterials);
+
+	// share vertices with identical position/uv/normal indices within a material,
+	// so every submesh owns a contiguous vertex range
+	size_t capacity = 16;
+	while (capacity < numOfCorners * 2)
+		capacity *= 2;
+
+	const uint32_t emptySlot = 0xffffffffu;
+	std::vector<uint32_t> table(capacity, emptySlot);
+	std::vector<Corner> vertices;
+	vertices.reserve(std::min(numOfCorners, numOfPositions * 2));
+
+	mesh.indices.resize(numOfCorners);
+	size_t numOfIndices = 0;
+
+	for (size_t m = 0; m < numOfMaterials; m++)
+	{
+		if (materialStart[m] == materialStart[m + 1])
+			continue;
+
+		SubmeshData submesh;
+		submesh.firstIndex = numOfIndices;
+		submesh.firstVertex = vertices.size();
+		submesh.materialIndex = static_cast<unsigned int>(m);
+
+		for (size_t i = materialStart[m]; i < materialStart[m + 1]; i++)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				const Corner& corner = corners[(order.empty() ? i : order[i]) * 3 + k];
+				size_t slot = hashCorner(corner) & (capacity - 1);
+
+				// vertices of earlier submeshes are never matched
+				while (table[slot] != emptySlot && !(table[slot] >= submesh.firstVertex && vertices[table[slot]] == corner))
+					slot = (slot + 1) & (capacity - 1);
+
+				if (table[slot] == emptySlot)
+				{
+					table[slot] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(corner);
+				}
+
+				mesh.indices[numOfIndices++] = table[slot] - static_cast<uint32_t>(submesh.firstVertex);
+			}
+		}
+
+		submesh.numOfIndices = numOfIndices - submesh.firstIndex;
+		submesh.numOfVertices = vertices.size() - submesh.firstVertex;
+		mesh.submeshes.push_back(submesh);
+	}
+
+	std::vector<uint32_t>().swap(table);
+	std::vector<uint32_t>().swap(order);
+	std::vector<Corner>().swap(corners);
+
+	// gather vertex attributes
+	mesh.positions.resize(vertices.size() * 3);
+	mesh.normals.resize(hasNormals ? vertices.size() * 3 : 0);
+	mesh.texCoords.resize(hasTexCoords ? vertices.size() * 2 : 0);
+
+	parallelFor(0, vertices.size(), 1 << 16, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			const Corner& vertex = vertices[i];
+			std::copy_n(&positions[vertex.v * 3], 3, &mesh.positions[i * 3]);
+
+			if (hasNormals)
+				std::copy_n(&normals[vertex.vn * 3], 3, &mesh.normals[i * 3]);
+
+			if (hasTexCoords)
+			{
+				mesh.texCoords[i * 2] = vertex.vt >= 0 ? texCoords[vertex.vt * 2] : 0.0f;
+				mesh.texCoords[i * 2 + 1] = vertex.vt >= 0 ? texCoords[vertex.vt * 2 + 1] : 0.0f;
+			}
+		}
+	});
+
+	if (!hasNormals)
+		generateNormals(mesh, vertices, numOfPositions);
+
+	return true;
+}
+
+bool scanObj(const char* filename, size_t windowBytes, ObjStreamInfo& info)
+{
+	WindowReader reader(filename, windowBytes);
+	if (!reader.isOpen())
+		return false;
+
+	info = ObjStreamInfo();
+	const char* begin;
+	const char* end;
+	std::vector<Chunk> chunks;
+	std::vector<ObjStreamInfo> counts;
+
+	while (reader.next(begin, end))
+	{
+		splitChunks(begin, end, chunks);
+		counts.assign(chunks.size(), ObjStreamInfo());
+
+		parallelFor(0, chunks.size(), 1, [&chunks, &counts](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				countChunk(chunks[i], counts[i]);
+		});
+
+		for (const ObjStreamInfo& count : counts)
+		{
+			info.numOfPositions += count.numOfPositions;
+			info.numOfNormals += count.numOfNormals;
+			info.numOfTriangles += count.numOfTriangles;
+		}
+		info.fileSize += end - begin;
+	}
+
+	if (reader.isLineTooLong())
+	{
+		std::cerr << "Line longer than the streaming window in: " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool streamObj(const char* filename, size_t windowBytes, ObjStreamSink& sink, ObjStreamInfo& info)
+{
+	WindowReader reader(filename, windowBytes);
+	if (!reader.isOpen())
+		return false;
+
+	// elements handed to the sink so far
+	size_t numOfPositions = 0, numOfNormals = 0, numOfTriangles = 0;
+	info.normalsMatchPositions = info.numOfNormals == info.numOfPositions;
+
+	const char* begin;
+	const char* end;
+	std::vector<Chunk> chunks;
+	std::vector<unsigned int> indices;
+
+	while (reader.next(begin, end))
+	{
+		splitChunks(begin, end, chunks);
+
+		parallelFor(0, chunks.size(), 1, [&chunks](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				parseChunk(chunks[i]);
+		});
+
+		// flush in file order, resolving relative indices against everything before the chunk
+		for (Chunk& chunk : chunks)
+		{
+			if (!chunk.isValid)
+			{
+				std::cerr << "Malformed face in: " << filename << std::endl;
+				return false;
+			}
+
+			indices.resize(chunk.corners.size());
+			for (size_t i = 0; i < chunk.corners.size(); i++)
+			{
+				Corner corner = chunk.corners[i];
+				if (corner.relative & RELATIVE_V)
+					corner.v += static_cast<int>(numOfPositions);
+				if (corner.relative & RELATIVE_VN)
+					corner.vn += static_cast<int>(numOfNormals);
+
+				if (corner.v < 0 || static_cast<size_t>(corner.v) >= info.numOfPositions)
+				{
+					std::cerr << "Face index out of range in: " << filename << std::endl;
+					return false;
+				}
+
+				// normals can only be used per position if every corner pairs them up
+				info.normalsMatchPositions = info.normalsMatchPositions && corner.vn == corner.v;
+				indices[i] = static_cast<unsigned int>(corner.v);
+			}
+
+			size_t chunkPositions = chunk.positions.size() / 3;
+			size_t chunkNormals = chunk.normals.size() / 3;
+			size_t chunkTriangles = indices.size() / 3;
+
+			// the scanning pass sized the sink's storage
+			if (numOfPositions + chunkPositions > info.numOfPositions || numOfNormals + chunkNormals > info.numOfNormals
+				|| numOfTriangles + chunkTriangles > info.numOfTriangles)
+			{
+				std::cerr << "File changed while streaming: " << filename << std::endl;
+				return false;
+			}
+
+			if (chunkPositions > 0)
+				sink.addPositions(chunk.positions.data(), numOfPositions, chunkPositions);
+			if (chunkNormals > 0)
+				sink.addNormals(chunk.normals.data(), numOfNormals, chunkNormals);
+			if (chunkTriangles > 0)
+				sink.addTriangles(indices.data(), numOfTriangles, chunkTriangles);
+
+			numOfPositions += chunkPositions;
+			numOfNormals += chunkNormals;
+			numOfTriangles += chunkTriangles;
+
+			// release chunk memory early
+			chunk = Chunk();
+		}
+	}
+
+	if (reader.isLineTooLong())
+	{
+		std::cerr << "Line longer than the streaming window in: " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
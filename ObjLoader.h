@@ -0,0 +1,62 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "MeshData.h"
+
+#include <cstdint>
+
+/*****************************************************************
+ * native Wavefront OBJ loader
+ *
+ * the file is memory mapped and split into line aligned chunks
+ * that are parsed in parallel, then merged into one vertex array
+ * with identical position/uv/normal triplets shared; faces are
+ * grouped into one submesh per usemtl material
+ *****************************************************************/
+
+// load all faces of an OBJ file as a triangle list
+// missing normals are generated by smoothing across faces
+// returns false if the file cannot be read or is malformed
+bool loadObj(const char* filename, MeshData& mesh);
+
+/*****************************************************************
+ * streaming import of OBJ files too large to hold in memory
+ *
+ * the file is read in line aligned windows, each parsed in
+ * parallel and handed to a sink in file order; vertices are the
+ * OBJ positions as they are (no sharing of uv/normal triplets),
+ * texture coordinates and materials are ignored; memory use is a
+ * small multiple of the window size (roughly three times)
+ *****************************************************************/
+
+// totals of an OBJ file, found by scanObj before streaming
+struct ObjStreamInfo
+{
+	uint64_t fileSize = 0;
+	size_t numOfPositions = 0;
+	size_t numOfNormals = 0;
+	size_t numOfTriangles = 0;
+	// set by streamObj: every corner uses the normal with its position's index
+	bool normalsMatchPositions = false;
+};
+
+// receives the elements of one window at a time; first is the index of
+// the first element in the whole file
+class ObjStreamSink
+{
+public:
+	virtual ~ObjStreamSink() {}
+	virtual void addPositions(const float* positions, size_t first, size_t count) = 0;
+	virtual void addNormals(const float* normals, size_t first, size_t count) = 0;
+	// triangles as 0-based position indices
+	virtual void addTriangles(const unsigned int* indices, size_t first, size_t count) = 0;
+};
+
+// count the elements of an OBJ file, reading windowBytes at a time
+bool scanObj(const char* filename, size_t windowBytes, ObjStreamInfo& info);
+
+// stream an OBJ file scanned into info through sink
+// returns false if the file cannot be read, is malformed or changed since the scan
+bool streamObj(const char* filename, size_t windowBytes, ObjStreamSink& sink, ObjStreamInfo& info);
+
+#endif
@@ -0,0 +1,176 @@
+#include "RoomGeometry.h"
+
+std::vector<float> roomTexturedVertices()
+{
+	// positions, normals and texture coordinates
+	return {
+		/* ---------------------------------------------------
+		NOTE TO SELF: MAKE SURE THE ORDER MATCHES THE STRUCT
+		--------------------------------------------------- */ 
+		// floor  -------------------------------------------
+		-1.0f, 0.0f, 1.0f,	// vertex 0: position
+		0.0f, 1.0f, 0.0f,	// vertex 0: normal
+		0.0f, 0.0f,			// vertex 0: texture coordinate 
+
+		1.0f, 0.0f, 1.0f,	// vertex 1: position
+		0.0f, 1.0f, 0.0f,	// vertex 1: normal
+		4.0f, 0.0f,			// vertex 1: texture coordinate 
+
+		-1.0f, 0.0f, -1.0f,	// vertex 2: position 
+		0.0f, 1.0f, 0.0f,	// vertex 2: normal
+		0.0f, 4.0f,			// vertex 2: texture coordinate 
+
+		1.0f, 0.0f, -1.0f,	// vertex 3: position
+		0.0f, 1.0f, 0.0f,	// vertex 3: normal
+		4.0f, 4.0f,			// vertex 3: texture coordinate 
+		// painting -----------------------------------------
+		-0.25f, 0.25f, -0.99f,	// vertex 4: position 
+		0.0f, 1.0f, 0.0f,		// vertex 4: normal
+		0.0f, 0.0f,				// vertex 4: texture coordinate 
+
+		0.25f, 0.25f, -0.99f,	// vertex 5: position 
+		0.0f, 1.0f, 0.0f,		// vertex 5: normal
+		1.0f, 0.0f,				// vertex 5: texture coordinate 
+
+		-0.25f, 0.75f, -0.99f,	// vertex 6: position
+		0.0f, 1.0f, 0.0f,		// vertex 6: normal
+		0.0f, 1.0f,				// vertex 6: texture coordinate 
+
+		0.25f, 0.75f, -0.99f,	// vertex 7: position
+		0.0f, 1.0f, 0.0f,		// vertex 7: normal
+		1.0f, 1.0f,				// vertex 7: texture coordinate 
+	};
+}
+
+std::vector<float> roomWallVertices()
+{
+	// positions, normals, texture coordinates and tangents
+	return {
+		// close wall
+		-1.0f, 0.0f, 1.0f,	// vertex 0: position
+		0.0f, 1.0f, 0.0f,	// vertex 0: normal
+		3.0f, 0.0f,			// vertex 0: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 0: tangent
+
+		1.0f, 0.0f, 1.0f,	// vertex 1: position 
+		0.0f, 1.0f, 0.0f,	// vertex 1: normal
+		0.0f, 0.0f,			// vertex 1: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 1: tangent
+
+		-1.0f, 1.0f, 1.0f,	// vertex 2: position 
+		0.0f, 1.0f, 0.0f,	// vertex 2: normal
+		3.0f, 3.0f,			// vertex 2: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 2: tangent
+
+		1.0f, 1.0f, 1.0f,	// vertex 3: position 
+		0.0f, 1.0f, 0.0f,	// vertex 3: normal
+		0.0f, 3.0f,			// vertex 3: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 3: tangent
+		// left wall
+		-1.0f, 0.0f, 1.0f,	// vertex 4: position 
+		0.0f, 1.0f, 0.0f,	// vertex 4: normal
+		0.0f, 0.0f,			// vertex 4: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 4: tangent
+
+		-1.0f, 0.0f, -1.0f,	// vertex 5: position 
+		0.0f, 1.0f, 0.0f,	// vertex 5: normal
+		3.0f, 0.0f,			// vertex 5: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 5: tangent
+
+		-1.0f, 1.0f, 1.0f,	// vertex 6: position
+		0.0f, 1.0f, 0.0f,	// vertex 6: normal
+		0.0f, 3.0f,			// vertex 6: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 6: tangent
+
+		-1.0f, 1.0f, -1.0f,	// vertex 7: position
+		0.0f, 1.0f, 0.0f,	// vertex 7: normal
+		3.0f, 3.0f,			// vertex 7: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 7: tangent
+		// close wall
+		-1.0f, 0.0f, -1.0f,	// vertex 8: position 
+		0.0f, 1.0f, 0.0f,	// vertex 8: normal
+		0.0f, 0.0f,			// vertex 8: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 8: tangent
+
+		1.0f, 0.0f, -1.0f,	// vertex 9: position 
+		0.0f, 1.0f, 0.0f,	// vertex 9: normal
+		3.0f, 0.0f,			// vertex 9: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 9: tangent
+
+		-1.0f, 1.0f, -1.0f,	// vertex 10: position
+		0.0f, 1.0f, 0.0f,	// vertex 10: normal
+		0.0f, 3.0f,			// vertex 10: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 10: tangent
+
+		1.0f, 1.0f, -1.0f,	// vertex 11: position
+		0.0f, 1.0f, 0.0f,	// vertex 11: normal
+		3.0f, 3.0f,			// vertex 11: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 11: tangent
+		// right wall
+		1.0f, 0.0f, -1.0f,	// vertex 12: position 
+		0.0f, 1.0f, 0.0f,	// vertex 12: normal
+		0.0f, 0.0f,			// vertex 12: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 12: tangent
+
+		1.0f, 0.0f, 1.0f,	// vertex 13: position 
+		0.0f, 1.0f, 0.0f,	// vertex 13: normal
+		3.0f, 0.0f,			// vertex 13: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 13: tangent
+
+		1.0f, 1.0f, -1.0f,	// vertex 14: position
+		0.0f, 1.0f, 0.0f,	// vertex 14: normal
+		0.0f, 3.0f,			// vertex 14: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 14: tangent
+
+		1.0f, 1.0f, 1.0f,	// vertex 15: position
+		0.0f, 1.0f, 0.0f,	// vertex 15: normal
+		3.0f, 3.0f,			// vertex 15: texture coordinate
+		1.0f, 0.0f, 0.0f, 1.0f,	// vertex 15: tangent
+	};
+}
+
+std::vector<RoomSurface> roomSurfaces()
+{
+	// the vertex normals only suit the floor, lightmap surfaces face into the room
+	const int TEXTURED_STRIDE = 8;		// floats of a VertexNormTex
+	const int WALL_STRIDE = 12;			// floats of a VertexNormTanTex
+	const glm::vec3 GENERAL_KD = glm::vec3(1.0f, 0.83f, 0.83f);	// Kd of the materials in init()
+	const glm::vec3 WALL_KD = glm::vec3(0.2f, 0.7f, 1.0f);
+
+	struct SurfaceSource
+	{
+		const std::vector<float>* vertices;
+		int stride;
+		int first;						// first vertex of the strip
+		glm::vec3 normal;
+		glm::vec3 kd;
+		const char* image;
+	};
+
+	std::vector<float> texturedVertices = roomTexturedVertices();
+	std::vector<float> wallVertices = roomWallVertices();
+	const SurfaceSource sources[] = {
+		{ &texturedVertices, TEXTURED_STRIDE, 0, glm::vec3(0.0f, 1.0f, 0.0f), GENERAL_KD, "check.bmp" },		// floor
+		{ &texturedVertices, TEXTURED_STRIDE, 4, glm::vec3(0.0f, 0.0f, 1.0f), GENERAL_KD, "smile.bmp" },		// painting
+		{ &wallVertices, WALL_STRIDE, 0, glm::vec3(0.0f, 0.0f, -1.0f), WALL_KD, "Fieldstone.bmp" },			// close wall
+		{ &wallVertices, WALL_STRIDE, 4, glm::vec3(1.0f, 0.0f, 0.0f), WALL_KD, "Fieldstone.bmp" },			// left wall
+		{ &wallVertices, WALL_STRIDE, 8, glm::vec3(0.0f, 0.0f, 1.0f), WALL_KD, "Fieldstone.bmp" },			// far wall
+		{ &wallVertices, WALL_STRIDE, 12, glm::vec3(-1.0f, 0.0f, 0.0f), WALL_KD, "Fieldstone.bmp" },		// right wall
+	};
+
+	std::vector<RoomSurface> surfaces;
+	for (const SurfaceSource& source : sources)
+	{
+		RoomSurface surface;
+		for (int corner = 0; corner < 4; corner++)
+		{
+			const float* position = &(*source.vertices)[(source.first + corner) * source.stride];
+			surface.quad.corners[corner] = glm::vec3(position[0], position[1], position[2]);
+		}
+		surface.quad.normal = source.normal;
+		surface.quad.albedo = source.kd;
+		surface.image = source.image;
+		surfaces.push_back(surface);
+	}
+	return surfaces;
+}
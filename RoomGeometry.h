@@ -0,0 +1,35 @@
+#ifndef ROOM_GEOMETRY_H
+#define ROOM_GEOMETRY_H
+
+#include "Lightmap.h"
+
+#include <vector>
+
+/*****************************************************************
+ * the room's static geometry, shared by the renderer and the
+ * lightmap baker: the floor and painting (VertexNormTex) and the
+ * four walls (VertexNormTanTex) as triangle strips of four
+ * vertices, and the same quads as lightmap surfaces in drawing
+ * order (floor, painting, close, left, far and right wall)
+ *****************************************************************/
+
+// scene light as init() places it, the light the lightmap is baked for
+const glm::vec3 ROOM_LIGHT_POSITION = glm::vec3(0.0f, 1.0f, 0.0f);
+const glm::vec3 ROOM_LIGHT_DIFFUSE = glm::vec3(1.0f);
+const glm::vec3 ROOM_LIGHT_ATTENUATION = glm::vec3(1.0f, 0.0f, 0.0f);	// constant, linear, quadratic
+
+// surface of the room to bake, with the image its colour comes from
+struct RoomSurface
+{
+	LightmapSurface quad;				// albedo: Kd of the surface's material
+	const char* image;					// file in the images directory
+};
+
+// interleaved vertices of the floor and painting, and of the walls
+std::vector<float> roomTexturedVertices();
+std::vector<float> roomWallVertices();
+
+// the quads of both vertex arrays, in drawing order
+std::vector<RoomSurface> roomSurfaces();
+
+#endif
@@ -0,0 +1,40 @@
+#include "SamplerCache.h"
+
+GLuint SamplerCache::get(const SamplerState& state)
+{
+	auto found = mSamplers.find(state);
+	if (found != mSamplers.end())
+		return found->second;
+
+	GLuint sampler;
+	glGenSamplers(1, &sampler);
+	glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, state.magFilter);
+	glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, state.minFilter);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, state.wrapS);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, state.wrapT);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, state.wrapT);
+	glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, state.compareMode);
+	glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	mSamplers.emplace(state, sampler);
+	return sampler;
+}
+
+void SamplerCache::clear()
+{
+	for (auto& entry : mSamplers)
+		glDeleteSamplers(1, &entry.second);
+	mSamplers.clear();
+}
+
+void SamplerCache::unbind(GLuint firstUnit, GLuint numOfUnits)
+{
+	for (GLuint unit = firstUnit; unit < firstUnit + numOfUnits; unit++)
+		glBindSampler(unit, 0);
+}
+
+SamplerCache& SamplerCache::shared()
+{
+	static SamplerCache cache;
+	return cache;
+}
@@ -0,0 +1,60 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include "utilities.h"
+
+#include <map>
+#include <tuple>
+
+// filtering and addressing of a texture unit
+struct SamplerState
+{
+	GLenum magFilter = GL_LINEAR;
+	GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+	GLenum wrapS = GL_REPEAT;
+	GLenum wrapT = GL_REPEAT;		// also used for R (cube maps)
+	GLenum compareMode = GL_NONE;	// GL_COMPARE_REF_TO_TEXTURE for shadow samplers (less or equal)
+
+	bool operator<(const SamplerState& other) const
+	{
+		return std::tie(magFilter, minFilter, wrapS, wrapT, compareMode)
+			< std::tie(other.magFilter, other.minFilter, other.wrapS, other.wrapT, other.compareMode);
+	}
+};
+
+/*****************************************************************
+ * GL sampler objects shared by every texture with the same state
+ *
+ * textures keep their filtering and wrapping in a sampler bound
+ * next to them instead of in texture parameters, so changing a
+ * texture's state picks another sampler rather than rebinding and
+ * editing the texture, and the scene needs one sampler per
+ * distinct state however many textures it draws
+ *****************************************************************/
+class SamplerCache
+{
+public:
+	SamplerCache() {}
+
+	SamplerCache(const SamplerCache&) = delete;
+	SamplerCache& operator=(const SamplerCache&) = delete;
+
+	// sampler for a state, created on first use (context thread)
+	GLuint get(const SamplerState& state);
+	// delete the samplers while the context exists (textures must not bind them afterwards)
+	void clear();
+
+	size_t getNumOfSamplers() const { return mSamplers.size(); }
+
+	// leave texture units to their textures' own parameters (before drawing with
+	// code that does not bind samplers, such as the tweak bar)
+	static void unbind(GLuint firstUnit, GLuint numOfUnits);
+
+	// cache used by Texture
+	static SamplerCache& shared();
+
+private:
+	std::map<SamplerState, GLuint> mSamplers;
+};
+
+#endif
@@ -170,6 +170,11 @@ void ShaderProgram::setUniform(const char *name, const glm::vec4& vector)
 	glUniform4fv(getUniformLocation(name), 1, &vector[0]);
 }
 
+void ShaderProgram::setUniform(const char *name, const glm::ivec3& vector)
+{
+	glUniform3iv(getUniformLocation(name), 1, &vector[0]);
+}
+
 void ShaderProgram::setUniform(const char* name, const glm::mat3& matrix)
 {
 	glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &matrix[0][0]);
@@ -24,6 +24,7 @@ public:
 	void setUniform(const char *name, const glm::vec2& vector);
 	void setUniform(const char *name, const glm::vec3& vector);
 	void setUniform(const char *name, const glm::vec4& vector);
+	void setUniform(const char *name, const glm::ivec3& vector);
 	void setUniform(const char* name, const glm::mat3& matrix);
 	void setUniform(const char *name, const glm::mat4& matrix);
 	void setUniform(const char *name, float value);
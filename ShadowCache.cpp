@@ -0,0 +1,314 @@
+#include "ShadowCache.h"
+#include "SamplerCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// the light's static layer no longer matches it
+	bool lightMoved(const Light& a, const Light& b)
+	{
+		if (a.type != b.type)
+			return true;
+		if (a.type != 2 && a.pos != b.pos)
+			return true;
+		if (a.type != 1 && a.dir != b.dir)
+			return true;
+		return a.type == 3 && a.outerAngle != b.outerAngle;
+	}
+
+	// sphere touching the volume of a view and projection matrix
+	bool sphereInView(const glm::mat4& viewProjMatrix, const glm::vec3& center, float radius)
+	{
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+			rows[i] = glm::vec4(viewProjMatrix[0][i], viewProjMatrix[1][i], viewProjMatrix[2][i], viewProjMatrix[3][i]);
+
+		// left, right, bottom, top, near, far
+		for (int i = 0; i < 6; i++)
+		{
+			glm::vec4 plane = i % 2 == 0 ? rows[3] + rows[i / 2] : rows[3] - rows[i / 2];
+			glm::vec3 normal(plane.x, plane.y, plane.z);
+			if (glm::dot(normal, center) + plane.w < -radius * glm::length(normal))
+				return false;
+		}
+		return true;
+	}
+
+	// up vector of a view along a direction
+	glm::vec3 upVector(const glm::vec3& direction)
+	{
+		return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+
+	GLuint createDepthTexture(GLenum target, int size)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(target, texture);
+		if (target == GL_TEXTURE_CUBE_MAP)
+		{
+			for (int face = 0; face < 6; face++)
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+					GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		}
+		else
+			glTexImage2D(target, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+		glBindTexture(target, 0);
+		return texture;
+	}
+}
+
+ShadowCache::ShadowCache()
+{
+}
+
+ShadowCache::~ShadowCache()
+{
+	clear();
+}
+
+void ShadowCache::setSceneBounds(const glm::vec3& center, float radius)
+{
+	mSceneCenter = center;
+	mSceneRadius = radius;
+	mDirectional.isValid = false;
+}
+
+void ShadowCache::update(const Light& light, const ShadowDrawFunction& drawStatic, const ShadowDrawFunction& drawDynamic,
+	const glm::vec3& dynamicCenter, float dynamicRadius, bool dynamicChanged)
+{
+	mNumOfStaticRenders = 0;
+	mNumOfDynamicRenders = 0;
+	if (light.type < 1 || light.type > 3)
+	{
+		mCurrent = nullptr;
+		return;
+	}
+	create();
+
+	ShadowSet& set = light.type == 1 ? mPoint : (light.type == 3 ? mSpot : mDirectional);
+	mCurrent = &set;
+
+	// the other lights' dynamic layers are brought up to date when they are next used
+	if (dynamicChanged)
+		mDynamicVersion++;
+	bool dynamicOutdated = set.dynamicVersion != mDynamicVersion;
+	set.dynamicVersion = mDynamicVersion;
+
+	bool lightChanged = !set.isValid || lightMoved(set.light, light);
+	if (lightChanged)
+	{
+		set.light = light;
+		set.isValid = true;
+		buildViews(set);
+	}
+	if (!lightChanged && !dynamicOutdated)
+		return;
+
+	glEnable(GL_SCISSOR_TEST);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	for (ShadowView& view : set.views)
+	{
+		bool touched = dynamicRadius > 0.0f
+			&& sphereInView(view.projMatrix * view.viewMatrix, dynamicCenter, dynamicRadius);
+		if (lightChanged)
+			renderStatic(view, drawStatic);
+		// faces the dynamic casters left need the static layer back
+		if (lightChanged || touched || view.hasDynamic)
+			renderDynamic(view, drawDynamic, touched);
+	}
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCache::bind(ShaderProgram& shader, int lightIndex) const
+{
+	shader.setUniform("uShadowCube", static_cast<int>(SHADOW_CUBE_UNIT));
+	shader.setUniform("uShadowAtlas", static_cast<int>(SHADOW_ATLAS_UNIT));
+	if (mCurrent == nullptr || lightIndex < 0)
+	{
+		shader.setUniform("uShadowLight", -1);
+		return;
+	}
+
+	// depth comparisons filtered across 2x2 texels
+	SamplerState state;
+	state.magFilter = GL_LINEAR;
+	state.minFilter = GL_LINEAR;
+	state.wrapS = GL_CLAMP_TO_EDGE;
+	state.wrapT = GL_CLAMP_TO_EDGE;
+	state.compareMode = GL_COMPARE_REF_TO_TEXTURE;
+	GLuint sampler = SamplerCache::shared().get(state);
+
+	glActiveTexture(GL_TEXTURE0 + SHADOW_CUBE_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, mCube);
+	glBindSampler(SHADOW_CUBE_UNIT, sampler);
+	glActiveTexture(GL_TEXTURE0 + SHADOW_ATLAS_UNIT);
+	glBindTexture(GL_TEXTURE_2D, mAtlas);
+	glBindSampler(SHADOW_ATLAS_UNIT, sampler);
+
+	shader.setUniform("uShadowLight", lightIndex);
+	shader.setUniform("uShadowDepthRange", glm::vec2(SHADOW_NEAR, SHADOW_FAR));
+
+	// atlas tile: window coordinates of the view scaled into the tile
+	if (mCurrent->light.type != 1)
+	{
+		const ShadowView& view = mCurrent->views[0];
+		float scale = static_cast<float>(view.size) / SHADOW_ATLAS_SIZE;
+		glm::vec2 offset = glm::vec2(static_cast<float>(view.origin.x), static_cast<float>(view.origin.y)) / static_cast<float>(SHADOW_ATLAS_SIZE);
+		glm::mat4 tileMatrix(1.0f);
+		tileMatrix[0][0] = 0.5f * scale;
+		tileMatrix[1][1] = 0.5f * scale;
+		tileMatrix[2][2] = 0.5f;
+		tileMatrix[3] = glm::vec4(offset.x + 0.5f * scale, offset.y + 0.5f * scale, 0.5f, 1.0f);
+		shader.setUniform("uShadowMatrix", tileMatrix * view.projMatrix * view.viewMatrix);
+
+		// half a texel inside, so filtering never reads the neighbouring tile
+		float inset = 0.5f / SHADOW_ATLAS_SIZE;
+		shader.setUniform("uShadowTileRect", glm::vec4(offset.x + inset, offset.y + inset,
+			offset.x + scale - inset, offset.y + scale - inset));
+	}
+}
+
+void ShadowCache::clear()
+{
+	if (mCube != 0)
+	{
+		GLuint textures[] = { mStaticCube, mCube, mStaticAtlas, mAtlas };
+		glDeleteTextures(4, textures);
+		GLuint framebuffers[] = { mDrawFramebuffer, mReadFramebuffer };
+		glDeleteFramebuffers(2, framebuffers);
+		mStaticCube = mCube = mStaticAtlas = mAtlas = 0;
+		mDrawFramebuffer = mReadFramebuffer = 0;
+	}
+	mPoint = ShadowSet();
+	mSpot = ShadowSet();
+	mDirectional = ShadowSet();
+	mCurrent = nullptr;
+}
+
+void ShadowCache::create()
+{
+	if (mCube != 0)
+		return;
+
+	mStaticCube = createDepthTexture(GL_TEXTURE_CUBE_MAP, SHADOW_CUBE_SIZE);
+	mCube = createDepthTexture(GL_TEXTURE_CUBE_MAP, SHADOW_CUBE_SIZE);
+	mStaticAtlas = createDepthTexture(GL_TEXTURE_2D, SHADOW_ATLAS_SIZE);
+	mAtlas = createDepthTexture(GL_TEXTURE_2D, SHADOW_ATLAS_SIZE);
+
+	// depth only
+	GLuint framebuffers[2];
+	glGenFramebuffers(2, framebuffers);
+	mDrawFramebuffer = framebuffers[0];
+	mReadFramebuffer = framebuffers[1];
+	for (GLuint framebuffer : framebuffers)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCache::buildViews(ShadowSet& set) const
+{
+	const Light& light = set.light;
+	set.views.clear();
+
+	if (light.type == 1)
+	{
+		// cube map faces in GL order, looking along each axis
+		const glm::vec3 directions[6] = {
+			glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+		const glm::vec3 ups[6] = {
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f) };
+
+		glm::mat4 projMatrix = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR, SHADOW_FAR);
+		for (int face = 0; face < 6; face++)
+		{
+			ShadowView view;
+			view.viewMatrix = glm::lookAt(light.pos, light.pos + directions[face], ups[face]);
+			view.projMatrix = projMatrix;
+			view.target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+			view.size = SHADOW_CUBE_SIZE;
+			set.views.push_back(view);
+		}
+		return;
+	}
+
+	ShadowView view;
+	view.size = SHADOW_ATLAS_SIZE / SHADOW_ATLAS_TILES;
+	glm::vec3 direction = glm::normalize(light.dir);
+	if (light.type == 3)
+	{
+		// the spotlight's cone
+		float fieldOfView = glm::radians(std::min(2.0f * light.outerAngle, 170.0f));
+		view.viewMatrix = glm::lookAt(light.pos, light.pos + direction, upVector(direction));
+		view.projMatrix = glm::perspective(fieldOfView, 1.0f, SHADOW_NEAR, SHADOW_FAR);
+		view.origin = glm::ivec2(0, 0);
+	}
+	else
+	{
+		// the scene's bounds seen along the light
+		glm::vec3 eye = mSceneCenter - direction * (mSceneRadius + 1.0f);
+		view.viewMatrix = glm::lookAt(eye, mSceneCenter, upVector(direction));
+		view.projMatrix = glm::ortho(-mSceneRadius, mSceneRadius, -mSceneRadius, mSceneRadius,
+			0.5f, 2.0f * mSceneRadius + 1.5f);
+		view.origin = glm::ivec2(view.size, 0);
+	}
+	set.views.push_back(view);
+}
+
+void ShadowCache::attach(GLenum framebuffer, const ShadowView& view, bool staticLayer) const
+{
+	GLuint texture;
+	if (view.target == GL_TEXTURE_2D)
+		texture = staticLayer ? mStaticAtlas : mAtlas;
+	else
+		texture = staticLayer ? mStaticCube : mCube;
+	glFramebufferTexture2D(framebuffer, GL_DEPTH_ATTACHMENT, view.target, texture, 0);
+}
+
+void ShadowCache::renderStatic(const ShadowView& view, const ShadowDrawFunction& drawStatic)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, mDrawFramebuffer);
+	attach(GL_FRAMEBUFFER, view, true);
+	glViewport(view.origin.x, view.origin.y, view.size, view.size);
+	glScissor(view.origin.x, view.origin.y, view.size, view.size);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	drawStatic(view.viewMatrix, view.projMatrix);
+	mNumOfStaticRenders++;
+}
+
+void ShadowCache::renderDynamic(ShadowView& view, const ShadowDrawFunction& drawDynamic, bool touched)
+{
+	// start from the static layer
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mReadFramebuffer);
+	attach(GL_READ_FRAMEBUFFER, view, true);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mDrawFramebuffer);
+	attach(GL_DRAW_FRAMEBUFFER, view, false);
+	glScissor(view.origin.x, view.origin.y, view.size, view.size);
+	int x1 = view.origin.x + view.size;
+	int y1 = view.origin.y + view.size;
+	glBlitFramebuffer(view.origin.x, view.origin.y, x1, y1, view.origin.x, view.origin.y, x1, y1,
+		GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	if (touched)
+	{
+		glViewport(view.origin.x, view.origin.y, view.size, view.size);
+		drawDynamic(view.viewMatrix, view.projMatrix);
+	}
+	view.hasDynamic = touched;
+	mNumOfDynamicRenders++;
+}
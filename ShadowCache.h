@@ -0,0 +1,105 @@
+#ifndef SHADOW_CACHE_H
+#define SHADOW_CACHE_H
+
+#include "utilities.h"
+
+#include <functional>
+
+// texture units of the shadow maps (after the G-buffer)
+const GLuint SHADOW_CUBE_UNIT = 10;
+const GLuint SHADOW_ATLAS_UNIT = 11;
+
+const int SHADOW_CUBE_SIZE = 512;		// texels across a face of the point light cube map
+const int SHADOW_ATLAS_SIZE = 2048;		// texels across the spot and directional light atlas
+const int SHADOW_ATLAS_TILES = 2;		// tiles across the atlas
+const float SHADOW_NEAR = 0.05f;		// near plane of point and spot light views
+const float SHADOW_FAR = 10.0f;			// far plane of point and spot light views
+
+// draws shadow casters into the bound shadow map, depth only
+typedef std::function<void(const glm::mat4& viewMatrix, const glm::mat4& projMatrix)> ShadowDrawFunction;
+
+/*****************************************************************
+ * shadow maps of the scene light, re-rendered only on change
+ *
+ * point lights render into a depth cube map, spotlights and
+ * directional lights into tiles of a shared depth atlas (one tile
+ * for each, so switching between them keeps both cached). every
+ * map has two layers: casters that never move are rendered into a
+ * static layer only when the light changes, and each frame in
+ * which the dynamic casters move, the faces or tiles they touch
+ * (now or last time) are copied from the static layer and have the
+ * dynamic casters drawn over them. a still scene re-renders nothing
+ *****************************************************************/
+class ShadowCache
+{
+public:
+	ShadowCache();
+	~ShadowCache();
+
+	ShadowCache(const ShadowCache&) = delete;
+	ShadowCache& operator=(const ShadowCache&) = delete;
+
+	// bounding sphere of everything casting or receiving shadows (for directional lights)
+	void setSceneBounds(const glm::vec3& center, float radius);
+	// re-render the layers of the light's maps that changed; dynamic casters are bounded by a
+	// sphere (radius 0 for none) and dynamicChanged when they moved since the last update.
+	// leaves the default framebuffer bound and the viewport to the caller
+	void update(const Light& light, const ShadowDrawFunction& drawStatic, const ShadowDrawFunction& drawDynamic,
+		const glm::vec3& dynamicCenter, float dynamicRadius, bool dynamicChanged);
+	// bind the maps to their units and set the shader's uShadow uniforms for the light last
+	// updated, with its index in the light data (-1 turns shadows off)
+	void bind(ShaderProgram& shader, int lightIndex) const;
+	// free the maps while the context exists
+	void clear();
+
+	// faces or tiles re-rendered by the last update, static and dynamic layers
+	int getNumOfStaticRenders() const { return mNumOfStaticRenders; }
+	int getNumOfDynamicRenders() const { return mNumOfDynamicRenders; }
+
+private:
+	// one face of the cube map or tile of the atlas
+	struct ShadowView
+	{
+		glm::mat4 viewMatrix = glm::mat4(1.0f);
+		glm::mat4 projMatrix = glm::mat4(1.0f);
+		GLenum target = GL_TEXTURE_2D;		// cube map face, or the atlas
+		glm::ivec2 origin = glm::ivec2(0, 0);	// texels into the atlas
+		int size = 0;
+		bool hasDynamic = false;			// dynamic casters were drawn into it
+	};
+
+	// maps of one light type
+	struct ShadowSet
+	{
+		bool isValid = false;
+		Light light;						// light the static layer was rendered for
+		unsigned int dynamicVersion = 0;	// dynamic casters the dynamic layer was rendered with
+		std::vector<ShadowView> views;
+	};
+
+	GLuint mStaticCube = 0;
+	GLuint mCube = 0;						// static layer with the dynamic casters
+	GLuint mStaticAtlas = 0;
+	GLuint mAtlas = 0;
+	GLuint mDrawFramebuffer = 0;
+	GLuint mReadFramebuffer = 0;
+
+	ShadowSet mPoint;
+	ShadowSet mSpot;						// atlas tile 0
+	ShadowSet mDirectional;					// atlas tile 1
+	const ShadowSet* mCurrent = nullptr;	// set of the light last updated
+	unsigned int mDynamicVersion = 0;		// counts the updates in which dynamic casters moved
+
+	glm::vec3 mSceneCenter = glm::vec3(0.0f);
+	float mSceneRadius = 1.0f;
+	int mNumOfStaticRenders = 0;
+	int mNumOfDynamicRenders = 0;
+
+	void create();
+	void buildViews(ShadowSet& set) const;
+	void attach(GLenum framebuffer, const ShadowView& view, bool staticLayer) const;
+	void renderStatic(const ShadowView& view, const ShadowDrawFunction& drawStatic);
+	void renderDynamic(ShadowView& view, const ShadowDrawFunction& drawDynamic, bool touched);
+};
+
+#endif
@@ -1,47 +1,713 @@
 #include "SimpleModel.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjLoader.h"
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+	// post processing applied by assimp (and matched by the native OBJ loader)
+	const unsigned int IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_JoinIdenticalVertices;
+	// import flag of meshes loaded with texture coordinates
+	const unsigned int IMPORT_TEXTURE = 1u << 31;
+	// the crease angle (whole degrees) and model options are stored in the import
+	// flags above the assimp flags in use
+	const unsigned int IMPORT_CREASE_SHIFT = 8;
+	const unsigned int IMPORT_OPTIONS_SHIFT = 16;
+
+	// allowed increase of the cache miss ratio when splitting clusters for overdraw
+	const float OVERDRAW_THRESHOLD = 1.05f;
+
+	// bytes copied to a buffer per glBufferSubData call while uploading
+	const uint64_t UPLOAD_SLICE_BYTES = 1 << 20;
+
+	// immutable storage where available, filled a slice at a time
+	void createBuffer(GLenum target, GLsizeiptr size)
+	{
+		if (GLEW_ARB_buffer_storage)
+			glBufferStorage(target, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		else
+			glBufferData(target, size, nullptr, GL_STATIC_DRAW);
+	}
+
+	// copy the next slice of a section, returns true once it is complete
+	bool uploadSlice(GLuint buffer, const void* source, uint64_t size, uint64_t& uploaded)
+	{
+		uint64_t bytes = std::min(size - uploaded, UPLOAD_SLICE_BYTES);
+
+		// the copy target leaves the element array binding of the bound VAO alone
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(uploaded), static_cast<GLsizeiptr>(bytes),
+			static_cast<const unsigned char*>(source) + uploaded);
+		uploaded += bytes;
+
+		return uploaded == size;
+	}
+
+	// case insensitive check of a file name's extension
+	bool hasExtension(const char* filename, const char* extension)
+	{
+		size_t length = std::strlen(filename), extensionLength = std::strlen(extension);
+		if (length < extensionLength)
+			return false;
+
+		for (size_t i = 0; i < extensionLength; i++)
+		{
+			if (std::tolower(static_cast<unsigned char>(filename[length - extensionLength + i])) != extension[i])
+				return false;
+		}
+		return true;
+	}
+
+	// append an assimp mesh to the system memory arrays as a new submesh
+	// missing normals are left zero for generateCreaseNormals if allowed
+	void readAssimpMesh(const aiMesh* mesh, bool texCoords, bool missingNormals, MeshData& data)
+	{
+		// meshes without positions, normals or faces are skipped
+		if (!mesh->HasPositions() || (!mesh->HasNormals() && !missingNormals) || !mesh->HasFaces())
+			return;
+
+		SubmeshData submesh;
+		submesh.firstIndex = data.indices.size();
+		submesh.firstVertex = data.numOfVertices();
+		submesh.numOfVertices = mesh->mNumVertices;
+		submesh.materialIndex = mesh->mMaterialIndex;
+
+		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+		{
+			// get vertex position and normal
+			data.positions.insert(data.positions.end(), { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z });
+			if (mesh->HasNormals())
+				data.normals.insert(data.normals.end(), { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z });
+			else
+				data.normals.insert(data.normals.end(), { 0.0f, 0.0f, 0.0f });
+
+			// get first vertex texture coordinate (i.e. index 0), zero if this mesh has none
+			if (mesh->HasTextureCoords(0))
+				data.texCoords.insert(data.texCoords.end(), { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y });
+			else if (texCoords)
+				data.texCoords.insert(data.texCoords.end(), { 0.0f, 0.0f });
+		}
+
+		// get face data (indices relative to the submesh's first vertex)
+		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+		{
+			for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+				data.indices.push_back(mesh->mFaces[i].mIndices[j]);
+		}
+
+		submesh.numOfIndices = data.indices.size() - submesh.firstIndex;
+		data.submeshes.push_back(submesh);
+	}
+
+	// copy all meshes and materials of an assimp scene
+	void readAssimpScene(const aiScene* scene, bool missingNormals, MeshData& data)
+	{
+		for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+		{
+			const aiMaterial* source = scene->mMaterials[i];
+			MaterialData material;
+			aiString name, texture;
+			aiColor3D color;
+
+			if (source->Get(AI_MATKEY_NAME, name) == AI_SUCCESS)
+				material.name = name.C_Str();
+			if (source->Get(AI_MATKEY_COLOR_AMBIENT, color) == AI_SUCCESS)
+				std::copy_n(&color.r, 3, material.ambient);
+			if (source->Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS)
+				std::copy_n(&color.r, 3, material.diffuse);
+			if (source->Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS)
+				std::copy_n(&color.r, 3, material.specular);
+			source->Get(AI_MATKEY_SHININESS, material.shininess);
+			if (source->GetTexture(aiTextureType_DIFFUSE, 0, &texture) == AI_SUCCESS)
+				material.diffuseMap = texture.C_Str();
+
+			data.materials.push_back(material);
+		}
+
+		// texture coordinates are kept if any mesh has them
+		bool texCoords = false;
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+			texCoords = texCoords || scene->mMeshes[i]->HasTextureCoords(0);
+
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+			readAssimpMesh(scene->mMeshes[i], texCoords, missingNormals, data);
+
+		if (data.materials.empty())
+			data.materials.push_back(MaterialData());
+	}
+
+	// move the attributes of a submesh's vertices to their remapped positions
+	void remapAttribute(std::vector<float>& attribute, size_t numOfComponents, const SubmeshData& submesh,
+		const std::vector<unsigned int>& remap, std::vector<float>& scratch)
+	{
+		float* values = &attribute[submesh.firstVertex * numOfComponents];
+		scratch.assign(values, values + submesh.numOfVertices * numOfComponents);
+
+		for (size_t i = 0; i < submesh.numOfVertices; i++)
+			std::copy_n(&scratch[i * numOfComponents], numOfComponents, values + remap[i] * numOfComponents);
+	}
+
+	// reorder the triangles and vertices of every submesh for the GPU
+	void optimizeMesh(MeshData& mesh, unsigned int options)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		size_t transformedBefore = 0, transformedAfter = 0;
+		std::vector<unsigned int> indices, optimized, remap;
+		std::vector<size_t> clusters;
+		std::vector<float> scratch;
+
+		for (const SubmeshData& submesh : mesh.submeshes)
+		{
+			auto first = mesh.indices.begin() + submesh.firstIndex;
+			indices.assign(first, first + submesh.numOfIndices);
+			transformedBefore += analyzeVertexCache(indices, submesh.numOfVertices).numOfTransformed;
+
+			// overdraw sorting works on the clusters found by the cache optimization
+			if (options & (MODEL_OPTIMIZE_VERTEX_CACHE | MODEL_OPTIMIZE_OVERDRAW))
+			{
+				optimizeVertexCache(optimized, indices, submesh.numOfVertices, VERTEX_CACHE_SIZE, &clusters);
+				if (options & MODEL_OPTIMIZE_OVERDRAW)
+				{
+					optimizeOverdraw(optimized, clusters, &mesh.positions[submesh.firstVertex * 3],
+						submesh.numOfVertices, 3 * sizeof(float), OVERDRAW_THRESHOLD);
+				}
+				indices.swap(optimized);
+			}
+			transformedAfter += analyzeVertexCache(indices, submesh.numOfVertices).numOfTransformed;
+
+			if (options & MODEL_OPTIMIZE_VERTEX_FETCH)
+			{
+				optimizeVertexFetch(remap, indices, submesh.numOfVertices);
+				remapAttribute(mesh.positions, 3, submesh, remap, scratch);
+				remapAttribute(mesh.normals, 3, submesh, remap, scratch);
+				if (mesh.hasTexCoords())
+					remapAttribute(mesh.texCoords, 2, submesh, remap, scratch);
+			}
+
+			std::copy(indices.begin(), indices.end(), first);
+		}
+
+		// report post-transform cache efficiency (ATVR of 1.0 is optimal)
+		float numOfTriangles = static_cast<float>(std::max<size_t>(mesh.numOfTriangles(), 1));
+		float numOfVertices = static_cast<float>(std::max<size_t>(mesh.numOfVertices(), 1));
+		std::chrono::duration<double, std::milli> optimizeTime = std::chrono::steady_clock::now() - startTime;
+		std::cout << "Optimized mesh in " << optimizeTime.count() << " ms: ACMR "
+			<< transformedBefore / numOfTriangles << " -> " << transformedAfter / numOfTriangles << ", ATVR "
+			<< transformedBefore / numOfVertices << " -> " << transformedAfter / numOfVertices << std::endl;
+	}
+
+	// largest decode errors of the packed vertex formats
+	struct QuantizationError
+	{
+		float position = 0.0f;
+		float normal = 0.0f;		// degrees
+		float texCoord = 0.0f;
+	};
+
+	void packPosition(const float* position, const vec3& boundsMin, const vec3& extent,
+		GLushort packed[3], QuantizationError& error)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			float scale = extent[k] > 0.0f ? 1.0f / extent[k] : 0.0f;
+			packed[k] = quantizeUnorm16((position[k] - boundsMin[k]) * scale);
+
+			float decoded = boundsMin[k] + packed[k] / 65535.0f * extent[k];
+			error.position = std::max(error.position, std::abs(decoded - position[k]));
+		}
+	}
+
+	// unit vector with w (e.g. a tangent's handedness) in the 2-bit field
+	GLuint packNormal(const float* normal, QuantizationError& error, float w = 0.0f)
+	{
+		GLuint packed = packOctahedral(normal, w);
+
+		float decoded[3];
+		unpackOctahedral(packed, decoded);
+		float cosine = dot(normalize(vec3(normal[0], normal[1], normal[2])), vec3(decoded[0], decoded[1], decoded[2]));
+		error.normal = std::max(error.normal, degrees(std::acos(std::min(cosine, 1.0f))));
+
+		return packed;
+	}
+
+	GLhalf packTexCoord(float texCoord, QuantizationError& error)
+	{
+		GLhalf packed = floatToHalf(texCoord);
+		error.texCoord = std::max(error.texCoord, std::abs(halfToFloat(packed) - texCoord));
+		return packed;
+	}
+
+	// split submeshes with too many vertices for 16-bit indices into chunks, each
+	// with its own copy of the vertices it uses so it can be drawn from a base vertex
+	void splitLargeSubmeshes(MeshData& mesh)
+	{
+		size_t numOfLarge = 0;
+		for (const SubmeshData& submesh : mesh.submeshes)
+			numOfLarge += submesh.numOfVertices > MAX_SHORT_INDEX_VERTICES;
+		if (numOfLarge == 0)
+			return;
+
+		MeshData output;
+		output.materials.swap(mesh.materials);
+		output.indices.reserve(mesh.indices.size());
+		output.positions.reserve(mesh.positions.size());
+		output.normals.reserve(mesh.normals.size());
+		output.texCoords.reserve(mesh.texCoords.size());
+
+		// chunk local index of each source vertex of the current submesh
+		const unsigned int unassigned = ~0u;
+		std::vector<unsigned int> chunkIndex;
+		std::vector<unsigned int> chunkVertices;
+
+		auto appendVertex = [&mesh, &output](size_t vertex)
+		{
+			output.positions.insert(output.positions.end(), &mesh.positions[vertex * 3], &mesh.positions[vertex * 3] + 3);
+			if (!mesh.normals.empty())
+				output.normals.insert(output.normals.end(), &mesh.normals[vertex * 3], &mesh.normals[vertex * 3] + 3);
+			if (mesh.hasTexCoords())
+				output.texCoords.insert(output.texCoords.end(), &mesh.texCoords[vertex * 2], &mesh.texCoords[vertex * 2] + 2);
+		};
+
+		auto startChunk = [&output](const SubmeshData& source)
+		{
+			SubmeshData chunk;
+			chunk.firstIndex = output.indices.size();
+			chunk.firstVertex = output.numOfVertices();
+			chunk.materialIndex = source.materialIndex;
+			output.submeshes.push_back(chunk);
+		};
+
+		auto finishChunk = [&output]()
+		{
+			SubmeshData& chunk = output.submeshes.back();
+			chunk.numOfIndices = output.indices.size() - chunk.firstIndex;
+			chunk.numOfVertices = output.numOfVertices() - chunk.firstVertex;
+		};
+
+		size_t numOfChunks = 0;
+		for (const SubmeshData& submesh : mesh.submeshes)
+		{
+			const unsigned int* indices = &mesh.indices[submesh.firstIndex];
+			startChunk(submesh);
+
+			if (submesh.numOfVertices <= MAX_SHORT_INDEX_VERTICES)
+			{
+				// small submeshes are copied unchanged
+				for (size_t i = 0; i < submesh.numOfVertices; i++)
+					appendVertex(submesh.firstVertex + i);
+				output.indices.insert(output.indices.end(), indices, indices + submesh.numOfIndices);
+				finishChunk();
+				continue;
+			}
+
+			// add triangles in order until the next one would overflow the chunk
+			chunkIndex.assign(submesh.numOfVertices, unassigned);
+			chunkVertices.clear();
+
+			for (size_t i = 0; i < submesh.numOfIndices; i += 3)
+			{
+				size_t numOfNew = (chunkIndex[indices[i]] == unassigned) + (chunkIndex[indices[i + 1]] == unassigned)
+					+ (chunkIndex[indices[i + 2]] == unassigned);
+
+				if (chunkVertices.size() + numOfNew > MAX_SHORT_INDEX_VERTICES)
+				{
+					finishChunk();
+					startChunk(submesh);
+					numOfChunks++;
+
+					for (unsigned int vertex : chunkVertices)
+						chunkIndex[vertex] = unassigned;
+					chunkVertices.clear();
+				}
+
+				for (size_t k = 0; k < 3; k++)
+				{
+					unsigned int vertex = indices[i + k];
+					if (chunkIndex[vertex] == unassigned)
+					{
+						chunkIndex[vertex] = static_cast<unsigned int>(chunkVertices.size());
+						chunkVertices.push_back(vertex);
+						appendVertex(submesh.firstVertex + vertex);
+					}
+					output.indices.push_back(chunkIndex[vertex]);
+				}
+			}
+
+			finishChunk();
+			numOfChunks++;
+		}
+
+		std::cout << "Split " << numOfLarge << " large meshes into " << numOfChunks << " chunks for 16-bit indices ("
+			<< output.numOfVertices() - mesh.numOfVertices() << " vertices duplicated)" << std::endl;
+
+		mesh = std::move(output);
+	}
+
+	MeshCacheMaterial toCacheMaterial(const MaterialData& source)
+	{
+		MeshCacheMaterial material;
+		std::copy_n(source.ambient, 3, material.ambient);
+		std::copy_n(source.diffuse, 3, material.diffuse);
+		std::copy_n(source.specular, 3, material.specular);
+		material.shininess = source.shininess;
+		return material;
+	}
+
+	Material toMaterial(const MeshCacheMaterial& source)
+	{
+		Material material;
+		material.Ka = vec3(source.ambient[0], source.ambient[1], source.ambient[2]);
+		material.Kd = vec3(source.diffuse[0], source.diffuse[1], source.diffuse[2]);
+		material.Ks = vec3(source.specular[0], source.specular[1], source.specular[2]);
+		material.emission = vec3(0.0f);
+		material.shininess = source.shininess;
+		return material;
+	}
+
+	// writes streamed OBJ elements straight into a model's buffers
+	// (positions, then normals if used, in the vertex buffer)
+	class BufferStreamSink : public ObjStreamSink
+	{
+	public:
+		BufferStreamSink(GLuint vertexBuffer, GLuint indexBuffer, GLintptr normalOffset)
+			: mVertexBuffer(vertexBuffer), mIndexBuffer(indexBuffer), mNormalOffset(normalOffset)
+		{}
+
+		void addPositions(const float* positions, size_t first, size_t count) override
+		{
+			write(mVertexBuffer, first * 3 * sizeof(GLfloat), count * 3 * sizeof(GLfloat), positions);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				vec3 position(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+				boundsMin = min(boundsMin, position);
+				boundsMax = max(boundsMax, position);
+			}
+		}
+
+		void addNormals(const float* normals, size_t first, size_t count) override
+		{
+			if (mNormalOffset != 0)
+				write(mVertexBuffer, mNormalOffset + first * 3 * sizeof(GLfloat), count * 3 * sizeof(GLfloat), normals);
+		}
+
+		void addTriangles(const unsigned int* indices, size_t first, size_t count) override
+		{
+			write(mIndexBuffer, first * 3 * sizeof(GLuint), count * 3 * sizeof(GLuint), indices);
+		}
+
+		vec3 boundsMin = vec3(FLT_MAX);
+		vec3 boundsMax = vec3(-FLT_MAX);
+		uint64_t uploadedBytes = 0;
+
+	private:
+		GLuint mVertexBuffer;
+		GLuint mIndexBuffer;
+		GLintptr mNormalOffset;		// 0 if normals are not kept
+
+		void write(GLuint buffer, size_t offset, size_t bytes, const void* data)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+			uploadedBytes += bytes;
+		}
+	};
+}
+
+// mesh processed on a loader thread, waiting for upload on the render thread
+struct PreparedMesh
+{
+	MeshCacheHeader header;
+	MeshCacheData data;			// points into the arrays below or into the cache mapping
+	MappedFile cache;
+	std::vector<unsigned char> vertices;
+	std::vector<unsigned char> indices;
+	std::vector<MeshCacheLod> lods;
+	std::vector<MeshCacheSubmesh> submeshes;
+	std::vector<MeshCacheMaterial> materials;
+	std::vector<Meshlet> meshlets;
+	unsigned int options = 0;	// ModelOptions the mesh is processed with
+};
 
 SimpleModel::SimpleModel()
 {}
 
 SimpleModel::~SimpleModel()
 {
-	// delete mesh buffers
-	if (mMesh.VBO != 0)
-		glDeleteBuffers(1, &mMesh.VBO);
-	if (mMesh.IBO != 0)
-		glDeleteBuffers(1, &mMesh.IBO);
-	if (mMesh.VAO != 0)
-		glDeleteVertexArrays(1, &mMesh.VAO);
+	releaseMesh();
+}
 
-	mIsValid = false;
+bool SimpleModel::loadModel(const char* filename, bool texture, unsigned int options)
+{
+	releaseMesh();
+
+	std::unique_ptr<PreparedMesh> prepared(new PreparedMesh);
+	if (!prepareModel(filename, texture, options, mCreaseAngle, *prepared))
+		return false;
+
+	// upload everything at once
+	mPending = std::move(prepared);
+	beginUpload();
+	return update(std::numeric_limits<double>::infinity());
 }
 
-void SimpleModel::loadModel(const char* filename, bool texture)
+std::shared_future<bool> SimpleModel::loadModelAsync(const char* filename, bool texture, unsigned int options)
 {
-	// Create an instance of the Importer class
-	Assimp::Importer importer;
+	releaseMesh();
+
+	// the pending mesh is only touched by the render thread once the future is ready;
+	// settings are copied so changing them during the load does not race with it
+	std::string file(filename);
+	float creaseAngle = mCreaseAngle;
+	mLoading = ThreadPool::shared().submit([this, file, texture, options, creaseAngle]()
+	{
+		std::unique_ptr<PreparedMesh> prepared(new PreparedMesh);
+		if (!prepareModel(file, texture, options, creaseAngle, *prepared))
+			return false;
+
+		mPending = std::move(prepared);
+		return true;
+	}).share();
 
-	// load model file with assimp 
-	const aiScene* scene = importer.ReadFile(filename,
-		aiProcess_Triangulate |
-		aiProcess_GenSmoothNormals |
-		aiProcess_JoinIdenticalVertices);
+	return mLoading;
+}
 
-	// check whether scene was loaded
-	if (!scene)
+bool SimpleModel::update(double budget)
+{
+	// take over the processed mesh once the loader thread is done
+	if (mLoading.valid())
 	{
-		// output error message and exit
+		if (mLoading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+
+		mLoading = std::shared_future<bool>();
+		if (mPending)
+			beginUpload();
+	}
+
+	if (mPending)
+		uploadSlices(budget);
+
+	return mIsValid;
+}
+
+bool SimpleModel::loadModelStreaming(const char* filename, size_t memoryBudget)
+{
+	releaseMesh();
+	auto startTime = std::chrono::steady_clock::now();
+
+	// parsing keeps about three windows worth of text and elements alive
+	size_t windowBytes = std::max<size_t>(memoryBudget / 3, MIN_STREAMING_WINDOW);
+
+	// the scanning pass sizes the buffers so windows can be written in place
+	ObjStreamInfo info;
+	if (!hasExtension(filename, ".obj") || !scanObj(filename, windowBytes, info) || info.numOfTriangles == 0)
+	{
+		// output error message
 		std::cerr << "Failed to open: " << filename << std::endl;
-		exit(EXIT_FAILURE);
+		return false;
 	}
+	auto scanTime = std::chrono::steady_clock::now();
 
-	// only loads first mesh
-	if (!texture)
-		loadMesh(scene->mMeshes[0]);
+	// positions followed by normals, each section written as it is parsed
+	GLsizeiptr positionBytes = static_cast<GLsizeiptr>(info.numOfPositions * 3 * sizeof(GLfloat));
+	bool hasNormals = info.numOfNormals == info.numOfPositions;
+
+	glGenBuffers(1, &mMesh.VBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mMesh.VBO);
+	createBuffer(GL_COPY_WRITE_BUFFER, hasNormals ? 2 * positionBytes : positionBytes);
+
+	glGenBuffers(1, &mMesh.IBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mMesh.IBO);
+	createBuffer(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(info.numOfTriangles * 3 * sizeof(GLuint)));
+
+	BufferStreamSink sink(mMesh.VBO, mMesh.IBO, hasNormals ? positionBytes : 0);
+	bool isStreamed = streamObj(filename, windowBytes, sink, info);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (!isStreamed)
+	{
+		// output error message
+		std::cerr << "Failed to open: " << filename << std::endl;
+		releaseMesh();
+		return false;
+	}
+
+	// one submesh with the default material and no further levels of detail
+	Submesh submesh;
+	MeshLod lod;
+	lod.numOfIndices = static_cast<GLsizei>(info.numOfTriangles * 3);
+	submesh.lods.push_back(lod);
+	mMesh.submeshes.push_back(submesh);
+	mMesh.materials.push_back(toMaterial(toCacheMaterial(MaterialData())));
+
+	MeshDrawList drawList;
+	drawList.counts.push_back(lod.numOfIndices);
+	drawList.offsets.push_back(nullptr);
+	drawList.baseVertices.push_back(0);
+	mMesh.drawLists.push_back(drawList);
+
+	mMesh.numOfIndices = lod.numOfIndices;
+	mMesh.indexType = GL_UNSIGNED_INT;
+	mMesh.boundsMin = sink.boundsMin;
+	mMesh.boundsMax = sink.boundsMax;
+	mMesh.center = 0.5f * (sink.boundsMin + sink.boundsMax);
+	mMesh.radius = 0.5f * length(sink.boundsMax - sink.boundsMin);
+
+	// normals that are not paired with positions are replaced by face normals in the shader
+	hasNormals = hasNormals && info.normalsMatchPositions;
+	mMesh.hasFaceNormals = !hasNormals;
+
+	// generate identifiers for VAO and supply information
+	glGenVertexArrays(1, &mMesh.VAO);
+	glBindVertexArray(mMesh.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+	glEnableVertexAttribArray(0);
+	if (hasNormals)
+	{
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<void*>(positionBytes));
+		glEnableVertexAttribArray(1);
+	}
+
+	// unbind VAO
+	glBindVertexArray(0);
+
+	mIsValid = true;
+
+	// report throughput over both passes
+	std::chrono::duration<double> scanSeconds = scanTime - startTime;
+	std::chrono::duration<double> totalSeconds = std::chrono::steady_clock::now() - startTime;
+	double megabytes = info.fileSize / (1024.0 * 1024.0);
+	std::cout << "Streamed " << filename << " (" << info.numOfTriangles << " triangles, " << megabytes << " MB, "
+		<< windowBytes / (1024 * 1024) << " MB windows) in " << totalSeconds.count() * 1000.0 << " ms: "
+		<< megabytes / std::max(totalSeconds.count(), 1e-9) << " MB/s (scan "
+		<< megabytes / std::max(scanSeconds.count(), 1e-9) << " MB/s), "
+		<< sink.uploadedBytes / (1024.0 * 1024.0) << " MB uploaded" << std::endl;
+
+	return true;
+}
+
+bool SimpleModel::prepareModel(const std::string& filename, bool texture, unsigned int options, float creaseAngle,
+	PreparedMesh& prepared) const
+{
+	MeshData data;
+	auto startTime = std::chrono::steady_clock::now();
+
+	// hash source contents so edited files are imported again
+	MappedFile source;
+	if (!source.open(filename))
+	{
+		// output error message
+		std::cerr << "Failed to open: " << filename << std::endl;
+		return false;
+	}
+	uint64_t sourceHash = hashData(source.data(), source.size());
+	source.close();
+
+	unsigned int importFlags = IMPORT_FLAGS | (texture ? IMPORT_TEXTURE : 0) | (options << IMPORT_OPTIONS_SHIFT)
+		| (static_cast<unsigned int>(creaseAngle + 0.5f) << IMPORT_CREASE_SHIFT);
+	std::string cacheFile = meshCachePath(filename, sourceHash, importFlags);
+
+	// upload straight from the mapping of a previously written cache file
+	prepared.options = options;
+	const MeshCacheHeader* header = openMeshCache(prepared.cache, cacheFile, sourceHash, importFlags, prepared.data);
+	if (header != nullptr)
+	{
+		prepared.header = *header;
+
+		// report load time
+		std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+		std::cout << "Loaded " << filename << " from cache in " << loadTime.count() << " ms" << std::endl;
+		return true;
+	}
+
+	// OBJ files use the native loader, other formats go through assimp
+	if (hasExtension(filename.c_str(), ".obj"))
+	{
+		if (!loadObj(filename.c_str(), data))
+		{
+			// output error message
+			std::cerr << "Failed to open: " << filename << std::endl;
+			return false;
+		}
+	}
 	else
-		loadMeshWithTexture(scene->mMeshes[0]);
+	{
+		// Create an instance of the Importer class
+		Assimp::Importer importer;
+
+		// load model file with assimp, leaving vertex joining and normals to the native passes if enabled
+		bool weld = (options & MODEL_WELD_VERTICES) != 0;
+		const aiScene* scene = importer.ReadFile(filename.c_str(), weld ? static_cast<unsigned int>(aiProcess_Triangulate) : IMPORT_FLAGS);
+
+		// check whether scene was loaded
+		if (!scene)
+		{
+			// output error message
+			std::cerr << "Failed to open: " << filename << std::endl;
+			return false;
+		}
+
+		// all meshes go into one set of buffers
+		readAssimpScene(scene, weld, data);
+
+		// importer's destructor will clean up
+
+		if (weld)
+		{
+			auto weldStart = std::chrono::steady_clock::now();
+			size_t numOfVertices = data.numOfVertices();
+			generateCreaseNormals(data, creaseAngle);
+			size_t numOfWelded = weldVertices(data);
+
+			std::chrono::duration<double, std::milli> weldTime = std::chrono::steady_clock::now() - weldStart;
+			std::cout << "Welded " << numOfVertices << " vertices into " << data.numOfVertices() << " ("
+				<< numOfWelded << " shared) in " << weldTime.count() << " ms" << std::endl;
+		}
+	}
+
+	// report load time
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Loaded " << filename << " (" << data.numOfTriangles() << " triangles, "
+		<< data.submeshes.size() << " meshes, " << data.materials.size() << " materials) in "
+		<< loadTime.count() << " ms" << std::endl;
+
+	// reorder for the GPU before levels of detail are built on top
+	if (options & MODEL_OPTIMIZE_ALL)
+		optimizeMesh(data, options);
+
+	if (options & MODEL_SPLIT_16BIT_INDICES)
+		splitLargeSubmeshes(data);
+
+	// tangent frames once vertices are in their final order
+	if (texture && data.hasTexCoords() && (options & MODEL_GENERATE_TANGENTS))
+	{
+		auto tangentStart = std::chrono::steady_clock::now();
+		generateTangents(data);
 
-	// importer's destructor will clean up
+		std::chrono::duration<double, std::milli> tangentTime = std::chrono::steady_clock::now() - tangentStart;
+		std::cout << "Generated tangents in " << tangentTime.count() << " ms" << std::endl;
+	}
+
+	if (options & MODEL_QUANTIZE_VERTICES)
+		return loadPackedMesh(data, texture, cacheFile, prepared);
+	else if (!texture)
+		return loadMesh(data, cacheFile, prepared);
+	else
+		return loadMeshWithTexture(data, cacheFile, prepared);
 }
 
 void SimpleModel::drawModel()
@@ -49,121 +715,381 @@ void SimpleModel::drawModel()
 	if (mIsValid)
 	{
 		glBindVertexArray(mMesh.VAO);		// make mesh VAO active
-		glDrawElements(GL_TRIANGLES, mMesh.numOfIndices, GL_UNSIGNED_INT, 0);	// render vertices
+		drawSubmeshes(mMesh.drawLists[0], 0, mMesh.submeshes.size());	// render vertices
 	}
 }
 
-void SimpleModel::loadMesh(const aiMesh* mesh)
+void SimpleModel::drawModel(const mat4& modelMatrix, const mat4& viewMatrix,
+	const mat4& projMatrix, float viewportHeight)
 {
-	// mesh data
-	std::vector<VertexNormal> vertices;
-	std::vector<GLint> indices;
+	if (mIsValid)
+	{
+		// pick index ranges of the level of detail
+		int lod = selectLod(modelMatrix, viewMatrix, projMatrix, viewportHeight);
+		bool useClusters = lod == 0 && mClusterCulling && !mMesh.meshlets.empty();
+		if (useClusters)
+			cullClusters(modelMatrix, viewMatrix, projMatrix);
 
-	// check if mesh contains vertex coordinates, normals and faces
-	if (!mesh->HasPositions() || !mesh->HasNormals() || !mesh->HasFaces())
+		glBindVertexArray(mMesh.VAO);		// make mesh VAO active
+		if (useClusters)
+			drawClusters(0, mMesh.submeshes.size());
+		else
+			drawSubmeshes(mMesh.drawLists[lod], 0, mMesh.submeshes.size());	// render vertices
+	}
+}
+
+void SimpleModel::drawModel(ShaderProgram& shader, const mat4& modelMatrix, const mat4& viewMatrix,
+	const mat4& projMatrix, float viewportHeight)
+{
+	if (mIsValid)
+	{
+		// pick index ranges of the level of detail
+		int lod = selectLod(modelMatrix, viewMatrix, projMatrix, viewportHeight);
+		bool useClusters = lod == 0 && mClusterCulling && !mMesh.meshlets.empty();
+		if (useClusters)
+			cullClusters(modelMatrix, viewMatrix, projMatrix);
+
+		glBindVertexArray(mMesh.VAO);		// make mesh VAO active
+		setVertexDecoding(shader);
+
+		// one call per run of submeshes sharing a material
+		for (size_t first = 0, last = 0; first < mMesh.submeshes.size(); first = last)
+		{
+			GLuint materialIndex = mMesh.submeshes[first].materialIndex;
+			while (last < mMesh.submeshes.size() && mMesh.submeshes[last].materialIndex == materialIndex)
+				last++;
+
+			// set material properties
+			const Material& material = mMesh.materials[materialIndex];
+			shader.setUniform("uMaterial.Ka", material.Ka);
+			shader.setUniform("uMaterial.Kd", material.Kd);
+			shader.setUniform("uMaterial.Ks", material.Ks);
+			shader.setUniform("uMaterial.shininess", material.shininess);
+
+			if (useClusters)
+				drawClusters(first, last);
+			else
+				drawSubmeshes(mMesh.drawLists[lod], first, last);	// render vertices
+		}
+	}
+}
+
+void SimpleModel::setVertexDecoding(ShaderProgram& shader) const
+{
+	shader.setUniform("uQuantized", mMesh.isQuantized);
+	shader.setUniform("uFaceNormals", mMesh.hasFaceNormals);
+	shader.setUniform("uPositionOffset", mMesh.boundsMin);
+	shader.setUniform("uPositionScale", mMesh.boundsMax - mMesh.boundsMin);
+}
+
+void SimpleModel::drawSubmeshes(const MeshDrawList& drawList, size_t first, size_t last) const
+{
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, &drawList.counts[first], mMesh.indexType,
+		&drawList.offsets[first], static_cast<GLsizei>(last - first), &drawList.baseVertices[first]);
+}
+
+void SimpleModel::cullClusters(const mat4& modelMatrix, const mat4& viewMatrix, const mat4& projMatrix)
+{
+	// frustum planes of the combined matrix are in object space (Gribb and Hartmann)
+	mat4 clip = projMatrix * viewMatrix * modelMatrix;
+	auto row = [&clip](int i) { return vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]); };
+
+	MeshletCullView view;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			vec4 plane = row(3) + (side == 0 ? row(i) : -row(i));
+			plane /= std::max(length(vec3(plane)), FLT_MIN);
+			for (int k = 0; k < 4; k++)
+				view.planes[i * 2 + side][k] = plane[k];
+		}
+	}
+
+	// camera in object space; orthographic projections look along a fixed direction
+	mat4 cameraToObject = inverse(viewMatrix * modelMatrix);
+	vec3 position = vec3(cameraToObject[3]);
+	vec3 direction = normalize(vec3(cameraToObject * vec4(0.0f, 0.0f, -1.0f, 0.0f)));
+	for (int k = 0; k < 3; k++)
+	{
+		view.position[k] = position[k];
+		view.direction[k] = direction[k];
+	}
+	view.isOrthographic = projMatrix[2][3] == 0.0f;
+
+	// test meshlets in parallel ranges, then write each range's survivors
+	// after those of the ranges before it
+	size_t numOfMeshlets = mMesh.meshlets.size();
+	size_t numOfRanges = (numOfMeshlets + CLUSTER_CULL_GRAIN - 1) / CLUSTER_CULL_GRAIN;
+	mClusterVisibility.resize(numOfMeshlets);
+	mClusterRangeOffsets.assign(numOfRanges + 1, 0);
+
+	parallelFor(0, numOfMeshlets, CLUSTER_CULL_GRAIN, [this, &view](size_t first, size_t last)
 	{
-		mIsValid = false;
+		size_t count = 0;
+		for (size_t i = first; i < last; i++)
+		{
+			mClusterVisibility[i] = isMeshletVisible(mMesh.meshlets[i], view) ? 1 : 0;
+			count += mClusterVisibility[i];
+		}
+		mClusterRangeOffsets[first / CLUSTER_CULL_GRAIN + 1] = count;
+	});
+
+	for (size_t i = 0; i < numOfRanges; i++)
+		mClusterRangeOffsets[i + 1] += mClusterRangeOffsets[i];
+	mClusterDraws.commands.resize(mClusterRangeOffsets[numOfRanges]);
+
+	parallelFor(0, numOfMeshlets, CLUSTER_CULL_GRAIN, [this](size_t first, size_t last)
+	{
+		size_t output = mClusterRangeOffsets[first / CLUSTER_CULL_GRAIN];
+		for (size_t i = first; i < last; i++)
+		{
+			if (!mClusterVisibility[i])
+				continue;
+
+			const Meshlet& meshlet = mMesh.meshlets[i];
+			mClusterDraws.commands[output++] = { meshlet.numOfIndices, 1, meshlet.firstIndex,
+				mMesh.meshletBaseVertices[i], 0 };
+		}
+	});
+
+	// meshlets are stored in index buffer order, so each submesh's commands
+	// start at the first one past the end of the previous submesh
+	mClusterDraws.submeshOffsets.resize(mMesh.submeshes.size() + 1);
+	for (size_t i = 0; i < mMesh.submeshes.size(); i++)
+	{
+		GLuint firstIndex = mMesh.submeshes[i].lods[0].firstIndex;
+		mClusterDraws.submeshOffsets[i] = std::lower_bound(mClusterDraws.commands.begin(),
+			mClusterDraws.commands.end(), firstIndex, [](const DrawElementsIndirectCommand& command, GLuint index)
+		{
+			return command.firstIndex < index;
+		}) - mClusterDraws.commands.begin();
+	}
+	mClusterDraws.submeshOffsets.back() = mClusterDraws.commands.size();
+
+	// orphan the previous view's commands
+	if (mClusterDraws.buffer != 0)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mClusterDraws.buffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, mClusterDraws.commands.size() * sizeof(DrawElementsIndirectCommand),
+			mClusterDraws.commands.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void SimpleModel::drawClusters(size_t first, size_t last)
+{
+	size_t begin = mClusterDraws.submeshOffsets[first];
+	size_t end = mClusterDraws.submeshOffsets[last];
+	if (begin == end)
+		return;
+
+	if (mClusterDraws.buffer != 0)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mClusterDraws.buffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, mMesh.indexType,
+			reinterpret_cast<const void*>(begin * sizeof(DrawElementsIndirectCommand)),
+			static_cast<GLsizei>(end - begin), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 		return;
 	}
 
-	// get vertex data
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	// same commands as glMultiDrawElementsBaseVertex arguments
+	size_t indexSize = mMesh.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	mClusterFallback.counts.clear();
+	mClusterFallback.offsets.clear();
+	mClusterFallback.baseVertices.clear();
+	for (size_t i = begin; i < end; i++)
 	{
-		VertexNormal vertex;	// for vertex data
+		const DrawElementsIndirectCommand& command = mClusterDraws.commands[i];
+		mClusterFallback.counts.push_back(static_cast<GLsizei>(command.count));
+		mClusterFallback.offsets.push_back(reinterpret_cast<const void*>(command.firstIndex * indexSize));
+		mClusterFallback.baseVertices.push_back(command.baseVertex);
+	}
+	drawSubmeshes(mClusterFallback, 0, end - begin);
+}
 
-		// get vertex position
-		vertex.position[0] = mesh->mVertices[i].x;
-		vertex.position[1] = mesh->mVertices[i].y;
-		vertex.position[2] = mesh->mVertices[i].z;
+int SimpleModel::selectLod(const mat4& modelMatrix, const mat4& viewMatrix,
+	const mat4& projMatrix, float viewportHeight) const
+{
+	if (mMesh.drawLists.size() < 2)
+		return 0;
 
-		// get vertex normal
-		vertex.normal[0] = mesh->mNormals[i].x;
-		vertex.normal[1] = mesh->mNormals[i].y;
-		vertex.normal[2] = mesh->mNormals[i].z;
+	// bounding sphere centre in clip space (w is 1 for orthographic projections)
+	vec4 clipCenter = projMatrix * viewMatrix * modelMatrix * vec4(mMesh.center, 1.0f);
+	float w = std::max(std::abs(clipCenter.w), 1e-4f);
 
-		// append vertex data
-		vertices.push_back(vertex);
+	// largest scale applied by the model matrix
+	float scale = std::max(length(vec3(modelMatrix[0])),
+		std::max(length(vec3(modelMatrix[1])), length(vec3(modelMatrix[2]))));
+
+	// pixels covered by one object space unit at the centre of the mesh
+	float pixelsPerUnit = 0.5f * viewportHeight * projMatrix[1][1] * scale / w;
+
+	// coarsest level whose projected error stays below the tolerance
+	int lod = 0;
+	for (size_t i = 1; i < mMesh.drawLists.size(); i++)
+	{
+		if (mMesh.drawLists[i].error * pixelsPerUnit > mLodPixelError)
+			break;
+		lod = static_cast<int>(i);
 	}
 
-	// get face data
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	return lod;
+}
+
+void SimpleModel::buildLods(const GLfloat* positions, size_t numOfVertices, const unsigned int* submeshIndices,
+	size_t numOfIndices, unsigned int options, std::vector<GLuint>& indices, std::vector<MeshLod>& lods) const
+{
+	// full resolution level
+	MeshLod lod;
+	lod.firstIndex = static_cast<GLuint>(indices.size());
+	lod.numOfIndices = static_cast<GLsizei>(numOfIndices);
+	lods.push_back(lod);
+	indices.insert(indices.end(), submeshIndices, submeshIndices + numOfIndices);
+
+	// each level halves the triangle count of the previous one
+	std::vector<GLuint> current(submeshIndices, submeshIndices + numOfIndices);
+	std::vector<GLuint> simplified, optimized;
+	float error = 0.0f;
+
+	while (lods.size() < MAX_MESH_LODS)
 	{
-		for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+		size_t target = current.size() / 6 * 3;
+
+		// stop once the mesh gets too coarse to be worth another level
+		if (target < 3 * 32)
+			break;
+
+		// errors of successive levels add up relative to the full resolution mesh
+		error += simplifyMesh(simplified, current, positions, numOfVertices, 3 * sizeof(GLfloat), target, FLT_MAX);
+
+		// stop when locked seams and borders prevent further reduction
+		if (simplified.size() * 4 > current.size() * 3)
+			break;
+
+		// simplified levels get their own cache friendly triangle order
+		if (options & MODEL_OPTIMIZE_VERTEX_CACHE)
 		{
-			// append face index
-			indices.push_back(mesh->mFaces[i].mIndices[j]);
+			optimizeVertexCache(optimized, simplified, numOfVertices);
+			simplified.swap(optimized);
 		}
+
+		// append level to the shared index data
+		lod.firstIndex = static_cast<GLuint>(indices.size());
+		lod.numOfIndices = static_cast<GLsizei>(simplified.size());
+		lod.error = error;
+		lods.push_back(lod);
+
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		current.swap(simplified);
 	}
+}
 
-	// store total number of indices
-	mMesh.numOfIndices = static_cast<int>(indices.size());
+bool SimpleModel::loadMesh(const MeshData& mesh, const std::string& cacheFile, PreparedMesh& prepared) const
+{
+	// mesh data
+	std::vector<VertexNormal> vertices;
 
-	// generate identifier for VBOs and copy data to GPU
-	glGenBuffers(1, &mMesh.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(VertexNormal) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+	// check if mesh contains vertex coordinates, normals and faces
+	if (mesh.positions.empty() || mesh.normals.empty() || mesh.indices.empty())
+	{
+		return false;
+	}
 
-	// generate identifier for IBO and copy data to GPU
-	glGenBuffers(1, &mMesh.IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLint) * indices.size(), &indices[0], GL_STATIC_DRAW);
+	// get vertex data
+	for (size_t i = 0; i < mesh.numOfVertices(); i++)
+	{
+		VertexNormal vertex;	// for vertex data
 
-	// generate identifiers for VAO and supply information
-	glGenVertexArrays(1, &mMesh.VAO);
-	glBindVertexArray(mMesh.VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormal), reinterpret_cast<void*>(offsetof(VertexNormal, position)));
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormal), reinterpret_cast<void*>(offsetof(VertexNormal, normal)));
+		// get vertex position
+		vertex.position[0] = mesh.positions[i * 3];
+		vertex.position[1] = mesh.positions[i * 3 + 1];
+		vertex.position[2] = mesh.positions[i * 3 + 2];
 
-	// enable vertex attributes
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
+		// get vertex normal
+		vertex.normal[0] = mesh.normals[i * 3];
+		vertex.normal[1] = mesh.normals[i * 3 + 1];
+		vertex.normal[2] = mesh.normals[i * 3 + 2];
 
-	// unbind VAO
-	glBindVertexArray(0);
+		// append vertex data
+		vertices.push_back(vertex);
+	}
 
-	mIsValid = true;
+	// describe the interleaved vertex layout
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.stride = sizeof(VertexNormal);
+	header.numOfAttributes = 2;
+	header.attributes[0] = { 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormal, position) };
+	header.attributes[1] = { 1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormal, normal) };
+	header.numOfVertices = static_cast<uint32_t>(vertices.size());
+
+	storeMesh(mesh, header, vertices.data(), cacheFile, prepared);
+	return true;
 }
 
-void SimpleModel::loadMeshWithTexture(const aiMesh* mesh)
+bool SimpleModel::loadMeshWithTexture(const MeshData& mesh, const std::string& cacheFile, PreparedMesh& prepared) const
 {
 	// mesh data
 	std::vector<VertexNormTex> vertices;
-	std::vector<GLint> indices;
 
 	// check if mesh contains vertex coordinates, normals and faces
-	if (!mesh->HasPositions() || !mesh->HasNormals() || !mesh->HasFaces())
+	if (mesh.positions.empty() || mesh.normals.empty() || mesh.indices.empty())
 	{
-		mIsValid = false;
-		return;
+		return false;
 	}
-	// check if mesh contains texture coordinates (i.e. index 0)
-	if (mesh->HasTextureCoords(0))
+	// check if mesh contains texture coordinates
+	bool hasTexCoords = mesh.hasTexCoords();
+
+	// normal mapped layout
+	if (mesh.hasTangents())
 	{
-		mMesh.hasTexCoords = true;
+		std::vector<VertexNormTanTex> tangentVertices(mesh.numOfVertices());
+		for (size_t i = 0; i < tangentVertices.size(); i++)
+		{
+			std::copy_n(&mesh.positions[i * 3], 3, tangentVertices[i].position);
+			std::copy_n(&mesh.normals[i * 3], 3, tangentVertices[i].normal);
+			std::copy_n(&mesh.texCoords[i * 2], 2, tangentVertices[i].texCoord);
+			std::copy_n(&mesh.tangents[i * 4], 4, tangentVertices[i].tangent);
+		}
+
+		// describe the interleaved vertex layout
+		MeshCacheHeader header;
+		std::memset(&header, 0, sizeof(header));
+		header.stride = sizeof(VertexNormTanTex);
+		header.numOfAttributes = 4;
+		header.attributes[0] = { 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTanTex, position) };
+		header.attributes[1] = { 1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTanTex, normal) };
+		header.attributes[2] = { 2, 2, GL_FLOAT, GL_FALSE, offsetof(VertexNormTanTex, texCoord) };
+		header.attributes[3] = { 3, 4, GL_FLOAT, GL_FALSE, offsetof(VertexNormTanTex, tangent) };
+		header.numOfVertices = static_cast<uint32_t>(tangentVertices.size());
+		header.hasTexCoords = 1;
+
+		storeMesh(mesh, header, tangentVertices.data(), cacheFile, prepared);
+		return true;
 	}
 
 	// get vertex data
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	for (size_t i = 0; i < mesh.numOfVertices(); i++)
 	{
 		VertexNormTex vertex;	// for vertex data
 
 		// get vertex position
-		vertex.position[0] = mesh->mVertices[i].x;
-		vertex.position[1] = mesh->mVertices[i].y;
-		vertex.position[2] = mesh->mVertices[i].z;
+		vertex.position[0] = mesh.positions[i * 3];
+		vertex.position[1] = mesh.positions[i * 3 + 1];
+		vertex.position[2] = mesh.positions[i * 3 + 2];
 
 		// get vertex normal
-		vertex.normal[0] = mesh->mNormals[i].x;
-		vertex.normal[1] = mesh->mNormals[i].y;
-		vertex.normal[2] = mesh->mNormals[i].z;
+		vertex.normal[0] = mesh.normals[i * 3];
+		vertex.normal[1] = mesh.normals[i * 3 + 1];
+		vertex.normal[2] = mesh.normals[i * 3 + 2];
 
-		// get first vertex texture coordinate (i.e. index 0)
-		if (mMesh.hasTexCoords)
+		// get vertex texture coordinate
+		if (hasTexCoords)
 		{
-			vertex.texCoord[0] = mesh->mTextureCoords[0][i].x;
-			vertex.texCoord[1] = mesh->mTextureCoords[0][i].y;
+			vertex.texCoord[0] = mesh.texCoords[i * 2];
+			vertex.texCoord[1] = mesh.texCoords[i * 2 + 1];
 		}
 		else
 		{
@@ -174,45 +1100,423 @@ void SimpleModel::loadMeshWithTexture(const aiMesh* mesh)
 		vertices.push_back(vertex);
 	}
 
-	// get face data
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	// describe the interleaved vertex layout
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.stride = sizeof(VertexNormTex);
+	header.numOfAttributes = 3;
+	header.attributes[0] = { 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, position) };
+	header.attributes[1] = { 1, 3, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, normal) };
+	header.attributes[2] = { 2, 2, GL_FLOAT, GL_FALSE, offsetof(VertexNormTex, texCoord) };
+	header.numOfVertices = static_cast<uint32_t>(vertices.size());
+	header.hasTexCoords = hasTexCoords;
+
+	storeMesh(mesh, header, vertices.data(), cacheFile, prepared);
+	return true;
+}
+
+bool SimpleModel::loadPackedMesh(const MeshData& mesh, bool texture, const std::string& cacheFile,
+	PreparedMesh& prepared) const
+{
+	// check if mesh contains vertex coordinates, normals and faces
+	if (mesh.positions.empty() || mesh.normals.empty() || mesh.indices.empty())
 	{
-		for (unsigned int j = 0; j < mesh->mFaces[i].mNumIndices; j++)
+		return false;
+	}
+	bool hasTexCoords = texture && mesh.hasTexCoords();
+
+	// positions are stored relative to the bounding box
+	vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (size_t i = 0; i < mesh.numOfVertices(); i++)
+	{
+		vec3 position(mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2]);
+		boundsMin = min(boundsMin, position);
+		boundsMax = max(boundsMax, position);
+	}
+	vec3 extent = boundsMax - boundsMin;
+
+	QuantizationError error;
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.numOfVertices = static_cast<uint32_t>(mesh.numOfVertices());
+	header.hasTexCoords = hasTexCoords;
+	header.isQuantized = 1;
+	size_t floatStride;
+
+	if (!texture)
+	{
+		std::vector<PackedVertexNormal> vertices(mesh.numOfVertices());
+		for (size_t i = 0; i < vertices.size(); i++)
 		{
-			// append face index
-			indices.push_back(mesh->mFaces[i].mIndices[j]);
+			packPosition(&mesh.positions[i * 3], boundsMin, extent, vertices[i].position, error);
+			vertices[i].padding = 0;
+			vertices[i].normal = packNormal(&mesh.normals[i * 3], error);
 		}
+
+		// describe the packed vertex layout
+		header.stride = sizeof(PackedVertexNormal);
+		header.numOfAttributes = 2;
+		header.attributes[0] = { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertexNormal, position) };
+		header.attributes[1] = { 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertexNormal, normal) };
+		floatStride = sizeof(VertexNormal);
+
+		storeMesh(mesh, header, vertices.data(), cacheFile, prepared);
 	}
+	else if (mesh.hasTangents())
+	{
+		std::vector<PackedVertexNormTanTex> vertices(mesh.numOfVertices());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			packPosition(&mesh.positions[i * 3], boundsMin, extent, vertices[i].position, error);
+			vertices[i].padding = 0;
+			vertices[i].normal = packNormal(&mesh.normals[i * 3], error);
+			vertices[i].tangent = packNormal(&mesh.tangents[i * 4], error, mesh.tangents[i * 4 + 3]);
+
+			for (int k = 0; k < 2; k++)
+				vertices[i].texCoord[k] = packTexCoord(mesh.texCoords[i * 2 + k], error);
+		}
+
+		// describe the packed vertex layout
+		header.stride = sizeof(PackedVertexNormTanTex);
+		header.numOfAttributes = 4;
+		header.attributes[0] = { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertexNormTanTex, position) };
+		header.attributes[1] = { 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertexNormTanTex, normal) };
+		header.attributes[2] = { 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertexNormTanTex, texCoord) };
+		header.attributes[3] = { 3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertexNormTanTex, tangent) };
+		floatStride = sizeof(VertexNormTanTex);
+
+		storeMesh(mesh, header, vertices.data(), cacheFile, prepared);
+	}
+	else
+	{
+		std::vector<PackedVertexNormTex> vertices(mesh.numOfVertices());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			packPosition(&mesh.positions[i * 3], boundsMin, extent, vertices[i].position, error);
+			vertices[i].padding = 0;
+			vertices[i].normal = packNormal(&mesh.normals[i * 3], error);
+
+			for (int k = 0; k < 2; k++)
+				vertices[i].texCoord[k] = hasTexCoords ? packTexCoord(mesh.texCoords[i * 2 + k], error) : 0;
+		}
+
+		// describe the packed vertex layout
+		header.stride = sizeof(PackedVertexNormTex);
+		header.numOfAttributes = 3;
+		header.attributes[0] = { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertexNormTex, position) };
+		header.attributes[1] = { 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(PackedVertexNormTex, normal) };
+		header.attributes[2] = { 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertexNormTex, texCoord) };
+		floatStride = sizeof(VertexNormTex);
+
+		storeMesh(mesh, header, vertices.data(), cacheFile, prepared);
+	}
+
+	// report size and precision of the packed format
+	float size = std::max(extent.x, std::max(extent.y, extent.z));
+	std::cout << "Quantized vertices (" << floatStride << " -> " << header.stride << " bytes): max error position "
+		<< error.position << " (" << 100.0f * error.position / std::max(size, FLT_MIN) << "% of bounds), normal "
+		<< error.normal << " deg, texture coordinate " << error.texCoord << std::endl;
+	return true;
+}
+
+void SimpleModel::storeMesh(const MeshData& mesh, MeshCacheHeader& header, const void* vertices,
+	const std::string& cacheFile, PreparedMesh& prepared) const
+{
+	// bounding sphere around the centre of the bounding box
+	vec3 minPos(FLT_MAX), maxPos(-FLT_MAX);
+	for (size_t i = 0; i < mesh.numOfVertices(); i++)
+	{
+		vec3 position(mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2]);
+		minPos = min(minPos, position);
+		maxPos = max(maxPos, position);
+	}
+	vec3 center = 0.5f * (minPos + maxPos);
+	float radius = 0.0f;
+	for (size_t i = 0; i < mesh.numOfVertices(); i++)
+	{
+		vec3 position(mesh.positions[i * 3], mesh.positions[i * 3 + 1], mesh.positions[i * 3 + 2]);
+		radius = std::max(radius, length(position - center));
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		header.boundsMin[i] = minPos[i];
+		header.boundsMax[i] = maxPos[i];
+		header.center[i] = center[i];
+	}
+	header.radius = radius;
+
+	// submeshes sorted by material so each material is one run of draws
+	std::vector<size_t> order(mesh.submeshes.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&mesh](size_t a, size_t b)
+	{
+		return mesh.submeshes[a].materialIndex < mesh.submeshes[b].materialIndex;
+	});
+
+	// index data with all levels of detail of every submesh
+	std::vector<GLuint> indices;
+	std::vector<MeshCacheLod> lods;
+	std::vector<MeshCacheSubmesh> submeshes;
+	std::vector<MeshLod> submeshLods;
+	std::vector<Meshlet> meshlets;
+
+	for (size_t i : order)
+	{
+		const SubmeshData& submesh = mesh.submeshes[i];
+		if (submesh.numOfIndices == 0)
+			continue;
+
+		submeshLods.clear();
+		buildLods(&mesh.positions[submesh.firstVertex * 3], submesh.numOfVertices,
+			&mesh.indices[submesh.firstIndex], submesh.numOfIndices, prepared.options, indices, submeshLods);
+
+		// clusters of the full resolution level, moved to absolute index ranges
+		size_t firstMeshlet = meshlets.size();
+		if (prepared.options & MODEL_BUILD_MESHLETS)
+		{
+			buildMeshlets(meshlets, &indices[submeshLods[0].firstIndex], submesh.numOfIndices,
+				&mesh.positions[submesh.firstVertex * 3], submesh.numOfVertices, 3 * sizeof(GLfloat));
+			for (size_t j = firstMeshlet; j < meshlets.size(); j++)
+				meshlets[j].firstIndex += submeshLods[0].firstIndex;
+		}
+
+		submeshes.push_back({ static_cast<uint32_t>(submesh.firstVertex), submesh.materialIndex,
+			static_cast<uint32_t>(lods.size()), static_cast<uint32_t>(submeshLods.size()),
+			static_cast<uint32_t>(firstMeshlet), static_cast<uint32_t>(meshlets.size() - firstMeshlet) });
+		for (const MeshLod& lod : submeshLods)
+			lods.push_back({ lod.firstIndex, static_cast<uint32_t>(lod.numOfIndices), lod.error });
+	}
+
+	// material parameters (textures are left to the caller)
+	std::vector<MeshCacheMaterial> materials;
+	for (const MaterialData& source : mesh.materials)
+		materials.push_back(toCacheMaterial(source));
+
+	// narrowest index type addressing the vertices of every submesh
+	size_t maxSubmeshVertices = 0;
+	for (const SubmeshData& submesh : mesh.submeshes)
+		maxSubmeshVertices = std::max(maxSubmeshVertices, submesh.numOfVertices);
+
+	std::vector<GLushort> shortIndices;
+	if (maxSubmeshVertices <= MAX_SHORT_INDEX_VERTICES)
+	{
+		shortIndices.assign(indices.begin(), indices.end());
+		header.indexType = GL_UNSIGNED_SHORT;
+		header.indexBytes = shortIndices.size() * sizeof(GLushort);
+	}
+	else
+	{
+		header.indexType = GL_UNSIGNED_INT;
+		header.indexBytes = indices.size() * sizeof(GLuint);
+	}
+
+	header.numOfLods = static_cast<uint32_t>(lods.size());
+	header.numOfSubmeshes = static_cast<uint32_t>(submeshes.size());
+	header.numOfMaterials = static_cast<uint32_t>(materials.size());
+	header.numOfMeshlets = static_cast<uint32_t>(meshlets.size());
+	header.vertexBytes = static_cast<uint64_t>(header.numOfVertices) * header.stride;
+
+	MeshCacheData data;
+	data.vertices = vertices;
+	data.indices = header.indexType == GL_UNSIGNED_SHORT
+		? static_cast<const void*>(shortIndices.data()) : static_cast<const void*>(indices.data());
+	data.lods = lods.data();
+	data.submeshes = submeshes.data();
+	data.materials = materials.data();
+	data.meshlets = meshlets.data();
+
+	// keep processed mesh for the next load
+	if (!writeMeshCache(cacheFile, header, data))
+		std::cerr << "Unable to write mesh cache: " << cacheFile << std::endl;
 
-	// store total number of indices
-	mMesh.numOfIndices = indices.size();
+	// hand the processed arrays over for upload
+	const unsigned char* vertexBytes = static_cast<const unsigned char*>(data.vertices);
+	const unsigned char* indexBytes = static_cast<const unsigned char*>(data.indices);
+	prepared.vertices.assign(vertexBytes, vertexBytes + header.vertexBytes);
+	prepared.indices.assign(indexBytes, indexBytes + header.indexBytes);
+	prepared.lods.swap(lods);
+	prepared.submeshes.swap(submeshes);
+	prepared.materials.swap(materials);
+	prepared.meshlets.swap(meshlets);
 
-	// generate identifier for VBOs and copy data to GPU
+	prepared.header = header;
+	prepared.data.vertices = prepared.vertices.data();
+	prepared.data.indices = prepared.indices.data();
+	prepared.data.lods = prepared.lods.data();
+	prepared.data.submeshes = prepared.submeshes.data();
+	prepared.data.materials = prepared.materials.data();
+	prepared.data.meshlets = prepared.meshlets.data();
+}
+
+void SimpleModel::beginUpload()
+{
+	const MeshCacheHeader& header = mPending->header;
+	const MeshCacheData& data = mPending->data;
+
+	// submeshes with their levels of detail
+	mMesh.submeshes.clear();
+	size_t numOfLevels = 0;
+	for (uint32_t i = 0; i < header.numOfSubmeshes; i++)
+	{
+		const MeshCacheSubmesh& source = data.submeshes[i];
+		Submesh submesh;
+		submesh.baseVertex = static_cast<GLint>(source.baseVertex);
+		submesh.materialIndex = source.materialIndex;
+		submesh.firstMeshlet = source.firstMeshlet;
+		submesh.numOfMeshlets = source.numOfMeshlets;
+
+		for (uint32_t j = 0; j < source.numOfLods; j++)
+		{
+			const MeshCacheLod& cacheLod = data.lods[source.firstLod + j];
+			MeshLod lod;
+			lod.firstIndex = cacheLod.firstIndex;
+			lod.numOfIndices = static_cast<GLsizei>(cacheLod.numOfIndices);
+			lod.error = cacheLod.error;
+			submesh.lods.push_back(lod);
+		}
+
+		numOfLevels = std::max(numOfLevels, submesh.lods.size());
+		mMesh.submeshes.push_back(submesh);
+	}
+
+	mMesh.materials.clear();
+	for (uint32_t i = 0; i < header.numOfMaterials; i++)
+		mMesh.materials.push_back(toMaterial(data.materials[i]));
+
+	// meshlets with the base vertex of their submesh
+	mMesh.meshlets.assign(data.meshlets, data.meshlets + header.numOfMeshlets);
+	mMesh.meshletBaseVertices.assign(header.numOfMeshlets, 0);
+	for (const Submesh& submesh : mMesh.submeshes)
+	{
+		std::fill_n(mMesh.meshletBaseVertices.begin() + submesh.firstMeshlet, submesh.numOfMeshlets,
+			submesh.baseVertex);
+	}
+
+	// draw arguments per level; submeshes with fewer levels keep their coarsest one
+	size_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	mMesh.drawLists.assign(numOfLevels, MeshDrawList());
+	mMesh.numOfIndices = 0;
+
+	for (size_t level = 0; level < numOfLevels; level++)
+	{
+		MeshDrawList& drawList = mMesh.drawLists[level];
+		for (const Submesh& submesh : mMesh.submeshes)
+		{
+			const MeshLod& lod = submesh.lods[std::min(level, submesh.lods.size() - 1)];
+			drawList.counts.push_back(lod.numOfIndices);
+			drawList.offsets.push_back(reinterpret_cast<const void*>(lod.firstIndex * indexSize));
+			drawList.baseVertices.push_back(submesh.baseVertex);
+			drawList.error = std::max(drawList.error, lod.error);
+
+			if (level == 0)
+				mMesh.numOfIndices += lod.numOfIndices;
+		}
+	}
+
+	mMesh.indexType = header.indexType;
+	mMesh.hasTexCoords = header.hasTexCoords != 0;
+	mMesh.isQuantized = header.isQuantized != 0;
+	mMesh.hasTangents = false;
+	for (uint32_t i = 0; i < header.numOfAttributes; i++)
+		mMesh.hasTangents = mMesh.hasTangents || header.attributes[i].location == 3;
+	mMesh.boundsMin = vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	mMesh.boundsMax = vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	mMesh.center = vec3(header.center[0], header.center[1], header.center[2]);
+	mMesh.radius = header.radius;
+
+	// allocate buffers, their contents follow in slices
 	glGenBuffers(1, &mMesh.VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexNormTex), &vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mMesh.VBO);
+	createBuffer(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(header.vertexBytes));
 
-	// generate identifier for IBO and copy data to GPU
 	glGenBuffers(1, &mMesh.IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLint), &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mMesh.IBO);
+	createBuffer(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(header.indexBytes));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	mUploadedVertexBytes = 0;
+	mUploadedIndexBytes = 0;
+}
+
+bool SimpleModel::uploadSlices(double budget)
+{
+	const MeshCacheHeader& header = mPending->header;
+	const MeshCacheData& data = mPending->data;
+	auto startTime = std::chrono::steady_clock::now();
+
+	// vertices first, then indices, until the frame's budget is used up
+	bool done = false;
+	while (!done)
+	{
+		if (mUploadedVertexBytes < header.vertexBytes)
+			uploadSlice(mMesh.VBO, data.vertices, header.vertexBytes, mUploadedVertexBytes);
+		else if (mUploadedIndexBytes < header.indexBytes)
+			uploadSlice(mMesh.IBO, data.indices, header.indexBytes, mUploadedIndexBytes);
+
+		done = mUploadedVertexBytes == header.vertexBytes && mUploadedIndexBytes == header.indexBytes;
+
+		std::chrono::duration<double, std::milli> uploadTime = std::chrono::steady_clock::now() - startTime;
+		if (uploadTime.count() >= budget)
+			break;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (!done)
+		return false;
 
 	// generate identifiers for VAO and supply information
 	glGenVertexArrays(1, &mMesh.VAO);
 	glBindVertexArray(mMesh.VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, mMesh.VBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mMesh.IBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex), reinterpret_cast<void*>(offsetof(VertexNormTex, position)));
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex), reinterpret_cast<void*>(offsetof(VertexNormTex, normal)));
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexNormTex), reinterpret_cast<void*>(offsetof(VertexNormTex, texCoord)));
 
-	// enable vertex attributes
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
+	for (uint32_t i = 0; i < header.numOfAttributes; i++)
+	{
+		const MeshCacheAttribute& attribute = header.attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.size, attribute.type,
+			static_cast<GLboolean>(attribute.normalized), header.stride,
+			reinterpret_cast<void*>(static_cast<size_t>(attribute.offset)));
+
+		// enable vertex attribute
+		glEnableVertexAttribArray(attribute.location);
+	}
 
 	// unbind VAO
 	glBindVertexArray(0);
 
-	mIsValid = true;
+	// culled cluster draws are read from a buffer where indirect draws are supported
+	if (!mMesh.meshlets.empty() && GLEW_ARB_multi_draw_indirect)
+		glGenBuffers(1, &mClusterDraws.buffer);
+
+	// cache mapping or processed arrays are no longer needed
+	mPending.reset();
+	mIsValid = !mMesh.drawLists.empty();
+	return true;
+}
+
+void SimpleModel::releaseMesh()
+{
+	// the loader thread writes to this model until it finishes
+	if (mLoading.valid())
+	{
+		mLoading.wait();
+		mLoading = std::shared_future<bool>();
+	}
+
+	// delete mesh buffers
+	if (mMesh.VBO != 0)
+		glDeleteBuffers(1, &mMesh.VBO);
+	if (mMesh.IBO != 0)
+		glDeleteBuffers(1, &mMesh.IBO);
+	if (mMesh.VAO != 0)
+		glDeleteVertexArrays(1, &mMesh.VAO);
+	if (mClusterDraws.buffer != 0)
+		glDeleteBuffers(1, &mClusterDraws.buffer);
+
+	mMesh = Mesh();
+	mClusterDraws = ClusterDrawList();
+	mPending.reset();
+	mIsValid = false;
 }
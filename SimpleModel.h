@@ -5,21 +5,131 @@
 #include <assimp/scene.h>           // output data structure
 #include <assimp/postprocess.h>     // post processing flags
 
+#include <algorithm>
+#include <future>
+#include <memory>
+
 #include "utilities.h"
 #include "ShaderProgram.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "VertexWelder.h"
+
+// maximum number of levels of detail generated per mesh
+const unsigned int MAX_MESH_LODS = 5;
+
+// processing options of SimpleModel::loadModel
+enum ModelOptions
+{
+    MODEL_OPTIMIZE_VERTEX_CACHE = 1 << 0,   // reorder triangles for the post-transform cache
+    MODEL_OPTIMIZE_OVERDRAW = 1 << 1,       // sort triangle clusters to reduce overdraw (implies vertex cache)
+    MODEL_OPTIMIZE_VERTEX_FETCH = 1 << 2,   // reorder vertices in order of first use
+    MODEL_OPTIMIZE_ALL = MODEL_OPTIMIZE_VERTEX_CACHE | MODEL_OPTIMIZE_OVERDRAW | MODEL_OPTIMIZE_VERTEX_FETCH,
+    MODEL_QUANTIZE_VERTICES = 1 << 3,       // packed vertex formats (decoded in lightingAndTexture.vert)
+    MODEL_SPLIT_16BIT_INDICES = 1 << 4,     // split meshes too large for 16-bit indices into chunks
+    MODEL_BUILD_MESHLETS = 1 << 5,          // clusters of the full resolution mesh for per-view culling
+    MODEL_GENERATE_TANGENTS = 1 << 6,       // tangents for normal mapping (textured loads with texture coordinates)
+    MODEL_WELD_VERTICES = 1 << 7,           // native vertex welding and crease normals instead of assimp's (non-OBJ files)
+    MODEL_DEFAULT_OPTIONS = MODEL_OPTIMIZE_ALL | MODEL_QUANTIZE_VERTICES | MODEL_SPLIT_16BIT_INDICES
+        | MODEL_BUILD_MESHLETS | MODEL_GENERATE_TANGENTS | MODEL_WELD_VERTICES
+};
+
+// memory used by SimpleModel::loadModelStreaming unless given
+const size_t DEFAULT_STREAMING_BUDGET = 64 << 20;
+const size_t MIN_STREAMING_WINDOW = 1 << 20;
+
+// meshlets culled per parallelFor range
+const size_t CLUSTER_CULL_GRAIN = 256;
+
+// vertices addressable by 16-bit indices relative to a base vertex
+const size_t MAX_SHORT_INDEX_VERTICES = 65536;
+
+// range of the index buffer holding one level of detail
+struct MeshLod
+{
+    GLuint firstIndex = 0;      // offset into the index buffer (in indices)
+    GLsizei numOfIndices = 0;
+    float error = 0.0f;         // object space simplification error
+};
+
+// part of the mesh drawn with one material
+struct Submesh
+{
+    GLint baseVertex = 0;       // added to the submesh's indices
+    GLuint materialIndex = 0;
+    // levels of detail, lods[0] is the full resolution submesh
+    std::vector<MeshLod> lods;
+    // range of Mesh::meshlets covering lods[0]
+    GLuint firstMeshlet = 0;
+    GLuint numOfMeshlets = 0;
+};
+
+// glMultiDrawElementsBaseVertex arguments drawing every submesh at one level of detail
+struct MeshDrawList
+{
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+    float error = 0.0f;         // largest error of the submeshes at this level
+};
+
+// glMultiDrawElementsIndirect command layout
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// compacted draws of the clusters that survived culling for one view
+struct ClusterDrawList
+{
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<size_t> submeshOffsets;     // first command of each submesh, followed by the total
+    GLuint buffer = 0;                      // indirect draw buffer holding the commands (0 if unsupported)
+};
 
 struct Mesh
 {
-    // OpenGL buffer objects
+    // OpenGL buffer objects shared by all submeshes
     GLuint VBO = 0;
     GLuint IBO = 0;
     GLuint VAO = 0;
-    int numOfIndices = 0;
+    GLsizei numOfIndices = 0;
+    GLenum indexType = GL_UNSIGNED_INT;     // GL_UNSIGNED_SHORT when every submesh fits
     bool hasTexCoords = false;
+    bool isQuantized = false;
+    bool hasTangents = false;               // tangent attribute (location 3) for normal mapping
+    bool hasFaceNormals = false;            // no normal attribute, normals come from screen space derivatives
+    // submeshes sorted by material
+    std::vector<Submesh> submeshes;
+    std::vector<Material> materials;
+    // one draw list per level of detail, drawLists[0] is the full resolution mesh
+    std::vector<MeshDrawList> drawLists;
+    // clusters of the full resolution submeshes, index ranges are absolute
+    std::vector<Meshlet> meshlets;
+    std::vector<GLint> meshletBaseVertices;
+    // bounding box and sphere
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
 };
 
+// mesh processed on a loader thread, waiting for upload
+struct PreparedMesh;
+
 /*****************************************************************
- * simple model class that loads the first mesh of a model
+ * simple model class that loads all meshes of a model into one
+ * vertex and index buffer, drawn with one call per material
+ * (OBJ files are parsed natively, other formats use assimp, and
+ * processed meshes are cached next to the source file)
+ *
+ * models can be loaded on a worker thread; update() then uploads
+ * the buffers a slice at a time and the model draws nothing until
+ * the upload completes
  *****************************************************************/
 class SimpleModel
 {
@@ -27,15 +137,85 @@ public:
     SimpleModel();
     ~SimpleModel();
 
-    void loadModel(const char* filename, bool texture = false);
+    // load and upload a model, blocking until it can be drawn; returns false on failure
+    bool loadModel(const char* filename, bool texture = false, unsigned int options = MODEL_DEFAULT_OPTIONS);
+    // process a model on a loader thread; the future reports whether processing succeeded
+    std::shared_future<bool> loadModelAsync(const char* filename, bool texture = false,
+        unsigned int options = MODEL_DEFAULT_OPTIONS);
+    // upload processed mesh data for up to budget milliseconds (render thread)
+    // returns true once the model can be drawn
+    bool update(double budget);
+    // import an OBJ file too large for memory, parsing it in windows written straight
+    // into the GPU buffers; memory use stays around memoryBudget bytes
+    // (positions and normals only, no levels of detail or meshlets)
+    bool loadModelStreaming(const char* filename, size_t memoryBudget = DEFAULT_STREAMING_BUDGET);
+    bool isReady() const { return mIsValid; }
+
+    // draw the full resolution mesh
     void drawModel();
+    // draw the level of detail matching the projected screen size
+    void drawModel(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+        const glm::mat4& projMatrix, float viewportHeight);
+    // as above, setting the uMaterial uniforms of each material in the model
+    void drawModel(ShaderProgram& shader, const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+        const glm::mat4& projMatrix, float viewportHeight);
+    // set the uniforms decoding the vertex format (uQuantized, uPositionOffset, uPositionScale, uFaceNormals)
+    void setVertexDecoding(ShaderProgram& shader) const;
+    // select the coarsest level of detail within the pixel error tolerance
+    int selectLod(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+        const glm::mat4& projMatrix, float viewportHeight) const;
+    void setLodPixelError(float pixels) { mLodPixelError = pixels; }
+    // faces meeting at more than this angle (degrees) get separate normals when generated
+    void setCreaseAngle(float degrees) { mCreaseAngle = std::max(0.0f, std::min(180.0f, degrees)); }
+    // cull meshlets against each view when drawing the full resolution mesh
+    void setClusterCulling(bool enabled) { mClusterCulling = enabled; }
+    // clusters drawn by the last culled draw call
+    size_t getNumOfVisibleClusters() const { return mClusterDraws.commands.size(); }
+    size_t getNumOfClusters() const { return mMesh.meshlets.size(); }
+    size_t getNumOfMaterials() const { return mMesh.materials.size(); }
+    // bounding sphere of the model (model space)
+    const glm::vec3& getCenter() const { return mMesh.center; }
+    float getRadius() const { return mMesh.radius; }
+    // true if the model can be drawn with the normal mapped shader path
+    bool hasTangents() const { return mMesh.hasTangents; }
 
 private:
     bool mIsValid = false;
     Mesh mMesh;
+    float mLodPixelError = 1.0f;    // allowed screen space error (pixels)
+    float mCreaseAngle = DEFAULT_CREASE_ANGLE;
+
+    // per-view cluster culling
+    bool mClusterCulling = true;
+    ClusterDrawList mClusterDraws;
+    std::vector<unsigned char> mClusterVisibility;
+    std::vector<size_t> mClusterRangeOffsets;
+    MeshDrawList mClusterFallback;  // glMultiDrawElementsBaseVertex arguments without indirect draws
+
+    // asynchronous loading and sliced upload
+    std::shared_future<bool> mLoading;
+    std::unique_ptr<PreparedMesh> mPending;
+    uint64_t mUploadedVertexBytes = 0;
+    uint64_t mUploadedIndexBytes = 0;
 
-    void loadMesh(const aiMesh* mesh);
-    void loadMeshWithTexture(const aiMesh* mesh);
+    // processing (safe on a loader thread: reads no settings the render thread may change)
+    bool prepareModel(const std::string& filename, bool texture, unsigned int options, float creaseAngle,
+        PreparedMesh& prepared) const;
+    bool loadMesh(const MeshData& mesh, const std::string& cacheFile, PreparedMesh& prepared) const;
+    bool loadMeshWithTexture(const MeshData& mesh, const std::string& cacheFile, PreparedMesh& prepared) const;
+    bool loadPackedMesh(const MeshData& mesh, bool texture, const std::string& cacheFile,
+        PreparedMesh& prepared) const;
+    void storeMesh(const MeshData& mesh, MeshCacheHeader& header, const void* vertices,
+        const std::string& cacheFile, PreparedMesh& prepared) const;
+    // upload (render thread)
+    void beginUpload();
+    bool uploadSlices(double budget);
+    void releaseMesh();
+    void buildLods(const GLfloat* positions, size_t numOfVertices, const unsigned int* submeshIndices,
+        size_t numOfIndices, unsigned int options, std::vector<GLuint>& indices, std::vector<MeshLod>& lods) const;
+    void drawSubmeshes(const MeshDrawList& drawList, size_t first, size_t last) const;
+    void cullClusters(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, const glm::mat4& projMatrix);
+    void drawClusters(size_t first, size_t last);
 };
 
 #endif
@@ -0,0 +1,155 @@
+#include "TangentGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// triangles per parallel range
+	const size_t TANGENT_GRAIN = 1 << 14;
+
+	struct Vector3
+	{
+		float x, y, z;
+	};
+
+	Vector3 load(const std::vector<float>& values, size_t index)
+	{
+		return { values[index * 3], values[index * 3 + 1], values[index * 3 + 2] };
+	}
+
+	Vector3 operator+(const Vector3& a, const Vector3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector3 operator-(const Vector3& a, const Vector3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector3 operator*(const Vector3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+
+	float dot(const Vector3& a, const Vector3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	Vector3 cross(const Vector3& a, const Vector3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// zero vectors stay zero
+	Vector3 normalize(const Vector3& v)
+	{
+		float length = std::sqrt(dot(v, v));
+		return length > 0.0f ? v * (1.0f / length) : v;
+	}
+
+	// v with its component along the unit vector n removed
+	Vector3 project(const Vector3& v, const Vector3& n)
+	{
+		return v - n * dot(n, v);
+	}
+
+	// contribution of one triangle corner
+	struct CornerFrame
+	{
+		Vector3 tangent;
+		Vector3 bitangent;
+	};
+
+	// any unit vector perpendicular to n, for vertices without usable texture coordinates
+	Vector3 perpendicular(const Vector3& n)
+	{
+		Vector3 axis = std::abs(n.x) < 0.9f ? Vector3{ 1.0f, 0.0f, 0.0f } : Vector3{ 0.0f, 1.0f, 0.0f };
+		return normalize(project(axis, n));
+	}
+}
+
+void generateTangents(MeshData& mesh)
+{
+	size_t numOfTriangles = mesh.numOfTriangles();
+	size_t numOfVertices = mesh.numOfVertices();
+	mesh.tangents.assign(numOfVertices * 4, 0.0f);
+	if (!mesh.hasTexCoords() || numOfTriangles == 0)
+		return;
+
+	// absolute vertex of every corner
+	std::vector<unsigned int> corners(mesh.indices.size());
+	for (const SubmeshData& submesh : mesh.submeshes)
+	{
+		for (size_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.numOfIndices; i++)
+			corners[i] = static_cast<unsigned int>(submesh.firstVertex + mesh.indices[i]);
+	}
+
+	// texture space derivatives of each triangle, projected and angle weighted per corner
+	std::vector<CornerFrame> frames(corners.size());
+	parallelFor(0, numOfTriangles, TANGENT_GRAIN, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			const unsigned int* vertex = &corners[t * 3];
+			Vector3 p[3], n[3];
+			float u[3], v[3];
+			for (int k = 0; k < 3; k++)
+			{
+				p[k] = load(mesh.positions, vertex[k]);
+				n[k] = normalize(load(mesh.normals, vertex[k]));
+				u[k] = mesh.texCoords[vertex[k] * 2];
+				v[k] = mesh.texCoords[vertex[k] * 2 + 1];
+			}
+
+			Vector3 e1 = p[1] - p[0], e2 = p[2] - p[0];
+			float du1 = u[1] - u[0], dv1 = v[1] - v[0];
+			float du2 = u[2] - u[0], dv2 = v[2] - v[0];
+
+			// the magnitude is normalized away, only the orientation of the mapping matters
+			float det = du1 * dv2 - du2 * dv1;
+			float orientation = det < 0.0f ? -1.0f : 1.0f;
+			Vector3 tangent = normalize((e1 * dv2 - e2 * dv1) * orientation);
+			Vector3 bitangent = normalize((e2 * du1 - e1 * du2) * orientation);
+			if (det == 0.0f)
+				tangent = bitangent = Vector3{ 0.0f, 0.0f, 0.0f };
+
+			for (int k = 0; k < 3; k++)
+			{
+				Vector3 a = normalize(p[(k + 1) % 3] - p[k]);
+				Vector3 b = normalize(p[(k + 2) % 3] - p[k]);
+				float angle = std::acos(std::max(-1.0f, std::min(1.0f, dot(a, b))));
+
+				frames[t * 3 + k].tangent = normalize(project(tangent, n[k])) * angle;
+				frames[t * 3 + k].bitangent = normalize(project(bitangent, n[k])) * angle;
+			}
+		}
+	});
+
+	// corners of each vertex in compressed row form
+	std::vector<unsigned int> offsets(numOfVertices + 1, 0), vertexCorners(corners.size());
+	for (unsigned int vertex : corners)
+		offsets[vertex + 1]++;
+	for (size_t i = 0; i < numOfVertices; i++)
+		offsets[i + 1] += offsets[i];
+
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < corners.size(); i++)
+		vertexCorners[fill[corners[i]]++] = static_cast<unsigned int>(i);
+
+	// sum the corners of every vertex into an orthonormal tangent and handedness
+	parallelFor(0, numOfVertices, TANGENT_GRAIN, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			Vector3 tangent = { 0.0f, 0.0f, 0.0f }, bitangent = { 0.0f, 0.0f, 0.0f };
+			for (unsigned int j = offsets[i]; j < offsets[i + 1]; j++)
+			{
+				tangent = tangent + frames[vertexCorners[j]].tangent;
+				bitangent = bitangent + frames[vertexCorners[j]].bitangent;
+			}
+
+			Vector3 n = normalize(load(mesh.normals, i));
+			tangent = normalize(project(tangent, n));
+			if (dot(tangent, tangent) == 0.0f)
+				tangent = perpendicular(n);
+
+			mesh.tangents[i * 4] = tangent.x;
+			mesh.tangents[i * 4 + 1] = tangent.y;
+			mesh.tangents[i * 4 + 2] = tangent.z;
+			mesh.tangents[i * 4 + 3] = dot(cross(n, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+		}
+	});
+}
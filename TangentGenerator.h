@@ -0,0 +1,22 @@
+#ifndef TANGENT_GENERATOR_H
+#define TANGENT_GENERATOR_H
+
+#include "MeshData.h"
+
+/*****************************************************************
+ * per vertex tangent frames for normal mapping
+ *
+ * follows MikkTSpace's weighting: every triangle corner contributes
+ * its texture space tangent and bitangent, projected onto the plane
+ * of the vertex normal and weighted by the corner angle; the sign
+ * of the accumulated bitangent against cross(normal, tangent) gives
+ * the handedness (vertices are not split where it changes)
+ *
+ * corners are processed in parallel over triangle ranges and the
+ * sums in parallel over vertex ranges
+ *****************************************************************/
+
+// fill mesh.tangents (xyz and handedness per vertex); needs texture coordinates
+void generateTangents(MeshData& mesh);
+
+#endif
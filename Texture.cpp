@@ -1,8 +1,347 @@
 #include "Texture.h"
+#include "BitmapView.h"
+#include "CookedTexture.h"
+#include "EnvironmentPrefilter.h"
+#include "SamplerCache.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
 
 #define STB_IMAGE_IMPLEMENTATION   
 #include "stb_image.h"
 
+// image file read on a worker thread: a current cooked container, a mapped BMP uploaded
+// in place, else stb_image pixels (or their mip chain compressed, see Texture::setFormat)
+struct TextureSource
+{
+	std::string filename;
+
+	MappedFile cooked;
+	const CookedTextureHeader* header = nullptr;
+	const CookedTextureLevel* levels = nullptr;
+
+	MappedFile bitmapFile;
+	BitmapView bitmap;
+
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+
+	BlockFormat format = BLOCK_FORMAT_NONE;
+	std::vector<MipImage> compressedLevels;		// pixels of each level hold its blocks
+
+	double decodeTime = 0.0;	// milliseconds
+
+	~TextureSource()
+	{
+		if (pixels != nullptr)
+			stbi_image_free(pixels);
+	}
+
+	bool isValid() const
+	{
+		return header != nullptr || bitmap.pixels != nullptr || pixels != nullptr || !compressedLevels.empty();
+	}
+	// cooked and compressed sources bring their mip levels
+	bool hasMipLevels() const { return header != nullptr || !compressedLevels.empty(); }
+	// mip levels stored in the file or compressed (other decoded images have only the base level)
+	GLint numOfLevels() const
+	{
+		if (header != nullptr)
+			return header->numOfLevels;
+		return compressedLevels.empty() ? 1 : static_cast<GLint>(compressedLevels.size());
+	}
+};
+
+namespace
+{
+	// map an uncompressed BMP for upload straight from the file; the pages are
+	// touched here so the upload on the context thread does not fault them in
+	bool mapBitmap(TextureSource& source)
+	{
+		if (!source.bitmapFile.open(source.filename)
+			|| !viewBitmap(source.bitmapFile.data(), source.bitmapFile.size(), source.bitmap))
+		{
+			source.bitmapFile.close();
+			source.bitmap = BitmapView();
+			return false;
+		}
+
+		const size_t PAGE_SIZE = 4096;
+		unsigned char touched = 0;
+		for (size_t offset = 0; offset < source.bitmapFile.size(); offset += PAGE_SIZE)
+			touched ^= source.bitmapFile.data()[offset];
+		volatile unsigned char sink = touched;
+		(void)sink;
+		return true;
+	}
+
+	// filter the decoded image's mip chain and compress every level
+	void compressSource(TextureSource& source, BlockFormat format, bool wrap)
+	{
+		MipImage image;
+		image.width = source.width;
+		image.height = source.height;
+		image.numOfChannels = source.channels;
+		image.pixels.assign(source.pixels, source.pixels + static_cast<size_t>(source.width) * source.height * source.channels);
+		stbi_image_free(source.pixels);
+		source.pixels = nullptr;
+
+		unsigned int flags = (format == BLOCK_FORMAT_BC5 ? MIP_NORMAL_MAP : MIP_SRGB) | (wrap ? MIP_WRAP : 0);
+		generateMipChain(image, MIP_FILTER_BOX, flags, source.compressedLevels);
+		for (MipImage& level : source.compressedLevels)
+		{
+			std::vector<unsigned char> blocks;
+			compressImage(level, format, blocks);
+			level.pixels.swap(blocks);
+		}
+		source.format = format;
+	}
+
+	// map a cooked container matching the image, or decode the image itself
+	// (compressed to format if the context can sample it, wrap for GL_REPEAT textures)
+	std::unique_ptr<TextureSource> readSource(const std::string& filename, BlockFormat format, bool wrap)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		std::unique_ptr<TextureSource> source(new TextureSource());
+		source->filename = filename;
+
+		// cooked blocks the context cannot sample are decoded from the image instead
+		source->header = openCookedImage(source->cooked, filename, source->levels);
+		if (source->header != nullptr && source->header->blockFormat != BLOCK_FORMAT_NONE
+			&& blockInternalFormat(static_cast<BlockFormat>(source->header->blockFormat)) == 0)
+		{
+			source->cooked.close();
+			source->header = nullptr;
+			source->levels = nullptr;
+		}
+		if (source->header != nullptr)
+			source->format = static_cast<BlockFormat>(source->header->blockFormat);
+
+		// images to compress need decoded RGB texels, other BMPs are uploaded from the mapping
+		bool compress = blockInternalFormat(format) != 0;
+		if (source->header == nullptr && cookedTexturePath(filename) != filename && (compress || !mapBitmap(*source)))
+		{
+			source->pixels = stbi_load(filename.c_str(), &source->width, &source->height, &source->channels, 0);
+			if (source->pixels != nullptr && compress)
+				compressSource(*source, format, wrap);
+		}
+
+		std::chrono::duration<double, std::milli> decodeTime = std::chrono::steady_clock::now() - startTime;
+		source->decodeTime = decodeTime.count();
+		return source;
+	}
+
+	// upload the levels of one face of a source to a 2D target or cube face
+	// (srgb: colour is stored as sRGB, see Texture::setSrgb)
+	void uploadSource(GLenum target, const TextureSource& source, uint32_t face, bool srgb)
+	{
+		// BMP rows are BGR(A) padded to four bytes, bottom row first like GL's;
+		// the fourth byte of 32-bit BI_RGB texels is unused
+		if (source.bitmap.pixels != nullptr)
+		{
+			const BitmapView& bitmap = source.bitmap;
+			GLint unpackAlignment, unpackRowLength;
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+			glGetIntegerv(GL_UNPACK_ROW_LENGTH, &unpackRowLength);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, bitmap.width);
+
+			glTexImage2D(target, 0, texelInternalFormat(3, srgb), bitmap.width, bitmap.height, 0,
+				bitmap.bitsPerPixel == 32 ? GL_BGRA : GL_BGR, GL_UNSIGNED_BYTE, bitmap.pixels);
+
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, unpackRowLength);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+			return;
+		}
+
+		// stb_image rows are tightly packed with as many channels as the file has
+		if (source.pixels != nullptr)
+		{
+			GLint unpackAlignment;
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+			glTexImage2D(target, 0, texelInternalFormat(source.channels, srgb), source.width, source.height, 0,
+				texelFormat(source.channels), GL_UNSIGNED_BYTE, source.pixels);
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+			return;
+		}
+
+		// cooked data texcook filtered as vectors or linear values is never sRGB
+		if (source.header != nullptr && (source.header->flags & MIP_SRGB) == 0)
+			srgb = false;
+		GLenum internalFormat = blockInternalFormat(source.format, srgb && source.format != BLOCK_FORMAT_BC5);
+		for (size_t level = 0; level < source.compressedLevels.size(); level++)
+		{
+			const MipImage& blocks = source.compressedLevels[level];
+			glCompressedTexImage2D(target, static_cast<GLint>(level), internalFormat, blocks.width, blocks.height, 0,
+				static_cast<GLsizei>(blocks.pixels.size()), blocks.pixels.data());
+		}
+		if (!source.compressedLevels.empty())
+			return;
+
+		GLenum format = texelFormat(source.header->numOfChannels);
+		GLenum texelInternal = texelInternalFormat(source.header->numOfChannels, srgb);
+
+		// cooked rows are tightly packed
+		GLint unpackAlignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		for (uint32_t level = 0; level < source.header->numOfLevels; level++)
+		{
+			const CookedTextureLevel& record = source.levels[level * source.header->numOfFaces + face];
+			if (internalFormat != 0)
+			{
+				glCompressedTexImage2D(target, level, internalFormat, record.width, record.height, 0,
+					static_cast<GLsizei>(record.bytes), source.cooked.data() + record.offset);
+			}
+			else
+			{
+				glTexImage2D(target, level, texelInternal, record.width, record.height, 0, format, GL_UNSIGNED_BYTE,
+					source.cooked.data() + record.offset);
+			}
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+	}
+
+	// channels of the texels a source uploads (blocks have none to swizzle)
+	int sourceChannels(const TextureSource& source)
+	{
+		if (source.bitmap.pixels != nullptr)
+			return 3;
+		if (source.pixels != nullptr)
+			return source.channels;
+		if (source.header != nullptr && source.header->blockFormat == BLOCK_FORMAT_NONE)
+			return static_cast<int>(source.header->numOfChannels);
+		return 4;
+	}
+
+	// 8-bit RGB(A) base level of one face of a source, false for compressed data
+	bool sourceImage(const TextureSource& source, uint32_t face, MipImage& image)
+	{
+		if (source.bitmap.pixels != nullptr)
+		{
+			// BGR(A) rows padded to four bytes
+			const BitmapView& bitmap = source.bitmap;
+			int channels = bitmap.bitsPerPixel / 8;
+			image.width = bitmap.width;
+			image.height = bitmap.height;
+			image.numOfChannels = channels;
+			image.pixels.resize(static_cast<size_t>(bitmap.width) * bitmap.height * channels);
+			for (int y = 0; y < bitmap.height; y++)
+			{
+				const unsigned char* row = bitmap.pixels + y * bitmap.rowBytes;
+				unsigned char* destination = &image.pixels[static_cast<size_t>(y) * bitmap.width * channels];
+				for (int x = 0; x < bitmap.width * channels; x += channels)
+				{
+					destination[x] = row[x + 2];
+					destination[x + 1] = row[x + 1];
+					destination[x + 2] = row[x];
+					if (channels == 4)
+						destination[x + 3] = row[x + 3];
+				}
+			}
+			return true;
+		}
+
+		if (source.pixels != nullptr)
+		{
+			image.width = source.width;
+			image.height = source.height;
+			image.numOfChannels = source.channels;
+			image.pixels.assign(source.pixels, source.pixels + static_cast<size_t>(source.width) * source.height * source.channels);
+			return true;
+		}
+
+		if (source.header != nullptr && source.header->blockFormat == BLOCK_FORMAT_NONE)
+		{
+			const CookedTextureLevel& record = source.levels[face];
+			const unsigned char* texels = source.cooked.data() + record.offset;
+			image.width = record.width;
+			image.height = record.height;
+			image.numOfChannels = source.header->numOfChannels;
+			image.pixels.assign(texels, texels + record.bytes);
+			return true;
+		}
+
+		return false;
+	}
+
+	// GGX levels of a cube map, false if a face cannot be read or the faces are not square and alike
+	bool prefilterSource(const TextureSource* const faces[6], std::vector<std::vector<MipImage>>& levels)
+	{
+		MipImage images[6];
+		const MipImage* imagePointers[6];
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			bool isCubeFile = faces[face]->header != nullptr && faces[face]->header->numOfFaces == 6;
+			if (!sourceImage(*faces[face], isCubeFile ? face : 0, images[face])
+				|| images[face].width != images[face].height || images[face].width != images[0].width)
+				return false;
+			imagePointers[face] = &images[face];
+		}
+
+		prefilterEnvironment(imagePointers, MIP_SRGB, DEFAULT_PREFILTER_SAMPLES, levels);
+		return true;
+	}
+
+}
+
+GLenum blockInternalFormat(BlockFormat format, bool srgb)
+{
+	// RGTC is core since OpenGL 3.0, S3TC an extension every desktop driver exposes
+	// (its sRGB formats come with EXT_texture_sRGB)
+	srgb = srgb && GLEW_EXT_texture_sRGB;
+	switch (format)
+	{
+	case BLOCK_FORMAT_BC1:
+		if (!GLEW_EXT_texture_compression_s3tc)
+			return 0;
+		return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case BLOCK_FORMAT_BC3:
+		if (!GLEW_EXT_texture_compression_s3tc)
+			return 0;
+		return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BLOCK_FORMAT_BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	default:
+		return 0;
+	}
+}
+
+GLenum texelFormat(int numOfChannels)
+{
+	static const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	return formats[numOfChannels - 1];
+}
+
+GLenum texelInternalFormat(int numOfChannels, bool srgb)
+{
+	// sRGB applies to colour, grey images are kept linear
+	static const GLenum formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+	if (srgb && numOfChannels == 3)
+		return GL_SRGB8;
+	if (srgb && numOfChannels == 4)
+		return GL_SRGB8_ALPHA8;
+	return formats[numOfChannels - 1];
+}
+
+void setTexelSwizzle(GLenum target, int numOfChannels)
+{
+	if (numOfChannels > 2)
+		return;
+	GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, numOfChannels == 2 ? GL_GREEN : GL_ONE };
+	glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
 Texture::Texture()
 {
 	stbi_set_flip_vertically_on_load(true); // flip image about y-axis
@@ -19,60 +358,99 @@ Texture::~Texture()
 	}
 }
 
-void Texture::bind()
+void Texture::bind(GLuint unit)
 {
+	glActiveTexture(GL_TEXTURE0 + unit);
+
 	// if texture exists
 	if (mTextureID != 0)
 	{
 		glBindTexture(mTarget, mTextureID);
+
+		// parameters live in a sampler shared with textures sampled alike
+		if (mSampler == 0)
+			mSampler = SamplerCache::shared().get({ mMagFilter, mMinFilter, mWrapS, mWrapT });
+		glBindSampler(unit, mSampler);
 	}
 }
 
 void Texture::setFilterParams(GLuint magFilter, GLuint minFilter)
 {
-	// parameter settings
-	GLuint mMagFilter = magFilter;
-	GLuint mMinFilter = minFilter;
-
-	// change filters if texture exists
-	if (mTextureID != 0)
-	{
-		glBindTexture(GL_TEXTURE_2D, mTextureID);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mMagFilter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mMinFilter);
-	}
+	// parameter settings, picked up by the next bind
+	mMagFilter = magFilter;
+	mMinFilter = minFilter;
+	mSampler = 0;
 }
 
 void Texture::setWrapParams(GLuint wrapS, GLuint wrapT)
 {
-	// parameter settings
-	GLuint mWrapS = wrapS;
-	GLuint mWrapT = wrapT;
-
-	// change wrap mode if texture exists
-	if (mTextureID != 0)
-	{
-		glBindTexture(GL_TEXTURE_2D, mTextureID);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, mWrapS);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, mWrapT);
-	}
+	// parameter settings, picked up by the next bind
+	mWrapS = wrapS;
+	mWrapT = wrapT;
+	mSampler = 0;
 }
 
 // generate a 2D texture from image data
-void Texture::generate(unsigned char* imageData, int width, int height)
+void Texture::generate(unsigned char* imageData, int width, int height, int numOfChannels)
 {
 	// generate texture
 	glGenTextures(1, &mTextureID);
 	glBindTexture(GL_TEXTURE_2D, mTextureID);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+	GLint unpackAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, texelInternalFormat(numOfChannels, mSrgb), width, height, 0,
+		texelFormat(numOfChannels), GL_UNSIGNED_BYTE, imageData);
 	glGenerateMipmap(GL_TEXTURE_2D);
+	mNumOfLevels = numOfMipLevels(width, height);
 
-	// set texture parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mMagFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mMinFilter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, mWrapS);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, mWrapT);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+	setTexelSwizzle(GL_TEXTURE_2D, numOfChannels);
+
+	// set texture target
+	mTarget = GL_TEXTURE_2D;
+}
+
+// generate a 2D texture from a mip chain in memory
+void Texture::generate(const std::vector<MipImage>& levels, BlockFormat format)
+{
+	if (levels.empty())
+		return;
+
+	// generate texture
+	glGenTextures(1, &mTextureID);
+	glBindTexture(GL_TEXTURE_2D, mTextureID);
+
+	// rows are tightly packed
+	GLint unpackAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	GLenum pixelFormat = texelFormat(levels[0].numOfChannels);
+	GLenum internalFormat = format != BLOCK_FORMAT_NONE ? blockInternalFormat(format, mSrgb && format != BLOCK_FORMAT_BC5)
+		: texelInternalFormat(levels[0].numOfChannels, mSrgb);
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		const MipImage& image = levels[level];
+		if (format != BLOCK_FORMAT_NONE)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, image.width, image.height, 0,
+				static_cast<GLsizei>(image.pixels.size()), image.pixels.data());
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, image.width, image.height, 0,
+				pixelFormat, GL_UNSIGNED_BYTE, image.pixels.data());
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size()) - 1);
+	mNumOfLevels = static_cast<int>(levels.size());
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+	if (format == BLOCK_FORMAT_NONE)
+		setTexelSwizzle(GL_TEXTURE_2D, levels[0].numOfChannels);
 
 	// set texture target
 	mTarget = GL_TEXTURE_2D;
@@ -81,86 +459,226 @@ void Texture::generate(unsigned char* imageData, int width, int height)
 // generate a 2D texture from an image file
 void Texture::generate(const std::string filename)
 {
-	// load image data
-	int width, height, channels;
-	unsigned char* imageData = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+	TextureBatch batch;
+	batch.add(*this, filename);
+	batch.load();
+}
+
+void Texture::generate(const std::string fileFront, const std::string fileBack,
+	const std::string fileLeft, const std::string fileRight,
+	const std::string fileTop, const std::string fileBottom)
+{
+	TextureBatch batch;
+	batch.addCubeMap(*this, fileFront, fileBack, fileLeft, fileRight, fileTop, fileBottom);
+	batch.load();
+}
+
+void Texture::generate2D(const TextureSource& source)
+{
+	if (!source.isValid())
+	{
+		std::cout << "Unable to load: " << source.filename << std::endl;
+		return;
+	}
 
-	// if successfully loaded image
-	if (imageData)
+	// a cooked cube map given directly
+	if (source.header != nullptr && source.header->numOfFaces == 6)
 	{
-		// generate texture
-		glGenTextures(1, &mTextureID);
-		glBindTexture(GL_TEXTURE_2D, mTextureID);
+		const TextureSource* faces[6] = { &source, &source, &source, &source, &source, &source };
+		generateCube(faces);
+		return;
+	}
+
+	// generate texture
+	glGenTextures(1, &mTextureID);
+	glBindTexture(GL_TEXTURE_2D, mTextureID);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageData);
+	// cooked and compressed textures bring their mip levels, decoded images get them generated
+	uploadSource(GL_TEXTURE_2D, source, 0, mSrgb);
+	setTexelSwizzle(GL_TEXTURE_2D, sourceChannels(source));
+	if (source.hasMipLevels())
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, source.numOfLevels() - 1);
+		mNumOfLevels = source.numOfLevels();
+	}
+	else
+	{
 		glGenerateMipmap(GL_TEXTURE_2D);
+		mNumOfLevels = source.bitmap.pixels != nullptr ? numOfMipLevels(source.bitmap.width, source.bitmap.height)
+			: numOfMipLevels(source.width, source.height);
+	}
 
-		// set texture parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mMagFilter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mMinFilter);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, mWrapS);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, mWrapT);
+	// set texture target
+	mTarget = GL_TEXTURE_2D;
+}
 
-		// free image data
-		stbi_image_free(imageData);
+void Texture::generateCube(const TextureSource* const faces[6])
+{
+	// if successfully loaded cubemap images
+	for (int face = 0; face < 6; face++)
+	{
+		if (!faces[face]->isValid())
+		{
+			std::cout << "Unable to load cubemap image: " << faces[face]->filename << std::endl;
+			return;
+		}
+	}
+
+	// generate texture
+	glGenTextures(1, &mTextureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, mTextureID);
 
-		// set texture target
-		mTarget = GL_TEXTURE_2D;
+	// a cube container holds all faces, otherwise each source is one face
+	GLint numOfLevels = faces[0]->numOfLevels();
+	for (uint32_t face = 0; face < 6; face++)
+	{
+		const TextureSource& source = *faces[face];
+		bool isCubeFile = source.header != nullptr && source.header->numOfFaces == 6;
+		uploadSource(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, source, isCubeFile ? face : 0, mSrgb);
+		numOfLevels = std::min(numOfLevels, source.numOfLevels());
 	}
-	else
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, numOfLevels - 1);
+	setTexelSwizzle(GL_TEXTURE_CUBE_MAP, sourceChannels(*faces[0]));
+	mNumOfLevels = numOfLevels;
+
+	// cube map faces as the environment map expects them
+	// (levels are sampled with textureLod, GL_TEXTURE_CUBE_MAP_SEAMLESS filters across faces)
+	setFilterParams(GL_LINEAR, numOfLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	setWrapParams(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+	// set texture target
+	mTarget = GL_TEXTURE_CUBE_MAP;
+}
+
+void Texture::generateCube(const std::vector<std::vector<MipImage>>& faces)
+{
+	// generate texture
+	glGenTextures(1, &mTextureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, mTextureID);
+
+	// rows are tightly packed
+	GLint unpackAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (uint32_t face = 0; face < 6; face++)
 	{
-		std::cout << "Unable to load: " << filename << std::endl;
+		for (size_t level = 0; level < faces[face].size(); level++)
+		{
+			const MipImage& image = faces[face][level];
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, static_cast<GLint>(level),
+				texelInternalFormat(image.numOfChannels, mSrgb), image.width, image.height, 0,
+				texelFormat(image.numOfChannels), GL_UNSIGNED_BYTE, image.pixels.data());
+		}
 	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+	GLint numOfLevels = static_cast<GLint>(faces[0].size());
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, numOfLevels - 1);
+	setTexelSwizzle(GL_TEXTURE_CUBE_MAP, faces[0][0].numOfChannels);
+	mNumOfLevels = numOfLevels;
+
+	// cube map faces as the environment map expects them
+	// (levels are sampled with textureLod, GL_TEXTURE_CUBE_MAP_SEAMLESS filters across faces)
+	setFilterParams(GL_LINEAR, numOfLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	setWrapParams(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+	// set texture target
+	mTarget = GL_TEXTURE_CUBE_MAP;
 }
 
-void Texture::generate(const std::string fileFront, const std::string fileBack,
-	const std::string fileLeft, const std::string fileRight,
-	const std::string fileTop, const std::string fileBottom)
+void TextureBatch::add(Texture& texture, const std::string& filename)
+{
+	mEntries.push_back({ &texture, { filename } });
+}
+
+void TextureBatch::addCubeMap(Texture& texture, const std::string& fileFront, const std::string& fileBack,
+	const std::string& fileLeft, const std::string& fileRight,
+	const std::string& fileTop, const std::string& fileBottom)
 {
-	// load image data
-	// assume images are the same size
-	int width, height, channels;
-	unsigned char* imageFront = stbi_load(fileFront.c_str(), &width, &height, &channels, 0);
-	unsigned char* imageBack = stbi_load(fileBack.c_str(), &width, &height, &channels, 0);
-	unsigned char* imageLeft = stbi_load(fileLeft.c_str(), &width, &height, &channels, 0);
-	unsigned char* imageRight = stbi_load(fileRight.c_str(), &width, &height, &channels, 0);
-	unsigned char* imageTop = stbi_load(fileTop.c_str(), &width, &height, &channels, 0);
-	unsigned char* imageBottom = stbi_load(fileBottom.c_str(), &width, &height, &channels, 0);
+	// +x right, -x left, +y top, -y bottom, +z back, -z front
+	mEntries.push_back({ &texture, { fileRight, fileLeft, fileTop, fileBottom, fileBack, fileFront } });
+}
 
-	// if successfully loaded cubemap images
-	if (imageFront && imageBack && imageLeft && imageRight && imageTop && imageBottom)
-	{
-		// generate texture
-		glGenTextures(1, &mTextureID);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, mTextureID);
-
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageRight);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_X, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageLeft);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Y, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageTop);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageBottom);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_Z, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageBack);
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, imageFront);
-
-		// set texture parameters
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-		// free image data
-		stbi_image_free(imageFront);
-		stbi_image_free(imageBack);
-		stbi_image_free(imageLeft);
-		stbi_image_free(imageRight);
-		stbi_image_free(imageTop);
-		stbi_image_free(imageBottom);
-
-		// set texture target
-		mTarget = GL_TEXTURE_CUBE_MAP;
+void TextureBatch::load()
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	// queue every image before waiting on any
+	std::vector<std::vector<std::future<std::unique_ptr<TextureSource>>>> decodes(mEntries.size());
+	size_t numOfImages = 0;
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		BlockFormat format = mEntries[i].texture->mFormat;
+		bool wrap = mEntries[i].texture->mWrapS == GL_REPEAT;
+		for (const std::string& file : mEntries[i].files)
+		{
+			decodes[i].push_back(ThreadPool::shared().submit([file, format, wrap]() { return readSource(file, format, wrap); }));
+			numOfImages++;
+		}
 	}
-	else
+
+	// upload in order, each texture as soon as its images are ready
+	double decodeTime = 0.0, prefilterTime = 0.0, uploadTime = 0.0;
+	for (size_t i = 0; i < mEntries.size(); i++)
 	{
-		std::cout << "Unable to load cubemap images starting with: " << fileFront << std::endl;
+		std::vector<std::unique_ptr<TextureSource>> sources;
+		for (std::future<std::unique_ptr<TextureSource>>& decode : decodes[i])
+		{
+			sources.push_back(decode.get());
+			decodeTime += sources.back()->decodeTime;
+		}
+
+		auto uploadStart = std::chrono::steady_clock::now();
+		if (sources.size() == 6)
+		{
+			// a cube file cooked for one face holds all six
+			const TextureSource* faces[6];
+			const TextureSource* cubeFile = nullptr;
+			for (int face = 0; face < 6; face++)
+			{
+				faces[face] = sources[face].get();
+				if (faces[face]->header != nullptr && faces[face]->header->numOfFaces == 6)
+					cubeFile = faces[face];
+			}
+			if (cubeFile != nullptr)
+				std::fill(faces, faces + 6, cubeFile);
+
+			// GGX levels are filtered here (in parallel) unless texcook did it
+			Texture& texture = *mEntries[i].texture;
+			std::vector<std::vector<MipImage>> prefiltered;
+			if (texture.mPrefiltered && (cubeFile == nullptr || (cubeFile->header->flags & MIP_GGX) == 0))
+			{
+				auto prefilterStart = std::chrono::steady_clock::now();
+				if (!prefilterSource(faces, prefiltered))
+					std::cout << "Unable to prefilter cubemap: " << faces[0]->filename << std::endl;
+				std::chrono::duration<double, std::milli> entryPrefilterTime = std::chrono::steady_clock::now() - prefilterStart;
+				prefilterTime += entryPrefilterTime.count();
+				uploadStart = std::chrono::steady_clock::now();
+			}
+
+			if (!prefiltered.empty())
+				texture.generateCube(prefiltered);
+			else
+				texture.generateCube(faces);
+		}
+		else
+		{
+			mEntries[i].texture->generate2D(*sources[0]);
+		}
+
+		std::chrono::duration<double, std::milli> entryUploadTime = std::chrono::steady_clock::now() - uploadStart;
+		uploadTime += entryUploadTime.count();
 	}
+
+	// report decode time (summed over the workers) against upload time on this thread
+	std::chrono::duration<double, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Loaded " << numOfImages << " texture images in " << loadTime.count() << " ms (decoding "
+		<< decodeTime << " ms on " << ThreadPool::shared().size() << " threads, ";
+	if (prefilterTime > 0.0)
+		std::cout << "prefiltering " << prefilterTime << " ms, ";
+	std::cout << "uploading " << uploadTime << " ms)" << std::endl;
+
+	mEntries.clear();
 }
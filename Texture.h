@@ -1,29 +1,67 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
 #include "utilities.h"
 
+#include <string>
+#include <vector>
+
+// image file read on a worker thread (defined in Texture.cpp)
+struct TextureSource;
+
 class Texture
 {
 public:
 	Texture();
 	~Texture();
 
-	// binds the texture for use
-	void bind();
-	// set texture parameters
+	// a texture owns its GL object, so it cannot be copied (share it through TextureRegistry)
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+
+	// binds the texture and its sampler to a texture unit for use
+	void bind(GLuint unit);
+	// set sampling parameters (a shared sampler with them is bound next time, see SamplerCache)
 	void setFilterParams(GLuint magFilter, GLuint minFilter);
 	void setWrapParams(GLuint wrapS, GLuint wrapT);
-	// generate a 2D texture from image data
-	void generate(unsigned char* imageData, int width, int height);
+	// store colour as sRGB so the GPU decodes it to linear when sampling (set before
+	// generating; data textures and cooked files filtered without MIP_SRGB stay linear)
+	void setSrgb(bool srgb) { mSrgb = srgb; }
+	// compress images decoded from image files (set before generating; cooked files
+	// keep the format texcook wrote, BC5 is meant for normal maps)
+	void setFormat(BlockFormat format) { mFormat = format; }
+	// cube maps: filter the mip levels for GGX reflections, level i for roughness
+	// i / (levels - 1) (see EnvironmentPrefilter.h); cube files cooked with texcook --ggx
+	// are uploaded as they are (set before generating)
+	void setPrefiltered(bool prefiltered) { mPrefiltered = prefiltered; }
+	// mip levels of the generated texture
+	int getNumOfLevels() const { return mNumOfLevels; }
+	// generate a 2D texture from image data (tightly packed rows)
+	void generate(unsigned char* imageData, int width, int height, int numOfChannels = 3);
+	// generate a 2D texture from a mip chain in memory (levels[0] is the base level),
+	// whose pixels are compressed blocks unless format is BLOCK_FORMAT_NONE
+	void generate(const std::vector<MipImage>& levels, BlockFormat format = BLOCK_FORMAT_NONE);
 	// generate a 2D texture from an image file
+	// (a cooked .ctex next to the image or given directly is uploaded with its mip levels)
 	void generate(const std::string filename);
-	// generate a cube environment map from image files
+	// generate a cube environment map from image files (faces are decoded concurrently)
 	void generate(const std::string fileFront, const std::string fileBack,
 		const std::string fileLeft, const std::string fileRight,
 		const std::string fileTop, const std::string fileBottom);
 
 private:
+	friend class TextureBatch;
+	friend class TextureStreamer;
+
+	// create the texture from images read by TextureBatch
+	void generate2D(const TextureSource& source);
+	// faces in GL order (+x, -x, +y, -y, +z, -z)
+	void generateCube(const TextureSource* const faces[6]);
+	// faces in GL order, each with its mip chain (8-bit texels)
+	void generateCube(const std::vector<std::vector<MipImage>>& faces);
+
 	// texture ID and parameters
 	GLuint mTextureID = 0;
 	GLenum mTarget = 0;
@@ -31,6 +69,45 @@ private:
 	GLuint mMinFilter = GL_LINEAR_MIPMAP_LINEAR;
 	GLuint mWrapS = GL_REPEAT;
 	GLuint mWrapT = GL_REPEAT;
+	GLuint mSampler = 0;		// shared sampler of the parameters above, 0 until bound
+	BlockFormat mFormat = BLOCK_FORMAT_NONE;
+	bool mSrgb = false;
+	bool mPrefiltered = false;
+	int mNumOfLevels = 0;
+};
+
+// GL internal format of compressed blocks, 0 if the context cannot sample the format
+// (sRGB colour falls back to linear where the context has no sRGB blocks)
+GLenum blockInternalFormat(BlockFormat format, bool srgb = false);
+// pixel format and sized internal format of 8-bit texels with 1 to 4 channels
+// (R8, RG8, RGB8, RGBA8, or SRGB8 and SRGB8_ALPHA8 for sRGB colour)
+GLenum texelFormat(int numOfChannels);
+GLenum texelInternalFormat(int numOfChannels, bool srgb);
+// grey and grey-alpha images (one or two channels) read as RGB and alpha in shaders
+void setTexelSwizzle(GLenum target, int numOfChannels);
+
+/*****************************************************************
+ * textures loaded together: all image files are decoded at once
+ * on the thread pool, and the textures are created in the order
+ * they were added as their images become ready (context thread)
+ *****************************************************************/
+class TextureBatch
+{
+public:
+	void add(Texture& texture, const std::string& filename);
+	void addCubeMap(Texture& texture, const std::string& fileFront, const std::string& fileBack,
+		const std::string& fileLeft, const std::string& fileRight,
+		const std::string& fileTop, const std::string& fileBottom);
+	// decode and upload everything added, reporting decode and upload time, and empty the batch
+	void load();
+
+private:
+	struct Entry
+	{
+		Texture* texture;
+		std::vector<std::string> files;		// one image, or cube faces in GL order
+	};
+	std::vector<Entry> mEntries;
 };
 
 #endif
@@ -0,0 +1,142 @@
+#include "TextureAtlas.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+
+#include "stb_image.h"
+
+namespace
+{
+	// the scene's textures are RGB, decoded the same way Texture reads them
+	const int ATLAS_CHANNELS = 3;
+
+	MipImage readImage(const std::string& filename)
+	{
+		MipImage image;
+		int channels;
+		unsigned char* pixels = stbi_load(filename.c_str(), &image.width, &image.height, &channels, ATLAS_CHANNELS);
+		if (pixels != nullptr)
+		{
+			image.numOfChannels = ATLAS_CHANNELS;
+			image.pixels.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * ATLAS_CHANNELS);
+			stbi_image_free(pixels);
+		}
+		return image;
+	}
+}
+
+void TextureAtlas::add(const std::string& name, const std::string& filename, bool repeat)
+{
+	mEntries.push_back({ name, filename, repeat, AtlasRegion() });
+}
+
+bool TextureAtlas::build(int gutter, BlockFormat format)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	// formats the context cannot sample stay uncompressed
+	if (blockInternalFormat(format) == 0)
+		format = BLOCK_FORMAT_NONE;
+	int blockSize = format != BLOCK_FORMAT_NONE ? BLOCK_SIZE : 1;
+	gutter *= blockSize;
+
+	// decode every image before packing, first row at the bottom as GL expects
+	stbi_set_flip_vertically_on_load(true);
+	std::vector<std::future<MipImage>> decodes;
+	for (const Entry& entry : mEntries)
+	{
+		std::string filename = entry.filename;
+		decodes.push_back(ThreadPool::shared().submit([filename]() { return readImage(filename); }));
+	}
+
+	std::vector<MipImage> images;
+	for (size_t i = 0; i < decodes.size(); i++)
+	{
+		images.push_back(decodes[i].get());
+		if (images.back().pixels.empty())
+		{
+			std::cout << "Unable to load: " << mEntries[i].filename << std::endl;
+			return false;
+		}
+	}
+
+	std::vector<const MipImage*> packed;
+	std::vector<bool> repeat;
+	int smallestSize = MAX_ATLAS_SIZE;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		packed.push_back(&images[i]);
+		repeat.push_back(mEntries[i].repeat);
+		smallestSize = std::min(smallestSize, std::min(images[i].width, images[i].height));
+	}
+
+	MipImage atlas;
+	std::vector<AtlasRegion> regions;
+	if (!buildAtlas(packed, repeat, gutter, MAX_ATLAS_SIZE, atlas, regions))
+	{
+		std::cout << "Unable to pack " << images.size() << " images into a texture atlas" << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < regions.size(); i++)
+		mEntries[i].region = regions[i];
+
+	// 2x2 box filtering stays inside the gutter aligned tiles, down to the last level the gutter covers
+	std::vector<MipImage> levels;
+	generateMipChain(atlas, MIP_FILTER_BOX, MIP_SRGB, levels);
+	levels.resize(std::min(levels.size(), static_cast<size_t>(numOfAtlasLevels(gutter, smallestSize, blockSize))));
+	for (size_t level = 0; format != BLOCK_FORMAT_NONE && level < levels.size(); level++)
+	{
+		std::vector<unsigned char> blocks;
+		compressImage(levels[level], format, blocks);
+		levels[level].pixels.swap(blocks);
+	}
+
+	mTexture.reset(new Texture());
+	mTexture->generate(levels, format);
+	mTexture->setWrapParams(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Packed " << images.size() << " images into a " << atlas.width << "x" << atlas.height
+		<< " texture atlas with " << levels.size() << " levels in " << buildTime.count() << " ms" << std::endl;
+	return true;
+}
+
+void TextureAtlas::clear()
+{
+	mEntries.clear();
+	mTexture.reset();
+}
+
+void TextureAtlas::bind(GLuint unit)
+{
+	if (mTexture)
+		mTexture->bind(unit);
+}
+
+glm::vec4 TextureAtlas::getRect(const std::string& name) const
+{
+	const Entry* entry = find(name);
+	if (entry == nullptr)
+		return glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+	const AtlasRegion& region = entry->region;
+	return glm::vec4(region.offset[0], region.offset[1], region.scale[0], region.scale[1]);
+}
+
+bool TextureAtlas::isRepeating(const std::string& name) const
+{
+	const Entry* entry = find(name);
+	return entry != nullptr && entry->repeat;
+}
+
+const TextureAtlas::Entry* TextureAtlas::find(const std::string& name) const
+{
+	for (const Entry& entry : mEntries)
+	{
+		if (entry.name == name)
+			return &entry;
+	}
+	return nullptr;
+}
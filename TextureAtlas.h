@@ -0,0 +1,51 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include "AtlasPacker.h"
+#include "Texture.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*****************************************************************
+ * small textures packed into one texture at load time, so they
+ * can be drawn without rebinding; each image keeps its own
+ * texture coordinates and the shader maps them into the atlas
+ * with the image's rectangle (uAtlasRect), repeating or clamping
+ * inside it (uAtlasRepeat) since the atlas itself cannot wrap
+ *****************************************************************/
+class TextureAtlas
+{
+public:
+	// queue an image, repeat for images tiled across their surface
+	void add(const std::string& name, const std::string& filename, bool repeat);
+	// decode the images on the thread pool, pack them and upload the atlas with the mip levels
+	// its gutter keeps clean; false if an image cannot be read or they do not fit.
+	// a compressed atlas widens the gutter by the block size so blocks never straddle images
+	bool build(int gutter = DEFAULT_ATLAS_GUTTER, BlockFormat format = BLOCK_FORMAT_NONE);
+	// free the atlas texture and forget its images
+	void clear();
+
+	// binds the atlas for use
+	void bind(GLuint unit);
+	// offset (xy) and scale (zw) from an image's texture coordinates to the atlas
+	// (the whole texture for an unknown name)
+	glm::vec4 getRect(const std::string& name) const;
+	bool isRepeating(const std::string& name) const;
+
+private:
+	struct Entry
+	{
+		std::string name;
+		std::string filename;
+		bool repeat;
+		AtlasRegion region;
+	};
+	const Entry* find(const std::string& name) const;
+
+	std::vector<Entry> mEntries;
+	std::unique_ptr<Texture> mTexture;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "TextureRegistry.h"
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+// registry record of one texture
+struct TextureHandle::Entry
+{
+	std::string key;
+	Texture texture;
+	unsigned int numOfReferences = 0;
+	TextureStreamer* streamer = nullptr;	// set if the texture is streamed
+};
+
+TextureHandle::TextureHandle(TextureRegistry* registry, Entry* entry)
+	: mRegistry(registry), mEntry(entry)
+{
+	mEntry->numOfReferences++;
+}
+
+TextureHandle::~TextureHandle()
+{
+	reset();
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other)
+	: mRegistry(other.mRegistry), mEntry(other.mEntry)
+{
+	other.mRegistry = nullptr;
+	other.mEntry = nullptr;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle&& other)
+{
+	if (this != &other)
+	{
+		reset();
+		mRegistry = other.mRegistry;
+		mEntry = other.mEntry;
+		other.mRegistry = nullptr;
+		other.mEntry = nullptr;
+	}
+	return *this;
+}
+
+TextureHandle TextureHandle::share() const
+{
+	if (mEntry == nullptr)
+		return TextureHandle();
+	return TextureHandle(mRegistry, mEntry);
+}
+
+void TextureHandle::reset()
+{
+	if (mEntry != nullptr)
+		mRegistry->release(mEntry);
+	mRegistry = nullptr;
+	mEntry = nullptr;
+}
+
+Texture* TextureHandle::get() const
+{
+	return mEntry != nullptr ? &mEntry->texture : nullptr;
+}
+
+TextureRegistry::TextureRegistry()
+{}
+
+TextureRegistry::~TextureRegistry()
+{
+	// textures still referenced are freed with the registry
+	for (auto& entry : mEntries)
+	{
+		if (entry.second->streamer != nullptr)
+			entry.second->streamer->remove(entry.second->texture);
+	}
+}
+
+std::string TextureRegistry::canonicalPath(const std::string& filename)
+{
+	std::string path = filename;
+
+#ifdef _WIN32
+	char buffer[_MAX_PATH];
+	if (_fullpath(buffer, filename.c_str(), _MAX_PATH) != nullptr)
+		path = buffer;
+
+	// paths are case insensitive and take either separator
+	std::transform(path.begin(), path.end(), path.begin(),
+		[](unsigned char c) { return static_cast<char>(c == '\\' ? '/' : std::tolower(c)); });
+#else
+	char* resolved = realpath(filename.c_str(), nullptr);
+	if (resolved != nullptr)
+	{
+		path = resolved;
+		free(resolved);
+	}
+#endif
+
+	return path;
+}
+
+TextureHandle TextureRegistry::acquire(const std::string& filename, BlockFormat format)
+{
+	bool isNew;
+	TextureHandle handle = find(canonicalPath(filename), isNew);
+	if (isNew)
+	{
+		handle->setFormat(format);
+		handle->generate(filename);
+	}
+	return handle;
+}
+
+TextureHandle TextureRegistry::acquire(const std::string& filename, TextureBatch& batch, BlockFormat format)
+{
+	bool isNew;
+	TextureHandle handle = find(canonicalPath(filename), isNew);
+	if (isNew)
+	{
+		handle->setFormat(format);
+		batch.add(*handle, filename);
+	}
+	return handle;
+}
+
+TextureHandle TextureRegistry::acquire(const std::string& filename, TextureStreamer& streamer, BlockFormat format)
+{
+	bool isNew;
+	TextureHandle handle = find(canonicalPath(filename), isNew);
+	if (isNew)
+	{
+		handle->setFormat(format);
+		if (streamer.add(*handle, filename))
+			handle.mEntry->streamer = &streamer;
+	}
+	return handle;
+}
+
+TextureHandle TextureRegistry::acquireCubeMap(const std::string& fileFront, const std::string& fileBack,
+	const std::string& fileLeft, const std::string& fileRight,
+	const std::string& fileTop, const std::string& fileBottom, TextureBatch& batch, bool prefiltered)
+{
+	// one key for the six faces (prefiltered levels differ from plain ones)
+	std::string key = (prefiltered ? "ggx:" : "cube:") + canonicalPath(fileFront) + "|" + canonicalPath(fileBack) + "|"
+		+ canonicalPath(fileLeft) + "|" + canonicalPath(fileRight) + "|"
+		+ canonicalPath(fileTop) + "|" + canonicalPath(fileBottom);
+
+	bool isNew;
+	TextureHandle handle = find(key, isNew);
+	if (isNew)
+	{
+		handle->setPrefiltered(prefiltered);
+		batch.addCubeMap(*handle, fileFront, fileBack, fileLeft, fileRight, fileTop, fileBottom);
+	}
+	return handle;
+}
+
+TextureHandle TextureRegistry::find(const std::string& key, bool& isNew)
+{
+	auto found = mEntries.find(key);
+	isNew = found == mEntries.end();
+	if (isNew)
+	{
+		std::unique_ptr<TextureHandle::Entry> entry(new TextureHandle::Entry());
+		entry->key = key;
+		found = mEntries.emplace(key, std::move(entry)).first;
+	}
+
+	return TextureHandle(this, found->second.get());
+}
+
+void TextureRegistry::release(TextureHandle::Entry* entry)
+{
+	if (--entry->numOfReferences > 0)
+		return;
+
+	// last reference: the GL texture is deleted with the entry
+	if (entry->streamer != nullptr)
+		entry->streamer->remove(entry->texture);
+	mEntries.erase(entry->key);
+}
@@ -0,0 +1,93 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include "Texture.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+class TextureRegistry;
+class TextureStreamer;
+
+/*****************************************************************
+ * move-only reference to a texture owned by a TextureRegistry;
+ * the texture is freed when its last handle goes away
+ *****************************************************************/
+class TextureHandle
+{
+public:
+	TextureHandle() {}
+	~TextureHandle();
+
+	TextureHandle(const TextureHandle&) = delete;
+	TextureHandle& operator=(const TextureHandle&) = delete;
+	TextureHandle(TextureHandle&& other);
+	TextureHandle& operator=(TextureHandle&& other);
+
+	// another reference to the same texture
+	TextureHandle share() const;
+	// drop this reference
+	void reset();
+
+	Texture* get() const;
+	Texture* operator->() const { return get(); }
+	Texture& operator*() const { return *get(); }
+	explicit operator bool() const { return mEntry != nullptr; }
+
+private:
+	friend class TextureRegistry;
+	struct Entry;
+
+	TextureRegistry* mRegistry = nullptr;
+	Entry* mEntry = nullptr;
+
+	TextureHandle(TextureRegistry* registry, Entry* entry);
+};
+
+/*****************************************************************
+ * textures shared by canonical file path: asking for a file that
+ * is already loaded returns a handle to the existing texture
+ * instead of decoding and uploading it again
+ *
+ * handles must be released before the registry is destroyed (and
+ * before the GL context goes away)
+ *****************************************************************/
+class TextureRegistry
+{
+public:
+	TextureRegistry();
+	~TextureRegistry();
+
+	TextureRegistry(const TextureRegistry&) = delete;
+	TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+	// load a texture now (Texture::generate); a new texture compresses decoded
+	// images to format (Texture::setFormat), a shared one keeps its own
+	TextureHandle acquire(const std::string& filename, BlockFormat format = BLOCK_FORMAT_NONE);
+	// a new texture is added to the batch and created by its next load()
+	TextureHandle acquire(const std::string& filename, TextureBatch& batch, BlockFormat format = BLOCK_FORMAT_NONE);
+	// a new texture is streamed (TextureStreamer::add) and removed from the streamer when freed
+	TextureHandle acquire(const std::string& filename, TextureStreamer& streamer, BlockFormat format = BLOCK_FORMAT_NONE);
+	// a new cube map is prefiltered for GGX reflections if asked (Texture::setPrefiltered)
+	TextureHandle acquireCubeMap(const std::string& fileFront, const std::string& fileBack,
+		const std::string& fileLeft, const std::string& fileRight,
+		const std::string& fileTop, const std::string& fileBottom, TextureBatch& batch, bool prefiltered = false);
+
+	// textures currently referenced
+	size_t getNumOfTextures() const { return mEntries.size(); }
+
+	// absolute path with '.' and '..' resolved (case folded on Windows), used as the key
+	static std::string canonicalPath(const std::string& filename);
+
+private:
+	friend class TextureHandle;
+
+	std::map<std::string, std::unique_ptr<TextureHandle::Entry>> mEntries;
+
+	// existing entry for a key, or a new one (isNew set) for the caller to load
+	TextureHandle find(const std::string& key, bool& isNew);
+	void release(TextureHandle::Entry* entry);
+};
+
+#endif
@@ -0,0 +1,423 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// drivers keep three channel textures with four bytes per texel, compressed ones as they are
+	size_t gpuBytes(const CookedTextureHeader& header, const CookedTextureLevel& level)
+	{
+		if (header.blockFormat != BLOCK_FORMAT_NONE)
+			return static_cast<size_t>(level.bytes);
+		size_t texelBytes = header.numOfChannels == 3 ? 4 : header.numOfChannels;
+		return static_cast<size_t>(level.width) * level.height * texelBytes;
+	}
+}
+
+TextureStreamer::TextureStreamer()
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	clear();
+}
+
+void TextureStreamer::clear()
+{
+	// release pixel buffers and outstanding fences
+	for (UploadSlot& slot : mSlots)
+	{
+		if (slot.fence != 0)
+			glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	mSlots.clear();
+	mTextures.clear();
+	mResidentBytes = 0;
+}
+
+bool TextureStreamer::add(Texture& texture, const std::string& filename)
+{
+	std::unique_ptr<StreamedTexture> stream(new StreamedTexture());
+	stream->header = openCookedImage(stream->file, filename, stream->levels);
+	if (stream->header == nullptr || stream->header->numOfFaces != 1 || (stream->header->blockFormat != BLOCK_FORMAT_NONE
+		&& blockInternalFormat(static_cast<BlockFormat>(stream->header->blockFormat)) == 0))
+	{
+		texture.generate(filename);
+		return false;
+	}
+
+	// pixel buffers are created with the first streamed texture (a context exists by then)
+	if (mSlots.empty())
+	{
+		mSlots.resize(NUM_OF_STREAMING_BUFFERS);
+		for (UploadSlot& slot : mSlots)
+		{
+			glGenBuffers(1, &slot.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, TEXTURE_STREAMING_SLICE_BYTES, nullptr, GL_STREAM_DRAW);
+			slot.size = TEXTURE_STREAMING_SLICE_BYTES;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	const CookedTextureHeader& header = *stream->header;
+	stream->texture = &texture;
+	// colour is stored as sRGB only if asked for and cooked as colour
+	bool srgb = texture.mSrgb && (header.flags & MIP_SRGB) != 0;
+	stream->format = texelFormat(header.numOfChannels);
+	stream->internalFormat = texelInternalFormat(header.numOfChannels, srgb);
+	stream->compressedFormat = blockInternalFormat(static_cast<BlockFormat>(header.blockFormat),
+		srgb && header.blockFormat != BLOCK_FORMAT_BC5);
+
+	// smallest levels go up at once so the texture can be drawn immediately
+	GLint lastLevel = header.numOfLevels - 1;
+	GLint tailLevel = lastLevel;
+	while (tailLevel > 0 && static_cast<int>(std::max(stream->levels[tailLevel - 1].width,
+		stream->levels[tailLevel - 1].height)) <= TEXTURE_STREAMING_TAIL_SIZE)
+		tailLevel--;
+
+	// generate texture
+	glGenTextures(1, &texture.mTextureID);
+	glBindTexture(GL_TEXTURE_2D, texture.mTextureID);
+
+	GLint unpackAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (GLint level = tailLevel; level <= lastLevel; level++)
+	{
+		const CookedTextureLevel& record = stream->levels[level];
+		if (stream->compressedFormat != 0)
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, stream->compressedFormat, record.width, record.height, 0,
+				static_cast<GLsizei>(record.bytes), stream->file.data() + record.offset);
+		}
+		else
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, stream->internalFormat, record.width, record.height, 0,
+				stream->format, GL_UNSIGNED_BYTE, stream->file.data() + record.offset);
+		}
+		mResidentBytes += gpuBytes(header, record);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+	// only resident levels are sampled
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, tailLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastLevel);
+	if (stream->compressedFormat == 0)
+		setTexelSwizzle(GL_TEXTURE_2D, header.numOfChannels);
+	texture.mTarget = GL_TEXTURE_2D;
+	texture.mNumOfLevels = static_cast<int>(header.numOfLevels);
+
+	stream->tailLevel = tailLevel;
+	stream->residentLevel = tailLevel;
+	stream->wantedLevel = tailLevel;
+	stream->requestedLevel = tailLevel;
+	mTextures.push_back(std::move(stream));
+	return true;
+}
+
+void TextureStreamer::remove(const Texture& texture)
+{
+	StreamedTexture* stream = findTexture(texture);
+	if (stream == nullptr)
+		return;
+
+	// copies still reading its pixel buffers no longer matter
+	for (UploadSlot& slot : mSlots)
+	{
+		if (slot.stream == stream)
+		{
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+			slot.stream = nullptr;
+		}
+	}
+
+	// resident levels and the one being loaded
+	GLint firstLevel = stream->loadingLevel >= 0 ? stream->loadingLevel : stream->residentLevel;
+	for (GLint level = firstLevel; level < static_cast<GLint>(stream->header->numOfLevels); level++)
+		mResidentBytes -= gpuBytes(*stream->header, stream->levels[level]);
+
+	mTextures.erase(std::find_if(mTextures.begin(), mTextures.end(),
+		[stream](const std::unique_ptr<StreamedTexture>& other) { return other.get() == stream; }));
+}
+
+void TextureStreamer::requestCoverage(const Texture& texture, const glm::mat4& modelViewProjection,
+	const glm::vec3& boundsMin, const glm::vec3& boundsMax, float uvRepeat, const glm::vec2& viewportSize)
+{
+	StreamedTexture* stream = findTexture(texture);
+	if (stream == nullptr)
+		return;
+
+	// screen rectangle of the projected bounds
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	bool isBehind = false;
+	for (int i = 0; i < 8 && !isBehind; i++)
+	{
+		glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y,
+			(i & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.0f);
+		isBehind = clip.w <= 0.0f;
+		if (isBehind)
+			break;
+
+		minX = std::min(minX, clip.x / clip.w);
+		maxX = std::max(maxX, clip.x / clip.w);
+		minY = std::min(minY, clip.y / clip.w);
+		maxY = std::max(maxY, clip.y / clip.w);
+	}
+
+	// surfaces reaching behind the viewer may be arbitrarily close, so they get full resolution
+	GLint level = 0;
+	if (!isBehind)
+	{
+		float extent = std::max((maxX - minX) * 0.5f * viewportSize.x, (maxY - minY) * 0.5f * viewportSize.y);
+		float size = static_cast<float>(std::max(stream->header->width, stream->header->height)) * uvRepeat;
+		float texelsPerPixel = extent > 0.0f ? size / extent : FLT_MAX;
+		level = static_cast<GLint>(std::floor(std::log2(std::max(1.0f, texelsPerPixel))));
+	}
+
+	stream->requestedLevel = std::min(stream->requestedLevel, std::min(level, stream->tailLevel));
+	stream->lastUsedFrame = mFrame;
+}
+
+void TextureStreamer::update()
+{
+	retireSlices();
+
+	// levels the viewports asked for this frame; textures not drawn keep their
+	// last wish but are the first to give up levels
+	for (std::unique_ptr<StreamedTexture>& stream : mTextures)
+	{
+		if (stream->lastUsedFrame == mFrame)
+			stream->wantedLevel = stream->requestedLevel;
+		stream->requestedLevel = stream->tailLevel;
+	}
+
+	// stay within the memory budget (it may have been lowered)
+	while (mResidentBytes > mMemoryBudget && evictLevel(nullptr))
+		;
+
+	GLint unpackAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// copy slices into free pixel buffers until the frame budget is spent
+	size_t frameBytes = 0;
+	for (UploadSlot& slot : mSlots)
+	{
+		if (slot.fence != 0)
+			continue;
+		if (frameBytes >= mFrameBudget)
+			break;
+
+		// finish levels already started before starting new ones
+		StreamedTexture* next = nullptr;
+		for (std::unique_ptr<StreamedTexture>& stream : mTextures)
+		{
+			if (stream->loadingLevel >= 0 && stream->uploadedRows < stream->levels[stream->loadingLevel].height)
+			{
+				next = stream.get();
+				break;
+			}
+		}
+
+		// otherwise the texture furthest from the level it needs, recently used ones first
+		if (next == nullptr)
+		{
+			GLint bestDeficit = 0;
+			for (std::unique_ptr<StreamedTexture>& stream : mTextures)
+			{
+				GLint deficit = stream->residentLevel - stream->wantedLevel;
+				if (stream->loadingLevel >= 0 || deficit <= 0)
+					continue;
+				if (next == nullptr || deficit > bestDeficit
+					|| (deficit == bestDeficit && stream->lastUsedFrame > next->lastUsedFrame))
+				{
+					next = stream.get();
+					bestDeficit = deficit;
+				}
+			}
+
+			if (next == nullptr || !startLevel(*next))
+				break;
+		}
+
+		frameBytes += copySlice(*next, slot);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+	mFrame++;
+}
+
+TextureStreamer::StreamedTexture* TextureStreamer::findTexture(const Texture& texture) const
+{
+	for (const std::unique_ptr<StreamedTexture>& stream : mTextures)
+	{
+		if (stream->texture == &texture)
+			return stream.get();
+	}
+	return nullptr;
+}
+
+// make levels whose copies have completed available for sampling
+void TextureStreamer::retireSlices()
+{
+	for (UploadSlot& slot : mSlots)
+	{
+		if (slot.fence == 0)
+			continue;
+
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			continue;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+
+		StreamedTexture& stream = *slot.stream;
+		slot.stream = nullptr;
+		stream.pendingSlices--;
+
+		// every row of the level has arrived
+		if (stream.pendingSlices == 0 && stream.uploadedRows == stream.levels[stream.loadingLevel].height)
+		{
+			glBindTexture(GL_TEXTURE_2D, stream.texture->mTextureID);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, stream.loadingLevel);
+			stream.residentLevel = stream.loadingLevel;
+			stream.loadingLevel = -1;
+		}
+	}
+}
+
+// release the finest level of a texture that no viewport needs, preferring levels
+// finer than wanted, then least recently drawn textures; false if nothing can go
+bool TextureStreamer::evictLevel(const StreamedTexture* keep)
+{
+	StreamedTexture* victim = nullptr;
+	bool victimUnwanted = false;
+	for (std::unique_ptr<StreamedTexture>& stream : mTextures)
+	{
+		if (stream.get() == keep || stream->loadingLevel >= 0 || stream->residentLevel >= stream->tailLevel)
+			continue;
+
+		// levels a surface drawn this frame needs are never taken
+		bool isUnwanted = stream->residentLevel < stream->wantedLevel;
+		if (!isUnwanted && stream->lastUsedFrame >= mFrame)
+			continue;
+
+		if (victim == nullptr || (isUnwanted && !victimUnwanted)
+			|| (isUnwanted == victimUnwanted && stream->lastUsedFrame < victim->lastUsedFrame))
+		{
+			victim = stream.get();
+			victimUnwanted = isUnwanted;
+		}
+	}
+
+	if (victim == nullptr)
+		return false;
+
+	// sample from the next level and free this one
+	GLint level = victim->residentLevel;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, victim->texture->mTextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+	if (victim->compressedFormat != 0)
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, victim->compressedFormat, 0, 0, 0, 0, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, level, victim->internalFormat, 0, 0, 0, victim->format, GL_UNSIGNED_BYTE, nullptr);
+
+	mResidentBytes -= gpuBytes(*victim->header, victim->levels[level]);
+	victim->residentLevel = level + 1;
+	// not streamed again until a viewport asks for it
+	victim->wantedLevel = std::max(victim->wantedLevel, victim->residentLevel);
+	return true;
+}
+
+// allocate the next finer level of a texture, making room within the memory budget
+bool TextureStreamer::startLevel(StreamedTexture& stream)
+{
+	GLint level = stream.residentLevel - 1;
+	const CookedTextureLevel& record = stream.levels[level];
+	size_t bytes = gpuBytes(*stream.header, record);
+	while (mResidentBytes + bytes > mMemoryBudget)
+	{
+		if (!evictLevel(&stream))
+			return false;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, stream.texture->mTextureID);
+	if (stream.compressedFormat != 0)
+	{
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, stream.compressedFormat, record.width, record.height, 0,
+			static_cast<GLsizei>(record.bytes), nullptr);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, level, stream.internalFormat, record.width, record.height, 0,
+			stream.format, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	mResidentBytes += bytes;
+	stream.loadingLevel = level;
+	stream.uploadedRows = 0;
+	stream.pendingSlices = 0;
+	return true;
+}
+
+// copy the next rows of the loading level through a pixel buffer; returns bytes copied
+size_t TextureStreamer::copySlice(StreamedTexture& stream, UploadSlot& slot)
+{
+	const CookedTextureLevel& record = stream.levels[stream.loadingLevel];
+
+	// compressed levels go in whole rows of blocks (rowBytes covers rowHeight texel rows)
+	BlockFormat blockFormat = static_cast<BlockFormat>(stream.header->blockFormat);
+	uint32_t rowHeight = stream.compressedFormat != 0 ? BLOCK_SIZE : 1;
+	size_t rowBytes = stream.compressedFormat != 0 ? compressedSize(blockFormat, record.width, 1)
+		: static_cast<size_t>(record.width) * stream.header->numOfChannels;
+	uint32_t numOfRows = static_cast<uint32_t>(std::max<size_t>(1, TEXTURE_STREAMING_SLICE_BYTES / rowBytes)) * rowHeight;
+	numOfRows = std::min(numOfRows, record.height - stream.uploadedRows);
+	size_t bytes = rowBytes * ((numOfRows + rowHeight - 1) / rowHeight);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+	if (slot.size < static_cast<GLsizeiptr>(bytes))
+	{
+		// rows wider than a slice
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		slot.size = static_cast<GLsizeiptr>(bytes);
+	}
+
+	// the fence of this buffer has signalled, so nothing reads it any more
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped == nullptr)
+		return 0;
+	std::memcpy(mapped, stream.file.data() + record.offset + stream.uploadedRows / rowHeight * rowBytes, bytes);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	glBindTexture(GL_TEXTURE_2D, stream.texture->mTextureID);
+	if (stream.compressedFormat != 0)
+	{
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, stream.loadingLevel, 0, stream.uploadedRows, record.width, numOfRows,
+			stream.compressedFormat, static_cast<GLsizei>(bytes), nullptr);
+	}
+	else
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, stream.loadingLevel, 0, stream.uploadedRows, record.width, numOfRows,
+			stream.format, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.stream = &stream;
+	stream.uploadedRows += numOfRows;
+	stream.pendingSlices++;
+	return bytes;
+}
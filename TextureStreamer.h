@@ -0,0 +1,108 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "utilities.h"
+#include "CookedTexture.h"
+#include "Texture.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// bytes copied into pixel buffers per frame unless set
+const size_t DEFAULT_TEXTURE_FRAME_BUDGET = 1 << 20;
+// GPU memory of all streamed textures unless set
+const size_t DEFAULT_TEXTURE_MEMORY_BUDGET = 64 << 20;
+// size of each pixel buffer object in the upload pool
+const size_t TEXTURE_STREAMING_SLICE_BYTES = 256 << 10;
+const unsigned int NUM_OF_STREAMING_BUFFERS = 4;
+// levels no larger than this are uploaded as soon as a texture is added
+const int TEXTURE_STREAMING_TAIL_SIZE = 64;
+
+/*****************************************************************
+ * streams the mip levels of cooked 2D textures (see texcook)
+ *
+ * a texture starts with only its smallest levels resident; finer
+ * levels are copied row slices (rows of blocks for compressed
+ * textures) at a time through a pool of pixel
+ * buffer objects, the texture's base level dropping once the
+ * fences of all slices of a level have signalled. which levels are
+ * wanted follows the screen size the textured surfaces cover in
+ * every viewport, and levels no longer wanted (least recently used
+ * textures first) are released to stay within a memory budget
+ *****************************************************************/
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// create a texture with its smallest levels and stream the rest; images without
+	// a current cooked file are loaded whole (Texture::generate) and return false
+	bool add(Texture& texture, const std::string& filename);
+	// stop streaming a texture before it is deleted
+	void remove(const Texture& texture);
+
+	// report a surface drawn with the texture in a viewport: its bounds, projected
+	// with modelViewProjection, and how often the texture repeats across it
+	void requestCoverage(const Texture& texture, const glm::mat4& modelViewProjection,
+		const glm::vec3& boundsMin, const glm::vec3& boundsMax, float uvRepeat, const glm::vec2& viewportSize);
+
+	// once per frame on the context thread: finish, evict and start level uploads
+	// for the coverage requested since the last call
+	void update();
+	// free the pixel buffers and fences while the context exists and unmap the cooked files
+	void clear();
+
+	void setFrameBudget(size_t bytes) { mFrameBudget = bytes; }
+	void setMemoryBudget(size_t bytes) { mMemoryBudget = bytes; }
+	size_t getResidentBytes() const { return mResidentBytes; }
+
+private:
+	struct StreamedTexture
+	{
+		Texture* texture = nullptr;
+		MappedFile file;
+		const CookedTextureHeader* header = nullptr;
+		const CookedTextureLevel* levels = nullptr;
+		GLenum format = GL_RGB;
+		GLenum internalFormat = GL_RGB8;
+		GLenum compressedFormat = 0;	// internal format of cooked blocks, 0 for 8-bit texels
+
+		GLint tailLevel = 0;			// always resident
+		GLint residentLevel = 0;		// finest complete level (GL_TEXTURE_BASE_LEVEL)
+		GLint loadingLevel = -1;		// level being uploaded, -1 if none
+		GLint wantedLevel = 0;			// finest level any viewport needs
+		GLint requestedLevel = 0;		// finest level requested since the last update
+		uint32_t uploadedRows = 0;		// rows of loadingLevel copied to pixel buffers
+		uint32_t pendingSlices = 0;		// copies of loadingLevel still in flight
+		uint64_t lastUsedFrame = 0;
+	};
+
+	// one pixel buffer and the fence of the copy reading from it
+	struct UploadSlot
+	{
+		GLuint buffer = 0;
+		GLsizeiptr size = 0;
+		GLsync fence = 0;
+		StreamedTexture* stream = nullptr;
+	};
+
+	std::vector<std::unique_ptr<StreamedTexture>> mTextures;
+	std::vector<UploadSlot> mSlots;
+	size_t mFrameBudget = DEFAULT_TEXTURE_FRAME_BUDGET;
+	size_t mMemoryBudget = DEFAULT_TEXTURE_MEMORY_BUDGET;
+	size_t mResidentBytes = 0;
+	uint64_t mFrame = 0;
+
+	StreamedTexture* findTexture(const Texture& texture) const;
+	void retireSlices();
+	bool evictLevel(const StreamedTexture* keep);
+	bool startLevel(StreamedTexture& stream);
+	size_t copySlice(StreamedTexture& stream, UploadSlot& slot);
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned int numOfThreads)
+{
+	if (numOfThreads == 0)
+		numOfThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned int i = 0; i < numOfThreads; i++)
+		mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	// let workers finish queued tasks, then join them
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push(std::move(task));
+	}
+	mCondition.notify_one();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> task;
+
+		// wait for a task or shutdown
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+
+			if (mStopping && mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop();
+		}
+
+		task();
+	}
+}
+
+namespace
+{
+	// ranges of a parallelFor call shared by all participating threads
+	struct ParallelForState
+	{
+		size_t begin = 0;
+		size_t end = 0;
+		size_t grain = 1;
+		size_t numOfRanges = 0;
+		const std::function<void(size_t, size_t)>* body = nullptr;
+
+		std::atomic<size_t> nextRange{ 0 };
+		std::atomic<size_t> finishedRanges{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+
+		// claim and run ranges until none are left
+		void run()
+		{
+			for (;;)
+			{
+				size_t range = nextRange.fetch_add(1);
+				if (range >= numOfRanges)
+					return;
+
+				size_t first = begin + range * grain;
+				(*body)(first, std::min(first + grain, end));
+
+				if (finishedRanges.fetch_add(1) + 1 == numOfRanges)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					finished.notify_all();
+				}
+			}
+		}
+	};
+}
+
+void parallelFor(size_t begin, size_t end, size_t grain,
+	const std::function<void(size_t, size_t)>& body)
+{
+	if (end <= begin)
+		return;
+
+	grain = std::max<size_t>(grain, 1);
+	size_t numOfRanges = (end - begin + grain - 1) / grain;
+
+	// not worth waking the pool for a single range
+	if (numOfRanges == 1)
+	{
+		body(begin, end);
+		return;
+	}
+
+	auto state = std::make_shared<ParallelForState>();
+	state->begin = begin;
+	state->end = end;
+	state->grain = grain;
+	state->numOfRanges = numOfRanges;
+	state->body = &body;
+
+	// helpers that start after all ranges are claimed return without touching body
+	ThreadPool& pool = ThreadPool::shared();
+	size_t numOfHelpers = std::min<size_t>(numOfRanges - 1, pool.size());
+	for (size_t i = 0; i < numOfHelpers; i++)
+		pool.enqueue([state]() { state->run(); });
+
+	state->run();
+
+	// wait for ranges still running on helpers
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state]() { return state->finishedRanges.load() == state->numOfRanges; });
+}
@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*****************************************************************
+ * fixed size pool of worker threads
+ *****************************************************************/
+class ThreadPool
+{
+public:
+	// 0 creates one worker per hardware thread
+	explicit ThreadPool(unsigned int numOfThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// queue a task and get a future for its result
+	template <typename Task>
+	auto submit(Task task) -> std::future<decltype(task())>
+	{
+		auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+		std::future<decltype(task())> result = packaged->get_future();
+		enqueue([packaged]() { (*packaged)(); });
+		return result;
+	}
+
+	// queue a task without tracking its completion
+	void enqueue(std::function<void()> task);
+
+	unsigned int size() const { return static_cast<unsigned int>(mWorkers.size()); }
+
+	// pool shared by the loaders and processing passes
+	static ThreadPool& shared();
+
+private:
+	std::vector<std::thread> mWorkers;
+	std::queue<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStopping = false;
+
+	void workerLoop();
+};
+
+// run body(first, last) over [begin, end) in ranges of grain elements on the
+// shared pool; the calling thread works on ranges too, so nested calls from a
+// pool task cannot deadlock
+void parallelFor(size_t begin, size_t end, size_t grain,
+	const std::function<void(size_t, size_t)>& body);
+
+#endif
@@ -0,0 +1,166 @@
+#include "TriangleBvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const int MAX_LEAF_TRIANGLES = 4;
+	const int MAX_DEPTH = 64;				// traversal stack
+	const float MIN_DISTANCE = 1e-4f;		// hits closer to the origin are the surface it left
+
+	glm::vec3 centroid(const BvhTriangle& triangle)
+	{
+		return (triangle.vertices[0] + triangle.vertices[1] + triangle.vertices[2]) / 3.0f;
+	}
+
+	// distance to a triangle from either side (Moller-Trumbore), negative if missed
+	float intersectTriangle(const BvhTriangle& triangle, const glm::vec3& origin, const glm::vec3& direction)
+	{
+		glm::vec3 edge1 = triangle.vertices[1] - triangle.vertices[0];
+		glm::vec3 edge2 = triangle.vertices[2] - triangle.vertices[0];
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (std::abs(determinant) < 1e-10f)
+			return -1.0f;	// parallel
+
+		float inverse = 1.0f / determinant;
+		glm::vec3 s = origin - triangle.vertices[0];
+		float u = glm::dot(s, p) * inverse;
+		if (u < 0.0f || u > 1.0f)
+			return -1.0f;
+		glm::vec3 q = glm::cross(s, edge1);
+		float v = glm::dot(direction, q) * inverse;
+		if (v < 0.0f || u + v > 1.0f)
+			return -1.0f;
+		return glm::dot(edge2, q) * inverse;
+	}
+
+	// slab test: the ray enters the box before maxDistance
+	bool intersectBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::vec3& origin,
+		const glm::vec3& inverseDirection, float maxDistance)
+	{
+		float entry = 0.0f;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float slabEntry = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+			float slabExit = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+			if (slabEntry > slabExit)
+				std::swap(slabEntry, slabExit);
+			entry = std::max(entry, slabEntry);
+			exit = std::min(exit, slabExit);
+		}
+		return entry <= exit;
+	}
+}
+
+void TriangleBvh::build(const std::vector<BvhTriangle>& triangles)
+{
+	mTriangles = triangles;
+	mNodes.clear();
+	mNodes.reserve(2 * mTriangles.size() + 1);
+	mNodes.push_back(Node());
+	buildNode(0, 0, static_cast<int>(mTriangles.size()));
+}
+
+void TriangleBvh::buildNode(int nodeIndex, int first, int count)
+{
+	glm::vec3 boundsMin(INFINITY);
+	glm::vec3 boundsMax(-INFINITY);
+	glm::vec3 centroidMin(INFINITY);
+	glm::vec3 centroidMax(-INFINITY);
+	for (int i = first; i < first + count; i++)
+	{
+		for (const glm::vec3& vertex : mTriangles[i].vertices)
+		{
+			boundsMin = glm::min(boundsMin, vertex);
+			boundsMax = glm::max(boundsMax, vertex);
+		}
+		glm::vec3 center = centroid(mTriangles[i]);
+		centroidMin = glm::min(centroidMin, center);
+		centroidMax = glm::max(centroidMax, center);
+	}
+	mNodes[nodeIndex].boundsMin = boundsMin;
+	mNodes[nodeIndex].boundsMax = boundsMax;
+
+	if (count <= MAX_LEAF_TRIANGLES)
+	{
+		mNodes[nodeIndex].first = first;
+		mNodes[nodeIndex].count = count;
+		return;
+	}
+
+	// median split along the longest axis of the centroids
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	int half = count / 2;
+	std::nth_element(mTriangles.begin() + first, mTriangles.begin() + first + half, mTriangles.begin() + first + count,
+		[axis](const BvhTriangle& a, const BvhTriangle& b) {
+			return centroid(a)[axis] < centroid(b)[axis];
+		});
+
+	// children are added next to each other (mNodes may reallocate, so no references are held)
+	int left = static_cast<int>(mNodes.size());
+	mNodes.push_back(Node());
+	mNodes.push_back(Node());
+	mNodes[nodeIndex].first = left;
+	mNodes[nodeIndex].count = 0;
+	buildNode(left, first, half);
+	buildNode(left + 1, first + half, count - half);
+}
+
+bool TriangleBvh::intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhHit& hit) const
+{
+	float distance = maxDistance;
+	int triangle = trace(origin, direction, distance, false);
+	if (triangle < 0)
+		return false;
+	hit.distance = distance;
+	hit.id = mTriangles[triangle].id;
+	return true;
+}
+
+bool TriangleBvh::occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	float distance = maxDistance;
+	return trace(origin, direction, distance, true) >= 0;
+}
+
+int TriangleBvh::trace(const glm::vec3& origin, const glm::vec3& direction, float& distance, bool anyHit) const
+{
+	if (mTriangles.empty())
+		return -1;
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+	int nearest = -1;
+	int stack[MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = mNodes[stack[--stackSize]];
+		if (!intersectBounds(node.boundsMin, node.boundsMax, origin, inverseDirection, distance))
+			continue;
+
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+			continue;
+		}
+
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			float t = intersectTriangle(mTriangles[i], origin, direction);
+			if (t > MIN_DISTANCE && t < distance)
+			{
+				distance = t;
+				nearest = i;
+				if (anyHit)
+					return nearest;
+			}
+		}
+	}
+	return nearest;
+}
@@ -0,0 +1,57 @@
+#ifndef TRIANGLE_BVH_H
+#define TRIANGLE_BVH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// triangle with the id of the surface it belongs to
+struct BvhTriangle
+{
+	glm::vec3 vertices[3];
+	int id = 0;
+};
+
+// closest intersection along a ray
+struct BvhHit
+{
+	float distance = 0.0f;
+	int id = -1;
+};
+
+/*****************************************************************
+ * bounding volume hierarchy of triangles for ray casting
+ *
+ * nodes split their triangles at the median centroid along the
+ * longest axis of the centroids' bounds, down to a few triangles
+ * per leaf. triangles are hit from either side. built once, then
+ * read only, so any number of threads can trace rays through it
+ *****************************************************************/
+class TriangleBvh
+{
+public:
+	void build(const std::vector<BvhTriangle>& triangles);
+
+	// closest triangle along a ray (unit direction) nearer than maxDistance
+	bool intersect(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhHit& hit) const;
+	// any triangle along a ray nearer than maxDistance (shadow rays)
+	bool occluded(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+private:
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int first = 0;					// leaves: first triangle; inner nodes: left child (right follows it)
+		int count = 0;					// triangles of a leaf, 0 for inner nodes
+	};
+
+	std::vector<Node> mNodes;
+	std::vector<BvhTriangle> mTriangles;
+
+	void buildNode(int nodeIndex, int first, int count);
+	// nearest triangle hit (or any with anyHit), -1 for none
+	int trace(const glm::vec3& origin, const glm::vec3& direction, float& distance, bool anyHit) const;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// largest magnitude of a 10-bit signed normalized field
+	const float SNORM10_MAX = 511.0f;
+
+	int32_t quantizeSnorm(float value, float maximum)
+	{
+		return static_cast<int32_t>(std::floor(std::max(-1.0f, std::min(1.0f, value)) * maximum + 0.5f));
+	}
+
+	// sign extend the low bits of a packed field
+	int32_t signExtend(uint32_t value, int bits)
+	{
+		int32_t shift = 32 - bits;
+		return static_cast<int32_t>(value << shift) >> shift;
+	}
+
+	// project a unit vector onto the octahedron and unfold the lower half
+	void encodeOctahedral(const float vector[3], float& u, float& v)
+	{
+		float sum = std::abs(vector[0]) + std::abs(vector[1]) + std::abs(vector[2]);
+		float scale = sum > 0.0f ? 1.0f / sum : 0.0f;
+		u = vector[0] * scale;
+		v = vector[1] * scale;
+
+		if (vector[2] < 0.0f)
+		{
+			float foldedU = (1.0f - std::abs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+			float foldedV = (1.0f - std::abs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+			u = foldedU;
+			v = foldedV;
+		}
+	}
+
+	void decodeOctahedral(float u, float v, float vector[3])
+	{
+		float z = 1.0f - std::abs(u) - std::abs(v);
+		float t = std::max(-z, 0.0f);
+		float x = u + (u >= 0.0f ? -t : t);
+		float y = v + (v >= 0.0f ? -t : t);
+
+		float length = std::sqrt(x * x + y * y + z * z);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		vector[0] = x * scale;
+		vector[1] = y * scale;
+		vector[2] = z * scale;
+	}
+
+	uint32_t packWord(int32_t u, int32_t v, int32_t w)
+	{
+		return (static_cast<uint32_t>(u) & 0x3ffu)
+			| ((static_cast<uint32_t>(v) & 0x3ffu) << 10)
+			| ((static_cast<uint32_t>(w) & 0x3u) << 30);
+	}
+}
+
+uint16_t quantizeUnorm16(float value)
+{
+	return static_cast<uint16_t>(std::floor(std::max(0.0f, std::min(1.0f, value)) * 65535.0f + 0.5f));
+}
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t magnitude = bits & 0x7fffffffu;
+
+	// NaN stays NaN, overflow and infinity become infinity
+	if (magnitude > 0x7f800000u)
+		return static_cast<uint16_t>(sign | 0x7e00u);
+	if (magnitude >= 0x477ff000u)
+		return static_cast<uint16_t>(sign | 0x7c00u);
+
+	// values below the smallest normal half become denormals
+	if (magnitude < 0x38800000u)
+	{
+		float absolute;
+		std::memcpy(&absolute, &magnitude, sizeof(absolute));
+		return static_cast<uint16_t>(sign | static_cast<uint32_t>(std::nearbyint(absolute * 16777216.0f)));
+	}
+
+	// rebias exponent and round the dropped mantissa bits to nearest even
+	uint32_t half = (magnitude - 0x38000000u) >> 13;
+	uint32_t remainder = magnitude & 0x1fffu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+		half++;
+
+	return static_cast<uint16_t>(sign | half);
+}
+
+float halfToFloat(uint16_t half)
+{
+	uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+	uint32_t exponent = (half >> 10) & 0x1fu;
+	uint32_t mantissa = half & 0x3ffu;
+
+	float value;
+	if (exponent == 0)
+	{
+		// zero or denormal
+		value = std::ldexp(static_cast<float>(mantissa), -24);
+		return sign ? -value : value;
+	}
+
+	uint32_t bits = sign | (exponent == 31 ? 0x7f800000u | (mantissa << 13)
+		: ((exponent + 112) << 23) | (mantissa << 13));
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+uint32_t packOctahedral(const float vector[3], float w)
+{
+	float u, v;
+	encodeOctahedral(vector, u, v);
+
+	// rounding each coordinate separately is not always closest on the sphere,
+	// so keep the best of the surrounding grid points
+	float best = -2.0f;
+	int32_t bestU = 0, bestV = 0;
+	for (int32_t du = 0; du <= 1; du++)
+	{
+		for (int32_t dv = 0; dv <= 1; dv++)
+		{
+			int32_t cu = static_cast<int32_t>(std::floor(u * SNORM10_MAX)) + du;
+			int32_t cv = static_cast<int32_t>(std::floor(v * SNORM10_MAX)) + dv;
+			if (std::abs(cu) > 511 || std::abs(cv) > 511)
+				continue;
+
+			float decoded[3];
+			decodeOctahedral(cu / SNORM10_MAX, cv / SNORM10_MAX, decoded);
+			float similarity = decoded[0] * vector[0] + decoded[1] * vector[1] + decoded[2] * vector[2];
+			if (similarity > best)
+			{
+				best = similarity;
+				bestU = cu;
+				bestV = cv;
+			}
+		}
+	}
+
+	return packWord(bestU, bestV, quantizeSnorm(w, 1.0f));
+}
+
+float unpackOctahedral(uint32_t packed, float vector[3])
+{
+	float u = std::max(signExtend(packed, 10) / SNORM10_MAX, -1.0f);
+	float v = std::max(signExtend(packed >> 10, 10) / SNORM10_MAX, -1.0f);
+	decodeOctahedral(u, v, vector);
+
+	return static_cast<float>(std::max(signExtend(packed >> 30, 2), -1));
+}
@@ -0,0 +1,28 @@
+#ifndef VERTEX_QUANTIZER_H
+#define VERTEX_QUANTIZER_H
+
+#include <cstdint>
+
+/*****************************************************************
+ * conversions used by the packed vertex formats
+ *
+ * positions are stored as 16-bit unsigned normalized values within
+ * the mesh bounds, unit vectors as octahedral coordinates in the
+ * x and y fields of a 10:10:10:2 signed normalized word
+ * (GL_INT_2_10_10_10_REV) and texture coordinates as half floats
+ *****************************************************************/
+
+// value in [0, 1] to a 16-bit unsigned normalized integer
+uint16_t quantizeUnorm16(float value);
+
+// IEEE 754 half precision conversions (round to nearest even)
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t half);
+
+// unit vector to octahedral coordinates in a GL_INT_2_10_10_10_REV word;
+// w (-1, 0 or 1) goes into the 2-bit field, e.g. a tangent's handedness
+uint32_t packOctahedral(const float vector[3], float w = 0.0f);
+// decode a packed unit vector (as the vertex shader does), returns w
+float unpackOctahedral(uint32_t packed, float vector[3]);
+
+#endif
@@ -0,0 +1,383 @@
+#include "VertexWelder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+
+namespace
+{
+	// elements per parallel range
+	const size_t WELD_GRAIN = 1 << 14;
+
+	// quantization steps: positions relative to the mesh extent, unit normals, texture coordinates
+	const float POSITION_STEPS = 1 << 20;
+	const float NORMAL_STEPS = 1 << 10;
+	const float TEXCOORD_STEPS = 1 << 16;
+
+	// submesh, position, normal and texture coordinate of a vertex on the quantization grid
+	const size_t KEY_SIZE = 9;
+
+	const uint32_t EMPTY_SLOT = ~0u;
+
+	// open addressing table of vertex ids filled concurrently with compare and swap
+	class ConcurrentVertexTable
+	{
+	public:
+		explicit ConcurrentVertexTable(size_t count)
+		{
+			mCapacity = 16;
+			while (mCapacity < count * 2)
+				mCapacity *= 2;
+
+			mSlots.reset(new std::atomic<uint32_t>[mCapacity]);
+			parallelFor(0, mCapacity, WELD_GRAIN << 2, [this](size_t first, size_t last)
+			{
+				for (size_t i = first; i < last; i++)
+					mSlots[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+			});
+		}
+
+		// add a vertex, or lower the id stored for its key
+		template <typename Equal>
+		void insert(uint32_t id, uint64_t hash, Equal equal)
+		{
+			size_t slot = hash & (mCapacity - 1);
+			for (;;)
+			{
+				uint32_t current = mSlots[slot].load(std::memory_order_acquire);
+				if (current == EMPTY_SLOT)
+				{
+					// on failure the slot is looked at again
+					mSlots[slot].compare_exchange_weak(current, id, std::memory_order_acq_rel);
+					continue;
+				}
+
+				if (equal(current, id))
+				{
+					// only ids with the same key are ever stored here
+					while (id < current && !mSlots[slot].compare_exchange_weak(current, id, std::memory_order_acq_rel))
+						;
+					return;
+				}
+
+				slot = (slot + 1) & (mCapacity - 1);
+			}
+		}
+
+		// id stored for the key of an inserted vertex
+		template <typename Equal>
+		uint32_t find(uint32_t id, uint64_t hash, Equal equal) const
+		{
+			size_t slot = hash & (mCapacity - 1);
+			for (;;)
+			{
+				uint32_t current = mSlots[slot].load(std::memory_order_acquire);
+				if (current != EMPTY_SLOT && equal(current, id))
+					return current;
+				slot = (slot + 1) & (mCapacity - 1);
+			}
+		}
+
+	private:
+		std::unique_ptr<std::atomic<uint32_t>[]> mSlots;
+		size_t mCapacity;
+	};
+
+	uint64_t hashKey(const int32_t* key, size_t size)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ static_cast<uint32_t>(key[i])) * 0x100000001b3ull;
+			hash ^= hash >> 29;
+		}
+		return hash ^ (hash >> 32);
+	}
+
+	int32_t quantize(float value, float steps)
+	{
+		return static_cast<int32_t>(std::floor(value * steps + 0.5f));
+	}
+
+	// submesh of every vertex
+	std::vector<uint32_t> vertexSubmeshes(const MeshData& mesh)
+	{
+		std::vector<uint32_t> submeshes(mesh.numOfVertices(), 0);
+		for (size_t s = 0; s < mesh.submeshes.size(); s++)
+		{
+			const SubmeshData& submesh = mesh.submeshes[s];
+			std::fill_n(submeshes.begin() + submesh.firstVertex, submesh.numOfVertices, static_cast<uint32_t>(s));
+		}
+		return submeshes;
+	}
+
+	// quantized keys of all vertices; normals and texture coordinates only if used
+	void buildKeys(const MeshData& mesh, bool withAttributes, std::vector<int32_t>& keys)
+	{
+		size_t numOfVertices = mesh.numOfVertices();
+		std::vector<uint32_t> submeshes = vertexSubmeshes(mesh);
+
+		// positions on a grid relative to the bounding box
+		float boundsMin[3] = { INFINITY, INFINITY, INFINITY }, boundsMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (size_t i = 0; i < numOfVertices; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				boundsMin[k] = std::min(boundsMin[k], mesh.positions[i * 3 + k]);
+				boundsMax[k] = std::max(boundsMax[k], mesh.positions[i * 3 + k]);
+			}
+		}
+		float extent = std::max(boundsMax[0] - boundsMin[0], std::max(boundsMax[1] - boundsMin[1], boundsMax[2] - boundsMin[2]));
+		float positionSteps = extent > 0.0f ? POSITION_STEPS / extent : 0.0f;
+
+		keys.assign(numOfVertices * KEY_SIZE, 0);
+		parallelFor(0, numOfVertices, WELD_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				int32_t* key = &keys[i * KEY_SIZE];
+				key[0] = static_cast<int32_t>(submeshes[i]);
+				for (int k = 0; k < 3; k++)
+					key[1 + k] = quantize(mesh.positions[i * 3 + k] - boundsMin[k], positionSteps);
+
+				if (!withAttributes)
+					continue;
+				for (int k = 0; k < 3 && !mesh.normals.empty(); k++)
+					key[4 + k] = quantize(mesh.normals[i * 3 + k], NORMAL_STEPS);
+				for (int k = 0; k < 2 && mesh.hasTexCoords(); k++)
+					key[7 + k] = quantize(mesh.texCoords[i * 2 + k], TEXCOORD_STEPS);
+			}
+		});
+	}
+
+	// smallest vertex with the same key as each vertex
+	std::vector<uint32_t> matchVertices(const std::vector<int32_t>& keys, size_t numOfVertices)
+	{
+		ConcurrentVertexTable table(numOfVertices);
+		std::vector<uint64_t> hashes(numOfVertices);
+		auto equal = [&keys](uint32_t a, uint32_t b)
+		{
+			return std::equal(&keys[a * KEY_SIZE], &keys[a * KEY_SIZE] + KEY_SIZE, &keys[b * KEY_SIZE]);
+		};
+
+		parallelFor(0, numOfVertices, WELD_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				hashes[i] = hashKey(&keys[i * KEY_SIZE], KEY_SIZE);
+				table.insert(static_cast<uint32_t>(i), hashes[i], equal);
+			}
+		});
+
+		// look up once every insert is done so all vertices see the final smallest id
+		std::vector<uint32_t> representatives(numOfVertices);
+		parallelFor(0, numOfVertices, WELD_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				representatives[i] = table.find(static_cast<uint32_t>(i), hashes[i], equal);
+		});
+
+		return representatives;
+	}
+
+	float dot3(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void normalize3(float v[3])
+	{
+		float length = std::sqrt(dot3(v, v));
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		v[0] *= scale;
+		v[1] *= scale;
+		v[2] *= scale;
+	}
+}
+
+void generateCreaseNormals(MeshData& mesh, float creaseAngle)
+{
+	size_t numOfVertices = mesh.numOfVertices();
+	size_t numOfCorners = mesh.indices.size();
+	mesh.normals.resize(numOfVertices * 3, 0.0f);
+
+	// nothing to do if every vertex has a normal
+	bool hasMissing = false;
+	for (size_t i = 0; i < numOfVertices && !hasMissing; i++)
+		hasMissing = dot3(&mesh.normals[i * 3], &mesh.normals[i * 3]) == 0.0f;
+	if (!hasMissing)
+		return;
+
+	// absolute vertex of every corner
+	std::vector<uint32_t> corners(numOfCorners);
+	for (const SubmeshData& submesh : mesh.submeshes)
+	{
+		for (size_t i = submesh.firstIndex; i < submesh.firstIndex + submesh.numOfIndices; i++)
+			corners[i] = static_cast<uint32_t>(submesh.firstVertex + mesh.indices[i]);
+	}
+
+	// unit face normals and corner angles
+	std::vector<float> faceNormals(numOfCorners), angles(numOfCorners);
+	parallelFor(0, numOfCorners / 3, WELD_GRAIN, [&](size_t first, size_t last)
+	{
+		for (size_t t = first; t < last; t++)
+		{
+			const float* p[3];
+			for (int k = 0; k < 3; k++)
+				p[k] = &mesh.positions[corners[t * 3 + k] * 3];
+
+			float e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+			float e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+			float* n = &faceNormals[t * 3];
+			n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+			normalize3(n);
+
+			for (int k = 0; k < 3; k++)
+			{
+				const float* o = p[k];
+				const float* a = p[(k + 1) % 3];
+				const float* b = p[(k + 2) % 3];
+				float u[3] = { a[0] - o[0], a[1] - o[1], a[2] - o[2] };
+				float v[3] = { b[0] - o[0], b[1] - o[1], b[2] - o[2] };
+				normalize3(u);
+				normalize3(v);
+				angles[t * 3 + k] = std::acos(std::max(-1.0f, std::min(1.0f, dot3(u, v))));
+			}
+		}
+	});
+
+	// corners around each shared position in compressed row form
+	std::vector<int32_t> keys;
+	buildKeys(mesh, false, keys);
+	std::vector<uint32_t> positions = matchVertices(keys, numOfVertices);
+	std::vector<int32_t>().swap(keys);
+
+	std::vector<uint32_t> offsets(numOfVertices + 1, 0), positionCorners(numOfCorners);
+	for (uint32_t vertex : corners)
+		offsets[positions[vertex] + 1]++;
+	for (size_t i = 0; i < numOfVertices; i++)
+		offsets[i + 1] += offsets[i];
+
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < numOfCorners; i++)
+		positionCorners[fill[positions[corners[i]]]++] = static_cast<uint32_t>(i);
+
+	// every corner becomes a vertex with its own normal
+	float minCosine = std::cos(creaseAngle * 3.14159265f / 180.0f);
+	MeshData output;
+	output.positions.resize(numOfCorners * 3);
+	output.normals.resize(numOfCorners * 3);
+	output.texCoords.resize(mesh.hasTexCoords() ? numOfCorners * 2 : 0);
+
+	parallelFor(0, numOfCorners, WELD_GRAIN, [&](size_t first, size_t last)
+	{
+		for (size_t c = first; c < last; c++)
+		{
+			uint32_t vertex = corners[c];
+			std::copy_n(&mesh.positions[vertex * 3], 3, &output.positions[c * 3]);
+			if (mesh.hasTexCoords())
+				std::copy_n(&mesh.texCoords[vertex * 2], 2, &output.texCoords[c * 2]);
+
+			float* normal = &output.normals[c * 3];
+			std::copy_n(&mesh.normals[vertex * 3], 3, normal);
+			if (dot3(normal, normal) > 0.0f)
+				continue;
+
+			// faces within the crease angle of this corner's face
+			const float* faceNormal = &faceNormals[c / 3 * 3];
+			uint32_t position = positions[vertex];
+			for (uint32_t i = offsets[position]; i < offsets[position + 1]; i++)
+			{
+				uint32_t other = positionCorners[i];
+				const float* otherNormal = &faceNormals[other / 3 * 3];
+				if (dot3(faceNormal, otherNormal) < minCosine)
+					continue;
+
+				for (int k = 0; k < 3; k++)
+					normal[k] += otherNormal[k] * angles[other];
+			}
+			normalize3(normal);
+		}
+	});
+
+	// submeshes keep their index ranges, each corner indexing its own vertex
+	for (SubmeshData& submesh : mesh.submeshes)
+	{
+		submesh.firstVertex = submesh.firstIndex;
+		submesh.numOfVertices = submesh.numOfIndices;
+		for (size_t i = 0; i < submesh.numOfIndices; i++)
+			mesh.indices[submesh.firstIndex + i] = static_cast<unsigned int>(i);
+	}
+
+	mesh.positions.swap(output.positions);
+	mesh.normals.swap(output.normals);
+	mesh.texCoords.swap(output.texCoords);
+	mesh.tangents.clear();
+}
+
+size_t weldVertices(MeshData& mesh)
+{
+	size_t numOfVertices = mesh.numOfVertices();
+	if (numOfVertices == 0)
+		return 0;
+
+	std::vector<int32_t> keys;
+	buildKeys(mesh, true, keys);
+	std::vector<uint32_t> representatives = matchVertices(keys, numOfVertices);
+	std::vector<int32_t>().swap(keys);
+
+	// kept vertices stay in order, so submesh ranges stay contiguous
+	// (keptBefore[i] is the new index of the first kept vertex from i on)
+	std::vector<uint32_t> keptBefore(numOfVertices + 1, 0), remap(numOfVertices);
+	for (size_t i = 0; i < numOfVertices; i++)
+		keptBefore[i + 1] = keptBefore[i] + (representatives[i] == i ? 1 : 0);
+	uint32_t numOfKept = keptBefore[numOfVertices];
+	for (size_t i = 0; i < numOfVertices; i++)
+		remap[i] = keptBefore[representatives[i]];
+
+	std::vector<float> positions(numOfKept * 3), normals(mesh.normals.empty() ? 0 : numOfKept * 3);
+	std::vector<float> texCoords(mesh.hasTexCoords() ? numOfKept * 2 : 0);
+	parallelFor(0, numOfVertices, WELD_GRAIN, [&](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			if (representatives[i] != i)
+				continue;
+
+			std::copy_n(&mesh.positions[i * 3], 3, &positions[remap[i] * 3]);
+			if (!normals.empty())
+				std::copy_n(&mesh.normals[i * 3], 3, &normals[remap[i] * 3]);
+			if (!texCoords.empty())
+				std::copy_n(&mesh.texCoords[i * 2], 2, &texCoords[remap[i] * 2]);
+		}
+	});
+
+	// rewrite indices relative to the new start of each submesh
+	for (SubmeshData& submesh : mesh.submeshes)
+	{
+		size_t oldFirst = submesh.firstVertex;
+		size_t newFirst = keptBefore[oldFirst];
+		size_t newLast = keptBefore[oldFirst + submesh.numOfVertices];
+
+		parallelFor(submesh.firstIndex, submesh.firstIndex + submesh.numOfIndices, WELD_GRAIN, [&](size_t first, size_t last)
+		{
+			for (size_t i = first; i < last; i++)
+				mesh.indices[i] = static_cast<unsigned int>(remap[oldFirst + mesh.indices[i]] - newFirst);
+		});
+
+		submesh.firstVertex = newFirst;
+		submesh.numOfVertices = newLast - newFirst;
+	}
+
+	mesh.positions.swap(positions);
+	mesh.normals.swap(normals);
+	mesh.texCoords.swap(texCoords);
+	mesh.tangents.clear();
+
+	return numOfVertices - numOfKept;
+}
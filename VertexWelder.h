@@ -0,0 +1,29 @@
+#ifndef VERTEX_WELDER_H
+#define VERTEX_WELDER_H
+
+#include "MeshData.h"
+
+/*****************************************************************
+ * native replacements for assimp's vertex joining and smooth
+ * normal post-processing
+ *
+ * vertices are matched on quantized attributes through a lock-free
+ * open addressing table filled from all threads (equal keys keep
+ * the smallest vertex, so the result does not depend on timing);
+ * normals are accumulated per triangle corner in parallel
+ *****************************************************************/
+
+// default crease angle (degrees), the limit assimp smooths normals up to
+const float DEFAULT_CREASE_ANGLE = 175.0f;
+
+// give corners whose vertex normal is zero the angle weighted normal of the
+// faces around their position within each submesh, leaving out faces that
+// meet the corner's face at more than creaseAngle degrees
+// afterwards every corner has its own vertex (see weldVertices)
+void generateCreaseNormals(MeshData& mesh, float creaseAngle);
+
+// share vertices of a submesh whose quantized position, normal and texture
+// coordinate are equal; returns the number of vertices removed
+size_t weldVertices(MeshData& mesh);
+
+#endif
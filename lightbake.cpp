@@ -0,0 +1,188 @@
+/*****************************************************************
+ * lightbake: offline lightmap baker for the room
+ *
+ * path traces the scene light (as init() places it) and its
+ * bounces over the room's floor, walls and painting on all cores,
+ * and writes the light falling on them into a 24-bit BMP laid out
+ * as Lightmap.h describes. the renderer samples it on the static
+ * surfaces instead of lighting them with the scene light
+ *
+ * usage: lightbake [options]
+ *   --samples n   paths per texel (default 256)
+ *   --bounces n   indirect bounces per path (default 3)
+ *   --no-denoise  keep the path tracer's noise
+ *   -i dir        images the surface colours come from (default ./images)
+ *   -o file       output file (default ./images/lightmap.bmp)
+ *****************************************************************/
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "LightmapBaker.h"
+#include "RoomGeometry.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void printUsage()
+	{
+		std::cerr << "usage: lightbake [--samples n] [--bounces n] [--no-denoise] [-i dir] [-o file]" << std::endl;
+	}
+
+	// average colour of an image, as the shader samples its (unorm, not sRGB) texture
+	bool averageColour(const std::string& filename, glm::vec3& colour)
+	{
+		int width, height, channels;
+		unsigned char* pixels = stbi_load(filename.c_str(), &width, &height, &channels, 3);
+		if (pixels == nullptr)
+			return false;
+
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		size_t numOfPixels = static_cast<size_t>(width) * height;
+		for (size_t i = 0; i < numOfPixels; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				sum[c] += pixels[i * 3 + c] / 255.0;
+			}
+		}
+		stbi_image_free(pixels);
+		colour = glm::vec3(static_cast<float>(sum[0] / numOfPixels), static_cast<float>(sum[1] / numOfPixels),
+			static_cast<float>(sum[2] / numOfPixels));
+		return true;
+	}
+
+	void writeValue(std::ofstream& file, uint32_t value, int numOfBytes)
+	{
+		for (int i = 0; i < numOfBytes; i++)
+			file.put(static_cast<char>((value >> (8 * i)) & 0xff));
+	}
+
+	// 24-bit bottom-up BMP of the encoded light
+	bool writeBitmap(const std::string& filename, const std::vector<glm::vec3>& texels, int size)
+	{
+		std::ofstream file(filename, std::ios::binary);
+		if (!file)
+			return false;
+
+		uint32_t rowBytes = (static_cast<uint32_t>(size) * 3 + 3) & ~3u;
+		uint32_t imageBytes = rowBytes * size;
+		// file header
+		file.put('B');
+		file.put('M');
+		writeValue(file, 54 + imageBytes, 4);
+		writeValue(file, 0, 4);
+		writeValue(file, 54, 4);			// offset of the pixels
+		// info header
+		writeValue(file, 40, 4);
+		writeValue(file, size, 4);
+		writeValue(file, size, 4);			// positive: bottom row first
+		writeValue(file, 1, 2);				// planes
+		writeValue(file, 24, 2);			// bits per pixel
+		writeValue(file, 0, 4);				// uncompressed
+		writeValue(file, imageBytes, 4);
+		writeValue(file, 2835, 4);			// 72 dpi
+		writeValue(file, 2835, 4);
+		writeValue(file, 0, 4);
+		writeValue(file, 0, 4);
+
+		std::vector<char> row(rowBytes, 0);
+		for (int y = 0; y < size; y++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				const glm::vec3& light = texels[y * size + x];
+				row[x * 3 + 0] = static_cast<char>(encodeLightmap(light.z));	// blue, green, red
+				row[x * 3 + 1] = static_cast<char>(encodeLightmap(light.y));
+				row[x * 3 + 2] = static_cast<char>(encodeLightmap(light.x));
+			}
+			file.write(row.data(), rowBytes);
+		}
+		return static_cast<bool>(file);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// the renderer lays out a map of this size
+	const int size = LIGHTMAP_SIZE;
+	BakeSettings settings;
+	std::string imageDirectory = "./images";
+	std::string output = "./images/lightmap.bmp";
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--samples" && i + 1 < argc)
+			settings.numOfSamples = std::atoi(argv[++i]);
+		else if (argument == "--bounces" && i + 1 < argc)
+			settings.numOfBounces = std::atoi(argv[++i]);
+		else if (argument == "--no-denoise")
+			settings.denoise = false;
+		else if (argument == "-i" && i + 1 < argc)
+			imageDirectory = argv[++i];
+		else if (argument == "-o" && i + 1 < argc)
+			output = argv[++i];
+		else
+		{
+			printUsage();
+			return 1;
+		}
+	}
+	if (settings.numOfSamples < 1 || settings.numOfBounces < 0)
+	{
+		printUsage();
+		return 1;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	// surfaces reflect their material's Kd times their image's colour
+	std::vector<RoomSurface> room = roomSurfaces();
+	std::vector<LightmapSurface> surfaces;
+	for (const RoomSurface& surface : room)
+	{
+		glm::vec3 colour;
+		std::string filename = imageDirectory + "/" + surface.image;
+		if (!averageColour(filename, colour))
+		{
+			std::cerr << "Unable to load: " << filename << std::endl;
+			return 1;
+		}
+		surfaces.push_back(surface.quad);
+		surfaces.back().albedo *= colour;
+	}
+
+	std::vector<LightmapChart> charts;
+	if (!packLightmap(surfaces, size, charts))
+	{
+		std::cerr << "Surfaces do not fit a " << size << "x" << size << " lightmap" << std::endl;
+		return 1;
+	}
+
+	BakeLight light;
+	light.position = ROOM_LIGHT_POSITION;
+	light.diffuse = ROOM_LIGHT_DIFFUSE;
+	light.attenuation = ROOM_LIGHT_ATTENUATION;
+
+	std::vector<glm::vec3> texels;
+	bakeLightmap(surfaces, charts, { light }, settings, size, texels);
+
+	if (!writeBitmap(output, texels, size))
+	{
+		std::cerr << "Unable to write: " << output << std::endl;
+		return 1;
+	}
+
+	std::chrono::duration<double, std::milli> bakeTime = std::chrono::steady_clock::now() - startTime;
+	std::cout << "Baked " << output << " (" << size << "x" << size << ", " << settings.numOfSamples << " samples, "
+		<< settings.numOfBounces << " bounces) in " << bakeTime.count() << " ms" << std::endl;
+	return 0;
+}
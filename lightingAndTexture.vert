@@ -4,32 +4,59 @@
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoord; 
-layout(location = 3) in vec3 aTangent; 
+layout(location = 3) in vec4 aTangent;	// w: handedness
 layout(location = 4) in vec3 aColor;
+layout(location = 5) in vec2 aLightmapCoord;	// static surfaces (see Lightmap.h)
 
 // uniform input data
 uniform mat4 uModelViewProjectionMatrix;
 uniform mat4 uModelMatrix;
 uniform mat3 uNormalMatrix;
 uniform int uColorSet;
+uniform bool uQuantized;		// packed vertex formats of SimpleModel
+uniform vec3 uPositionOffset;	// minimum of the mesh bounds
+uniform vec3 uPositionScale;	// size of the mesh bounds
 
 // output data
 out vec3 vPosition;
 out vec3 vNormal;
 out vec2 vTexCoord;
 out vec3 vColor;
-out vec3 vTangent;
+out vec4 vTangent;
+out vec2 vLightmapCoord;
+
+// unit vector from octahedral coordinates
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0.0f);
+	v.xy += vec2(v.x >= 0.0f ? -t : t, v.y >= 0.0f ? -t : t);
+	return normalize(v);
+}
 
 void main()
 {
+	vec3 position = aPosition;
+	vec3 normal = aNormal;
+	vec4 tangent = aTangent;
+
+	// decode packed attributes
+	if (uQuantized)
+	{
+		position = uPositionOffset + aPosition * uPositionScale;
+		normal = decodeOctahedral(aNormal.xy);
+		tangent = vec4(decodeOctahedral(aTangent.xy), aTangent.w < 0.0f ? -1.0f : 1.0f);
+	}
+
 	// set vertex position  
-	gl_Position = uModelViewProjectionMatrix * vec4(aPosition, 1.0f); 
+	gl_Position = uModelViewProjectionMatrix * vec4(position, 1.0f); 
 
 	// set vertex shader output
 	// will be interpolated for each fragment 
-	vPosition = (uModelMatrix * vec4(aPosition, 1.0f)).xyz; 
-	vNormal = uNormalMatrix * aNormal;
-	vTangent = uNormalMatrix * aTangent;
+	vPosition = (uModelMatrix * vec4(position, 1.0f)).xyz; 
+	vNormal = uNormalMatrix * normal;
+	vTangent = vec4(uNormalMatrix * tangent.xyz, tangent.w);
 	vTexCoord = aTexCoord;
 	vColor = aColor;
+	vLightmapCoord = aLightmapCoord;
 }
@@ -4,18 +4,9 @@
 in vec3 vPosition;
 in vec3 vNormal;
 in vec2 vTexCoord;
-in vec3 vTangent;
+in vec4 vTangent;
 in vec3 vColor;
-
-// light properties
-struct Light
-{ 
-	vec3 pos;
-	vec3 La;
-	vec3 Ld;
-	vec3 Ls;
-	vec3 att;	// constant, linear, quadratic
-};
+in vec2 vLightmapCoord;
 
 // material properties
 struct Material
@@ -28,71 +19,254 @@ struct Material
 
 // uniform input data
 uniform int uColorSet;
+uniform bool uFaceNormals;	// mesh without normals, use the face's
 uniform vec3 uViewpoint;
-uniform Light uLight;
+uniform vec3 uAmbient;		// ambient light of the scene
 uniform Material uMaterial;
 uniform samplerCube uEnvironmentMap;
+uniform float uEnvironmentRoughness;	// GGX roughness of reflections
+uniform float uEnvironmentMaxLevel;		// last mip level of the prefiltered environment map
 uniform sampler2D uTextureSampler;
 uniform sampler2D uTextureSampler2;
 uniform sampler2D uNormalSampler;
-uniform sampler2D uTextureSampler3;
+uniform vec4 uAtlasRect;	// image rectangle in the atlas bound to uTextureSampler, offset and scale
+uniform bool uAtlasRepeat;	// image tiles across the surface
+
+// clustered lights (see ClusteredLighting.h)
+uniform samplerBuffer uLightData;		// 5 texels per light: position and type, direction and range,
+										// Ld and cos inner angle, Ls and cos outer angle, attenuation
+uniform usamplerBuffer uClusterRanges;	// first index and number of lights of each cluster
+uniform usamplerBuffer uLightIndices;	// lights of all clusters
+uniform ivec3 uClusterGrid;				// tiles across, tiles up, depth slices
+uniform vec4 uClusterViewport;			// viewport origin and size in pixels
+uniform vec2 uClusterSlicing;			// slice of a view depth: log(depth) * x + y
+uniform mat4 uViewMatrix;
+
+// shadows of one light (see ShadowCache.h)
+uniform int uShadowLight;				// index of the shadowed light, -1 for none
+uniform samplerCubeShadow uShadowCube;	// point light
+uniform sampler2DShadow uShadowAtlas;	// spotlight and directional light tiles
+uniform mat4 uShadowMatrix;				// world to atlas coordinates and depth
+uniform vec4 uShadowTileRect;			// atlas coordinates the tile covers, min and max
+uniform vec2 uShadowDepthRange;			// near and far planes of the cube map faces
+
+// baked lighting of static surfaces (see Lightmap.h)
+uniform bool uBakedLighting;			// floor, walls and painting take light 0 from the lightmap
+uniform sampler2D uLightmap;			// sqrt(light / range) of light 0 and its bounces
+uniform float uLightmapRange;
+
+// deferred shading (see GBuffer.h)
+uniform int uRenderPass;				// 0: forward, 1: write the G-buffer, 2: light the G-buffer, 3: depth only
+uniform Material uMaterials[4];			// lighting pass: material of each colour set (the material ID)
+uniform sampler2D uGBufferAlbedo;		// albedo and material ID
+uniform sampler2D uGBufferNormal;		// octahedral normal
+uniform sampler2D uGBufferDepth;
+uniform mat4 uInverseViewProjection;	// lighting pass: world position from window depth
 
 // output data
-out vec3 fColor;
+layout(location = 0) out vec4 fColor;	// colour, or albedo and material ID into the G-buffer
+layout(location = 1) out vec2 fNormal;	// octahedral normal into the G-buffer
 
-void main()
+// sample an image packed into the atlas, repeating or clamping inside its rectangle;
+// gradients come from the unwrapped coordinates so the mip level does not jump at the repeats
+vec3 sampleAtlas(sampler2D atlas, vec2 texCoord)
 {
-	// fragment normal
-    vec3 n = normalize(vNormal);
-	if (uColorSet == 2) {
-		// tangent, bitangent and normalMap
-		vec3 tangent = normalize(vTangent);
-		vec3 biTangent = normalize(cross(tangent, n));
-		vec3 normalMap = 2.0f * texture(uNormalSampler, vTexCoord).xyz - 1.0f; 
-		n = normalize(mat3(tangent, biTangent, n) * normalMap);
+	vec2 local = uAtlasRepeat ? fract(texCoord) : clamp(texCoord, 0.0f, 1.0f);
+	vec2 atlasCoord = uAtlasRect.xy + local * uAtlasRect.zw;
+	return textureGrad(atlas, atlasCoord, dFdx(texCoord) * uAtlasRect.zw, dFdy(texCoord) * uAtlasRect.zw).rgb;
+}
+
+// octahedral coordinates of a unit vector, and back
+vec2 encodeOctahedral(vec3 v)
+{
+	vec2 e = v.xy / (abs(v.x) + abs(v.y) + abs(v.z));
+	if (v.z < 0.0f)
+		e = (1.0f - abs(e.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+	return e;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+	vec3 v = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0.0f);
+	v.xy += vec2(v.x >= 0.0f ? -t : t, v.y >= 0.0f ? -t : t);
+	return normalize(v);
+}
+
+// cluster of a world position in the viewport's grid
+int clusterIndex(vec3 position)
+{
+	ivec2 tile = ivec2((gl_FragCoord.xy - uClusterViewport.xy) / uClusterViewport.zw * vec2(uClusterGrid.xy));
+	tile = clamp(tile, ivec2(0), uClusterGrid.xy - 1);
+	float depth = max(-(uViewMatrix * vec4(position, 1.0f)).z, 1e-4f);
+	int slice = clamp(int(floor(log(depth) * uClusterSlicing.x + uClusterSlicing.y)), 0, uClusterGrid.z - 1);
+	return (slice * uClusterGrid.y + tile.y) * uClusterGrid.x + tile.x;
+}
+
+// fraction of the shadowed light reaching a position
+float shadow(int type, vec3 lightPosition, vec3 position, vec3 n)
+{
+	// offset along the normal against self shadowing
+	vec3 p = position + n * 0.01f;
+
+	// cube map faces store the depth of the major axis' projection
+	if (type == 1)
+	{
+		vec3 d = p - lightPosition;
+		float z = max(abs(d.x), max(abs(d.y), abs(d.z)));
+		float nearPlane = uShadowDepthRange.x;
+		float farPlane = uShadowDepthRange.y;
+		float depth = (farPlane + nearPlane) / (farPlane - nearPlane) - 2.0f * farPlane * nearPlane / ((farPlane - nearPlane) * z);
+		return texture(uShadowCube, vec4(d, depth * 0.5f + 0.5f));
 	}
 
-	// vector toward the viewer
-	vec3 v = normalize(uViewpoint - vPosition);
+	vec4 s = uShadowMatrix * vec4(p, 1.0f);
+	s.xyz /= s.w;
+	if (s.z >= 1.0f)
+		return 1.0f;	// beyond the far plane
+	return texture(uShadowAtlas, vec3(clamp(s.xy, uShadowTileRect.xy, uShadowTileRect.zw), s.z));
+}
 
-	// vector towards the light
-    vec3 l = normalize(uLight.pos - vPosition);
+// diffuse and specular light from one light
+void addLight(int light, Material material, vec3 position, vec3 n, vec3 v, inout vec3 Id, inout vec3 Is)
+{
+	vec4 positionType = texelFetch(uLightData, light * 5);
+	vec4 directionRange = texelFetch(uLightData, light * 5 + 1);
+	vec4 diffuseInner = texelFetch(uLightData, light * 5 + 2);
+	vec4 specularOuter = texelFetch(uLightData, light * 5 + 3);
+	vec3 att = texelFetch(uLightData, light * 5 + 4).xyz;
+	int type = int(positionType.w);
 
-	// halfway vector
-	vec3 h = normalize(l + v); 
+	// directional lights shine along their direction without falloff
+	vec3 l = -directionRange.xyz;
+	float attenuation = 1.0f;
+	if (type != 2)
+	{
+		vec3 toLight = positionType.xyz - position;
+		float dist = length(toLight);
+		l = toLight / dist;
+		attenuation = 1.0f / (att.x + dist * att.y + dist * dist * att.z);
+
+		// fade out before the range the clusters were built with
+		float ratio = dist / directionRange.w;
+		attenuation *= pow(clamp(1.0f - ratio * ratio * ratio * ratio, 0.0f, 1.0f), 2.0f);
+
+		// spotlight cone
+		if (type == 3)
+			attenuation *= smoothstep(specularOuter.w, diffuseInner.w, dot(-l, directionRange.xyz));
+	}
+
+	if (light == uShadowLight && attenuation > 0.0f)
+		attenuation *= shadow(type, positionType.xyz, position, n);
 
-	// calculate ambient, diffuse and specular intensities
-	vec3 Ia = uLight.La * uMaterial.Ka;
-	vec3 Id = vec3(0.0f);
-	vec3 Is = vec3(0.0f);
 	float dotLN = max(dot(l, n), 0.0f);
+	if (dotLN > 0.0f && attenuation > 0.0f)
+	{
+		vec3 h = normalize(l + v);
+		Id += diffuseInner.rgb * material.Kd * dotLN * attenuation;
+		Is += specularOuter.rgb * material.Ks * pow(max(dot(n, h), 0.0f), material.shininess) * attenuation;
+	}
+}
 
-	if(dotLN > 0.0f)
+// ambient, diffuse and specular light of the cluster's lights, modulating the surface colour;
+// the diffuse light of bakedLight (-1 for none) is given as baked instead
+vec3 shade(Material material, vec3 albedo, vec3 position, vec3 n, vec3 v, int bakedLight, vec3 baked)
+{
+	vec3 Ia = uAmbient * material.Ka;
+	vec3 Id = material.Kd * baked;
+	vec3 Is = vec3(0.0f);
+
+	uvec2 range = texelFetch(uClusterRanges, clusterIndex(position)).xy;
+	for (uint i = 0u; i < range.y; i++)
 	{
-		// attenuation
-		float dist = length(uLight.pos - vPosition);
-		float attenuation = 1.0f / (uLight.att.x + dist * uLight.att.y + dist * dist * uLight.att.z);
+		int light = int(texelFetch(uLightIndices, int(range.x + i)).x);
+		if (light != bakedLight)
+			addLight(light, material, position, n, v, Id, Is);
+	}
+
+	return (Ia + Id + Is) * albedo;
+}
 
-		Id = uLight.Ld * uMaterial.Kd * dotLN * attenuation;
-		Is = uLight.Ls * uMaterial.Ks * pow(max(dot(n, h), 0.0f), uMaterial.shininess) * attenuation;
+// lighting pass: shade the G-buffer's surface under this pixel
+void shadeGBuffer()
+{
+	vec2 pixel = gl_FragCoord.xy - uClusterViewport.xy;
+	float depth = texelFetch(uGBufferDepth, ivec2(pixel), 0).r;
+	if (depth == 1.0f)
+		discard;	// background
+
+	vec4 albedoMaterial = texelFetch(uGBufferAlbedo, ivec2(pixel), 0);
+	vec3 n = decodeOctahedral(texelFetch(uGBufferNormal, ivec2(pixel), 0).xy * 2.0f - 1.0f);
+	vec4 position = uInverseViewProjection * vec4(vec3(pixel / uClusterViewport.zw, depth) * 2.0f - 1.0f, 1.0f);
+	position /= position.w;
+
+	vec3 v = normalize(uViewpoint - position.xyz);
+	int material = int(albedoMaterial.a * 255.0f + 0.5f);
+	fColor = vec4(shade(uMaterials[material], albedoMaterial.rgb, position.xyz, n, v, -1, vec3(0.0f)), 1.0f);
+}
+
+void main()
+{
+	if (uRenderPass == 2)
+	{
+		shadeGBuffer();
+		return;
 	}
-	
-	// intensity of reflected light
-	fColor = Ia + Id + Is;
+	if (uRenderPass == 3)
+		return;		// shadow casters
+
+	// fragment normal
+    vec3 n = normalize(vNormal);
+	if (uFaceNormals)
+		n = normalize(cross(dFdx(vPosition), dFdy(vPosition)));
+	if (uColorSet == 2) {
+		// tangent, bitangent and normalMap
+		vec3 tangent = normalize(vTangent.xyz);
+		vec3 biTangent = vTangent.w * normalize(cross(tangent, n));	// flipped for mirrored texture coordinates
+		// x and y only (BC5 has two channels), z of the unit vector is positive
+		vec2 normalXY = 2.0f * texture(uNormalSampler, vTexCoord).xy - 1.0f;
+		vec3 normalMap = vec3(normalXY, sqrt(max(1.0f - dot(normalXY, normalXY), 0.0f)));
+		n = normalize(mat3(tangent, biTangent, n) * normalMap);
+	}
+
+	// vector toward the viewer
+	vec3 v = normalize(uViewpoint - vPosition);
 
 	// reflection
 	vec3 reflectEnvMap = reflect(-v, n);
 
-	// modulate color
-	if (uColorSet == 0) // cub env
-		fColor *= texture(uEnvironmentMap, reflectEnvMap).rgb;
+	// surface color
+	vec3 albedo;
+	if (uColorSet == 0) // cub env - level i is prefiltered for roughness i / max level
+		albedo = textureLod(uEnvironmentMap, reflectEnvMap, uEnvironmentRoughness * uEnvironmentMaxLevel).rgb;
 	else if (uColorSet == 1){ // floor - no normal mapping
-		fColor *= texture(uTextureSampler, vTexCoord).rgb;
+		albedo = sampleAtlas(uTextureSampler, vTexCoord);
 	} else if (uColorSet == 2) { // walls - normal mapping
-		fColor *= texture(uTextureSampler2, vTexCoord).rgb;
+		albedo = texture(uTextureSampler2, vTexCoord).rgb;
 	} else if (uColorSet == 3) { // painting
-		fColor *= texture(uTextureSampler3, vTexCoord).rgb;
+		albedo = sampleAtlas(uTextureSampler, vTexCoord);
 	}
-	else // lines
-		fColor = vColor;
+	else { // lines - not lit
+		fColor = vec4(vColor, 1.0f);
+		return;
+	}
+
+	// geometry pass: the surface, lit later by the lighting pass
+	if (uRenderPass == 1)
+	{
+		fColor = vec4(albedo, float(uColorSet) / 255.0f);
+		fNormal = encodeOctahedral(n) * 0.5f + 0.5f;
+		return;
+	}
+
+	// static surfaces: the scene light (light 0) with its shadows and bounces was baked
+	if (uBakedLighting && uColorSet != 0)
+	{
+		vec3 baked = texture(uLightmap, vLightmapCoord).rgb;
+		fColor = vec4(shade(uMaterial, albedo, vPosition, n, v, 0, baked * baked * uLightmapRange), 1.0f);
+		return;
+	}
+
+	// intensity of reflected light from the lights of this fragment's cluster
+	fColor = vec4(shade(uMaterial, albedo, vPosition, n, v, -1, vec3(0.0f)), 1.0f);
 }
@@ -0,0 +1,193 @@
+/*****************************************************************
+ * texcook: offline texture cooker
+ *
+ * decodes source images once and writes them with precomputed
+ * mip chains into .ctex containers (see CookedTexture.h), which
+ * Texture maps and uploads level by level at startup
+ *
+ * usage: texcook [options] image...
+ *   --linear      data textures: filter without sRGB decoding
+ *   --normal      normal maps: filter as vectors and renormalize
+ *   --clamp       clamp at the edges (default repeats, as GL_REPEAT)
+ *   --box         2x2 box filter (default Kaiser)
+ *   --cube        the six images are cube faces (+x, -x, +y, -y, +z, -z)
+ *   --ggx         cube levels prefiltered for GGX roughness (environment maps)
+ *   --bc1         compress to BC1 (opaque colour)
+ *   --bc3         compress to BC3 (colour and alpha)
+ *   --bc5         compress to BC5 (x and y of normal maps)
+ *   -o file       output file (default: image name with .ctex)
+ *****************************************************************/
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "BlockCompressor.h"
+#include "CookedTexture.h"
+#include "EnvironmentPrefilter.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MipGenerator.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void printUsage()
+	{
+		std::cerr << "usage: texcook [--linear] [--normal] [--clamp] [--box] [--cube] [--ggx] [--bc1|--bc3|--bc5] [-o file] image..." << std::endl;
+	}
+
+	// decode an image as the runtime loader did (flipped so the first row is at the bottom)
+	bool loadImage(const std::string& filename, MipImage& image, uint64_t& sourceHash)
+	{
+		MappedFile source;
+		if (!source.open(filename))
+			return false;
+		sourceHash = hashData(source.data(), source.size());
+		source.close();
+
+		// stb_image's BMP offset check only works when reading from a file
+		int width, height, channels;
+		unsigned char* pixels = stbi_load(filename.c_str(), &width, &height, &channels, 0);
+		if (pixels == nullptr)
+			return false;
+
+		image.width = width;
+		image.height = height;
+		image.numOfChannels = channels;
+		image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * channels);
+		stbi_image_free(pixels);
+		return true;
+	}
+
+	// cook the given images into one file (one face each)
+	bool cook(const std::vector<std::string>& images, const std::string& output, MipFilter filter, unsigned int flags,
+		BlockFormat format)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+
+		std::vector<MipImage> sources(images.size());
+		uint64_t sourceHash = 0;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			MipImage& image = sources[i];
+			uint64_t imageHash;
+			if (!loadImage(images[i], image, imageHash))
+			{
+				std::cerr << "Unable to load: " << images[i] << std::endl;
+				return false;
+			}
+			if (i > 0 && (image.width != sources[0].width || image.height != sources[0].height
+				|| image.numOfChannels != sources[0].numOfChannels))
+			{
+				std::cerr << "Cube faces differ in size or format: " << images[i] << std::endl;
+				return false;
+			}
+
+			// checked at load time against the image the file is named after
+			// (a cube file against its +x face)
+			if (i == 0)
+				sourceHash = imageHash;
+		}
+
+		// GGX levels are filtered across the faces, other chains face by face
+		std::vector<std::vector<MipImage>> faces(images.size());
+		if ((flags & MIP_GGX) != 0)
+		{
+			if (sources[0].width != sources[0].height)
+			{
+				std::cerr << "Cube faces are not square: " << images[0] << std::endl;
+				return false;
+			}
+			const MipImage* cubeFaces[6];
+			for (int face = 0; face < 6; face++)
+				cubeFaces[face] = &sources[face];
+			prefilterEnvironment(cubeFaces, flags, DEFAULT_PREFILTER_SAMPLES, faces);
+		}
+		else
+		{
+			for (size_t i = 0; i < sources.size(); i++)
+				generateMipChain(sources[i], filter, flags, faces[i]);
+		}
+
+		if (!writeCookedTexture(output, sourceHash, flags, faces, format))
+		{
+			std::cerr << "Unable to write: " << output << std::endl;
+			return false;
+		}
+
+		std::chrono::duration<double, std::milli> cookTime = std::chrono::steady_clock::now() - startTime;
+		static const char* formatNames[] = { "uncompressed", "BC1", "BC3", "BC5" };
+		std::cout << "Cooked " << output << " (" << faces[0][0].width << "x" << faces[0][0].height << ", "
+			<< faces[0].size() << " levels, " << formatNames[format] << ") in " << cookTime.count() << " ms" << std::endl;
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// same orientation as Texture's stb_image fallback
+	stbi_set_flip_vertically_on_load(true);
+
+	unsigned int flags = MIP_SRGB | MIP_WRAP;
+	MipFilter filter = MIP_FILTER_KAISER;
+	bool isCube = false;
+	bool isPrefiltered = false;
+	BlockFormat format = BLOCK_FORMAT_NONE;
+	std::string output;
+	std::vector<std::string> images;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--linear")
+			flags &= ~MIP_SRGB;
+		else if (argument == "--normal")
+			flags = (flags & ~MIP_SRGB) | MIP_NORMAL_MAP;
+		else if (argument == "--clamp")
+			flags &= ~MIP_WRAP;
+		else if (argument == "--box")
+			filter = MIP_FILTER_BOX;
+		else if (argument == "--cube")
+			isCube = true;
+		else if (argument == "--ggx")
+			isPrefiltered = true;
+		else if (argument == "--bc1")
+			format = BLOCK_FORMAT_BC1;
+		else if (argument == "--bc3")
+			format = BLOCK_FORMAT_BC3;
+		else if (argument == "--bc5")
+			format = BLOCK_FORMAT_BC5;
+		else if (argument == "-o" && i + 1 < argc)
+			output = argv[++i];
+		else if (!argument.empty() && argument[0] == '-')
+		{
+			printUsage();
+			return 1;
+		}
+		else
+			images.push_back(argument);
+	}
+
+	if (images.empty() || (isCube && images.size() != 6) || (isPrefiltered && !isCube) || (!output.empty() && !isCube && images.size() != 1))
+	{
+		printUsage();
+		return 1;
+	}
+
+	if (isCube)
+	{
+		flags = (flags & ~MIP_WRAP) | (isPrefiltered ? MIP_GGX : 0);
+		return cook(images, output.empty() ? cookedTexturePath(images[0]) : output, filter, flags, format) ? 0 : 1;
+	}
+
+	bool succeeded = true;
+	for (const std::string& image : images)
+		succeeded = cook({ image }, output.empty() ? cookedTexturePath(image) : output, filter, flags, format) && succeeded;
+
+	return succeeded ? 0 : 1;
+}
@@ -51,7 +51,32 @@ struct VertexNormTanTex
 	GLfloat position[3];
 	GLfloat normal[3];
 	GLfloat texCoord[2];
-	GLfloat tangent[3];
+	GLfloat tangent[4];		// w: handedness of the bitangent
+};
+
+// packed vertex formats (see VertexQuantizer.h)
+struct PackedVertexNormal
+{
+	GLushort position[3];	// 16-bit unsigned normalized within the mesh bounds
+	GLushort padding;
+	GLuint normal;			// octahedral, GL_INT_2_10_10_10_REV
+};
+
+struct PackedVertexNormTex
+{
+	GLushort position[3];
+	GLushort padding;
+	GLuint normal;
+	GLhalf texCoord[2];		// half floats
+};
+
+struct PackedVertexNormTanTex
+{
+	GLushort position[3];
+	GLushort padding;
+	GLuint normal;
+	GLuint tangent;			// octahedral, handedness in the 2-bit field
+	GLhalf texCoord[2];
 };
 
 // light properties